@@ -13,6 +13,7 @@ command_fn request_server_update;
 command_fn authenticate;
 command_fn change_state;
 command_fn list_scenarios;
+command_fn create_scenario;
 
 command_fn message_server;
 command_fn change_bg_color;
@@ -1,17 +1,37 @@
 #ifndef GAME_MANAGER_H
 #define GAME_MANAGER_H
 
+#include "message.h"
+#include "scenario.h"
 #include "vector.h"
 
+#include <stdbool.h>
+
 // this translation unit will provide functions and structures that control the
 // player and game objects of the player.  This will be a sort of library for
 // controlling the game.
 
 struct player {
+    u32 id;
     char username[50];
-    struct vector* tanks;
+
+    // indexed by tank.  The server only sends the tanks in view, and the rest
+    // keep where they were last seen.
+    struct vector* tanks;   // struct tank
+    struct vector* visible; // bool
 };
 
-void players_update_player(char *username, struct vector *tank_positions);
+/** Applies a tick from the server.  A keyframe replaces every tank in view,
+    and a delta is only applied on top of the tick it was made against.  Until
+    the next keyframe, deltas after a missed tick are ignored. */
+void players_apply_tick(const struct scenario_tick *tick);
+
+/** Adds a player, or renames it if it's already known. */
+struct player *players_add(const struct tick_player *named);
+void players_update_tank(const struct tank_delta *delta);
+void players_hide_tank(const struct tank_key *key);
+
+/** whether the `t`th tank of `player` is in view. */
+bool player_tank_visible(const struct player *player, size_t t);
 
 #endif
@@ -1,5 +1,6 @@
 #include "client-commands.h"
 #include "client-gfx.h"
+#include "arena.h"
 #include "error.h"
 #include "game-manager.h"
 
@@ -20,6 +21,7 @@
 extern bool g_run_program;
 extern bool g_server_connected;
 extern int g_server_sock;
+extern enum message_encoding g_server_encoding;
 
 extern bool g_gfx_running;
 
@@ -41,14 +43,28 @@ void *read_msg_thread(void *arg) {
     g_print_msg = false;
     
     sexp *msg = NULL;
-    struct vector* msg_buf = make_vector(sizeof(char), 30);
+    struct message_reader* reader = make_message_reader();
     fcntl(g_server_sock, F_SETFL, O_NONBLOCK);
 
+    // a tick's vectors only last until it's applied, so they're freed all at
+    // once, by resetting the arena before the next tick is read.
+    struct arena tick_arena;
+    struct result_void arena_r = make_arena(&tick_arena, 4096);
+    if (arena_r.status == RESULT_ERROR) {
+        char *err_msg = describe_error(arena_r.error);
+        puts(err_msg);
+        free(err_msg);
+        free_error(arena_r.error);
+        free_message_reader(reader);
+        return NULL;
+    }
+    struct allocator tick_alloc = arena_allocator(&tick_arena);
+
     while (g_run_program) {
         if (!g_server_connected)
             continue;
 
-        struct result_sexp r = message_recv(g_server_sock, msg_buf);
+        struct result_sexp r = message_recv(g_server_sock, reader);
 
         // handle any errors that may have occured during parsing, etc.
         if (r.status == RESULT_ERROR) {
@@ -65,8 +81,12 @@ void *read_msg_thread(void *arg) {
         // a message was received, handle the message.
         switch (message_get_type(msg)) {
         case MSG_RESPONSE_SCENARIO_TICK: {
+            // nothing from the last tick is still in use.
+            arena_reset(&tick_arena);
+
             struct scenario_tick tick;
-            struct result_scenario_tick r = unwrap_scenario_tick_message(msg);
+            struct result_scenario_tick r =
+                unwrap_scenario_tick_message_in(msg, &tick_alloc);
 
             // free resources and restart loop if error occured.
             if (r.status == RESULT_ERROR) {
@@ -77,13 +97,7 @@ void *read_msg_thread(void *arg) {
                 tick = r.ok;
             }
 
-            struct player_public_data* pd = vec_dat(tick.players_public_data);
-            struct player_public_data* end = vec_last(tick.players_public_data);
-            for (; pd <= end; pd++) {
-                players_update_player(vec_dat(pd->username), pd->tank_positions);
-            }
-
-            free_scenario_tick(tick);
+            players_apply_tick(&tick);
         } break;            
         default:
             break;
@@ -103,7 +117,8 @@ void *read_msg_thread(void *arg) {
         continue;
     }
         
-    free_vector(msg_buf);
+    free_message_reader(reader);
+    free_arena(&tick_arena);
     return NULL;
 }
 
@@ -115,7 +130,7 @@ struct result_s32 debug_send_msg(sexp *msg) {
     printf("sending message: ");
     sexp_println(msg);
 
-    struct result_s32 r = message_send(g_server_sock, msg);
+    struct result_s32 r = message_send(g_server_sock, msg, g_server_encoding);
     if (r.status == RESULT_OK)
         printf("message sent.\n");
     else
@@ -140,18 +155,23 @@ void request_server_update(int argc, char **argv, struct error *e) {
 void authenticate(int argc, char **argv, struct error *e) {
     (void)argc; (void)argv; (void)e;
 
-    if (argc != 2) {
-        *e = make_msg_error("ERROR: second argument must be your username.\n");
+    if (argc != 2 && argc != 3) {
+        *e = make_msg_error("ERROR: second argument must be your username.\n"
+                            "       third argument may be \"binary\".\n");
         return;
     }
 
+    enum message_encoding encoding = MESSAGE_ENCODING_TEXT;
+    if (argc == 3 && strcmp(argv[2], "binary") == 0)
+        encoding = MESSAGE_ENCODING_BINARY;
+
     // copy username into global username tracker.
     memcpy(&g_username, argv[1], strlen(argv[1]));
 
     const char *username = argv[1];
     const char *password = NULL;
     struct result_sexp msg =
-        make_user_credentials_message_str(username, password);
+        make_user_credentials_message_str(username, password, encoding);
 
     if (msg.status == RESULT_ERROR) {
         *e = msg.error;
@@ -160,17 +180,21 @@ void authenticate(int argc, char **argv, struct error *e) {
 
     debug_send_msg(msg.ok);
     free_sexp(msg.ok);
+
+    // the server reads either encoding, so there is no need to wait for it to
+    // accept the request.
+    g_server_encoding = encoding;
 }
 
 void change_state(int argc, char **argv, struct error *e) {
-    if (argc != 2) {
-        *e = make_msg_error("ERROR: valid options are \"scene\" or \"lobby\"\n");
+    if (argc != 2 && argc != 3) {
+        *e = make_msg_error("ERROR: valid options are \"scene [name]\" or \"lobby\"\n");
         return;
     }
 
     struct result_sexp msg;
     if (strcmp(argv[1], "scene") == 0) {
-        msg = make_join_scenario_message("default");
+        msg = make_join_scenario_message(argc == 3 ? argv[2] : "default");
     } else if (strcmp(argv[1], "lobby") == 0) {
         msg = make_return_to_lobby_message();
     } else {
@@ -202,6 +226,24 @@ void list_scenarios(int argc, char **argv, struct error *e) {
     return;
 }
 
+void create_scenario(int argc, char **argv, struct error *e) {
+    if (argc != 2) {
+        *e = make_msg_error("ERROR: usage: create-scenario <name>\n");
+        return;
+    }
+
+    struct result_sexp msg;
+    msg = make_create_scenario_message(argv[1]);
+    if (msg.status == RESULT_ERROR) {
+        *e = msg.error;
+        return;
+    }
+
+    debug_send_msg(msg.ok);
+    free_sexp(msg.ok);
+    return;
+}
+
 void update_tank(int argc, char **argv, struct error *e) {
     (void)argc; (void)argv; (void)e;
     if (argc < 3) {
@@ -268,18 +310,24 @@ void propose_update(int argc, char **argv, struct error *e) {
         vec_push(update.tank_target_coords, &tank.move_to);
     }
 
-    struct result_sexp msg;
-    msg = make_player_update_message(&update);
+    struct result_vec msg;
+    msg = make_player_update_message(&update, g_server_encoding);
+
+    free_vector(update.tank_instructions);
+    free_vector(update.tank_target_coords);
 
     if (msg.status == RESULT_ERROR) {
         *e = msg.error;
-        free_vector(update.tank_instructions);
-        free_vector(update.tank_target_coords);
         return;
     }
 
-    debug_send_msg(msg.ok);
-    free_sexp(msg.ok);
+    if (!g_server_connected) {
+        *e = make_msg_error("ERROR! you must connect to the server first!\n");
+    } else if (message_send_encoded(g_server_sock, msg.ok).ok < 0) {
+        *e = make_msg_error("failed to send the player update.\n");
+    }
+
+    free_vector(msg.ok);
     return;
 }
 
@@ -289,6 +337,9 @@ void list_tanks(int argc, char **argv, struct error *e) {
         struct player *player = vec_ref(g_players, p);
         printf("[tanks for %s]\n", player->username);
         for (size_t t = 0; t < vec_len(player->tanks); t++) {
+            if (!player_tank_visible(player, t))
+                continue;
+
             struct tank *tank = vec_ref(player->tanks, t);
             printf("  [%zu] x: %d y: %d\n", t, tank->pos.x, tank->pos.y);
         }
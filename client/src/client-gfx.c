@@ -151,6 +151,9 @@ void *gfx_thread(void *arg) {
             struct player *player = vec_ref(g_players, p);
 
             for (size_t t = 0; t < vec_len(player->tanks); t++) {
+                if (!player_tank_visible(player, t))
+                    continue;
+
                 struct tank tank;
                 vec_at(player->tanks, t, &tank);
                 gfx_draw_tank(renderer, &camera, &tile, grid_spacing, tank.pos.x, tank.pos.y);
@@ -35,6 +35,7 @@ pthread_t g_read_msg_pid;
 bool g_run_program;
 bool g_server_connected;
 int g_server_sock;
+enum message_encoding g_server_encoding;
 
 bool g_gfx_running;
 
@@ -62,6 +63,7 @@ struct command COMMANDS[] = {
     {"auth", &authenticate},
     {"change-state", &change_state},
     {"list-scenarios", &list_scenarios},
+    {"create-scenario", &create_scenario},
 
     {"msg", &message_server},
     {"color", &change_bg_color},
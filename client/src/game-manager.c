@@ -7,32 +7,130 @@
 
 extern struct vector* g_players;
 
-void players_update_player(char *username, struct vector *tank_positions) {
-    // see if the player exists in the structure.
-    struct player *player = NULL;
+// the tick the players were last updated to, if they are up to date.
+u32 g_players_tick;
+bool g_players_synced = false;
+
+struct player *players_find(u32 id) {
     for (size_t p = 0; p < vec_len(g_players); p++) {
-        player = vec_ref(g_players, p);
-        int status = strcmp(username, player->username);
+        struct player *player = vec_ref(g_players, p);
+        if (player->id == id)
+            return player;
+    }
+
+    return NULL;
+}
+
+struct player *players_add(const struct tick_player *named) {
+    // see if the player exists in the structure.
+    struct player *player = players_find(named->id);
+
+    if (player == NULL) {
+        struct player new_player = {
+            .id = named->id,
+            .tanks = make_vector(sizeof(struct tank), 30),
+            .visible = make_vector(sizeof(bool), 30),
+        };
+
+        // tanks that haven't come into view yet are zeroed, and not visible.
+        vec_set_zeroing(new_player.tanks, true);
+        vec_set_zeroing(new_player.visible, true);
+
+        vec_push(g_players, &new_player);
+        player = vec_ref(g_players, vec_len(g_players) - 1);
+    }
+
+    strncpy(player->username, named->username, 50);
+    player->username[49] = '\0';
+    return player;
+}
+
+bool player_tank_visible(const struct player *player, size_t t) {
+    return t < vec_len(player->visible) &&
+        *(bool *)vec_ref(player->visible, t);
+}
+
+void players_update_tank(const struct tank_delta *delta) {
+    // the index comes from the server, so it's checked before anything
+    // is grown to fit it.
+    if (delta->tank >= TANKS_IN_SCENARIO)
+        return;
+
+    struct player *player = players_find(delta->player_id);
+    if (player == NULL) {
+        // every player is named when its tanks come into view, so this is
+        // only a fallback.
+        struct tick_player unnamed = { .id = delta->player_id };
+        player = players_add(&unnamed);
+    }
+
+    // a player's tanks come into view in any order.
+    if (delta->tank >= vec_len(player->tanks)) {
+        if (vec_resize(player->tanks, delta->tank + 1) < 0 ||
+            vec_resize(player->visible, delta->tank + 1) < 0)
+            return;
+    }
+
+    struct tank *tank = vec_ref(player->tanks, delta->tank);
+    tank->pos = delta->pos;
+    tank->health = delta->health;
+
+    bool visible = true;
+    vec_set(player->visible, delta->tank, &visible);
+}
+
+void players_hide_tank(const struct tank_key *key) {
+    struct player *player = players_find(key->player_id);
+    if (player == NULL || key->tank >= vec_len(player->visible))
+        return;
+
+    bool visible = false;
+    vec_set(player->visible, key->tank, &visible);
+}
+
+/** removes the players that aren't named in a keyframe, and hides the tanks
+    of those that are. */
+void players_reset(const struct vector *named) {
+    for (size_t p = vec_len(g_players); p-- > 0;) {
+        struct player *player = vec_ref(g_players, p);
+
+        bool found = false;
+        for (size_t k = 0; k < vec_len(named) && !found; k++) {
+            const struct tick_player *tp = vec_ref(named, k);
+            found = tp->id == player->id;
+        }
+
+        if (found) {
+            memset(vec_dat(player->visible), 0,
+                   vec_len(player->visible) * sizeof(bool));
+        } else {
+            free_vector(player->tanks);
+            free_vector(player->visible);
+            vec_rem(g_players, p);
+        }
+    }
+}
 
-        if (status == 0)
-            goto update_player;
+void players_apply_tick(const struct scenario_tick *tick) {
+    if (tick->keyframe)
+        players_reset(tick->players);
+    else if (!g_players_synced || g_players_tick != tick->base_tick) {
+        // the server resends everything in the next keyframe.
+        g_players_synced = false;
+        return;
     }
-    // emulated for-else syntax from python
-    // this is the else case, we didn't find the player.
-    struct player new_player;
-    strncpy(new_player.username, username, 50);
-    new_player.tanks = make_vector(sizeof(struct tank), 30);
 
-    vec_push(g_players, &new_player);
-    player = vec_ref(g_players, vec_len(g_players) - 1);
+    for (size_t p = 0; p < vec_len(tick->players); p++)
+        players_add(vec_ref(tick->players, p));
 
-update_player: ; // can't have a declaration after a label in cstd < c2x
-    vec_resize(player->tanks, vec_len(tank_positions));
+    for (size_t c = 0; c < vec_len(tick->changes); c++)
+        players_update_tank(vec_ref(tick->changes, c));
 
-    for (size_t t = 0; t < vec_len(tank_positions); t++) {
-        struct tank *tank = vec_ref(player->tanks, t);
-        tank->pos = *(struct coord*)vec_ref(tank_positions, t);
+    if (!tick->keyframe) {
+        for (size_t r = 0; r < vec_len(tick->removals); r++)
+            players_hide_tank(vec_ref(tick->removals, r));
     }
 
-    return;
+    g_players_tick = tick->tick_number;
+    g_players_synced = true;
 }
@@ -0,0 +1,31 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <stddef.h>
+
+/**
+ * Where a container's memory comes from.
+ *
+ * `resize` works like realloc: it moves the `old_size` bytes at `ptr` into a
+ * block of `new_size` bytes, or allocates one if `ptr` is NULL.  If it fails,
+ * it returns NULL and leaves `ptr` alone.  `release` gives back a block of
+ * `size` bytes.  An allocator that frees everything at once, like an arena,
+ * doesn't have to do anything in it.
+ *
+ * Blocks are aligned for any type, as malloc's are.
+ */
+struct allocator {
+    void *(*resize)(void *ctx, void *ptr, size_t old_size, size_t new_size);
+    void (*release)(void *ctx, void *ptr, size_t size);
+    void *ctx;
+};
+
+/** malloc, realloc and free.  Safe to use from any thread. */
+extern const struct allocator g_system_allocator;
+
+void *allocator_alloc(const struct allocator *alloc, size_t size);
+void *allocator_resize(const struct allocator *alloc, void *ptr,
+                       size_t old_size, size_t new_size);
+void allocator_release(const struct allocator *alloc, void *ptr, size_t size);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include "allocator.h"
+#include "error.h"
+#include "nonstdint.h"
+
+#include <stddef.h>
+
+/**
+ * A bump allocator, for memory that is all freed at once.
+ *
+ * Allocations are carved off the end of a block, and aren't freed one at a
+ * time.  When the block is full, another at least twice its size is chained
+ * on.  `arena_reset` frees everything at once: if more than one block was
+ * used, they are replaced with a single block as large as all of them, so an
+ * arena that is reset after the same work each time soon stops calling malloc
+ * at all.
+ */
+struct arena_block;
+
+struct arena {
+    struct arena_block *blocks; // the newest block, which is allocated from
+    size_t used;                // bytes used of the newest block
+};
+
+struct result_void make_arena(struct arena *arena, size_t size);
+void free_arena(struct arena *arena);
+
+/**
+ * Returns `size` bytes aligned to `align`, which must be a power of 2 no
+ * larger than `_Alignof(max_align_t)`.  The memory isn't zeroed.
+ *
+ * Returns NULL if allocation fails.
+ */
+void *arena_alloc(struct arena *arena, size_t size, size_t align);
+
+/** allocates an array of `n` `type`s from `arena`. */
+#define arena_new(arena, type, n)                                       \
+    ((type *)arena_alloc((arena), sizeof(type) * (n), _Alignof(type)))
+
+/** Frees everything allocated from the arena since it was last reset. */
+void arena_reset(struct arena *arena);
+
+/**
+ * An allocator that allocates from `arena`, for vectors that live until it's
+ * reset.  The last block allocated grows and shrinks in place, and is given
+ * back if it's released.  Other blocks are copied when they grow, and aren't
+ * given back until the reset.
+ *
+ * The arena has to outlive the allocator.
+ */
+struct allocator arena_allocator(struct arena *arena);
+
+#endif
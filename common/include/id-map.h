@@ -0,0 +1,43 @@
+#ifndef ID_MAP_H
+#define ID_MAP_H
+
+#include "error.h"
+#include "nonstdint.h"
+#include "vector.h"
+
+/**
+ * A hash map from u32 ids to u32 values.
+ *
+ * The entries live in one open addressed table, probed linearly, which is
+ * kept at most half full.  Removing an entry shifts the entries after it back,
+ * so there are no tombstones, and lookups stay O(1) however many ids come and
+ * go.
+ */
+struct id_map {
+    u32 len;
+    u32 mask;
+    struct vector *entries; // struct id_map_entry
+};
+
+struct id_map_entry {
+    u32 id;
+    u32 value;
+};
+
+/** marks an empty entry, and is returned for a missing id.  It can't be used
+    as an id. */
+#define ID_MAP_NONE UINT32_MAX
+
+struct result_void make_id_map(struct id_map *map);
+void free_id_map(struct id_map *map);
+
+/** Adds `id`, or replaces its value. */
+struct result_void id_map_set(struct id_map *map, u32 id, u32 value);
+
+/** Returns the value of `id`, or ID_MAP_NONE. */
+u32 id_map_get(const struct id_map *map, u32 id);
+
+/** Does nothing if `id` isn't in the map. */
+void id_map_remove(struct id_map *map, u32 id);
+
+#endif
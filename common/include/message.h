@@ -1,9 +1,11 @@
 #ifndef MESSAGE_H
 #define MESSAGE_H
 
+#include "allocator.h"
 #include "error.h"
 #include "scenario.h"
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <vector.h>
 #include <sexp.h>
@@ -44,8 +46,103 @@ enum message_type { MESSAGE_TYPE_ENUM_VALUES };
 extern const char *g_reflected_message_type[];
 DECLARE_RESULT_TYPE_CUSTOM(enum message_type, message_type)
 
-struct result_s32  message_send(int fd, const struct sexp *message);
-struct result_sexp message_recv(int fd, struct vector *buf);
+/** How a message is encoded when it is sent.
+
+    Text messages are serialized sexps.  A binary message starts with its one
+    byte message type (see the message table in plan.org), followed by the
+    length of its body as a varint, and then the binary sexps in its body (see
+    `sexp_serialize_binary()`).
+
+    `message_recv()` accepts both encodings at any time.  A client requests the
+    encoding the server sends to it while authenticating.
+*/
+enum message_encoding {
+    MESSAGE_ENCODING_TEXT,
+    MESSAGE_ENCODING_BINARY,
+};
+
+struct result_s32  message_send(int fd, const struct sexp *message,
+                                enum message_encoding encoding);
+
+/** Returns the bytes `message_send()` would send, so they can be queued or
+    sent more than once. */
+struct result_vec message_encode(const struct sexp *message,
+                                 enum message_encoding encoding);
+
+/** Sends a message that was already encoded, such as the buffers returned by
+    `make_scenario_tick_message()`. */
+struct result_s32 message_send_encoded(int fd, const struct vector *message);
+
+/** An encoded message shared by every connection it is sent to, so that a
+    broadcast is only encoded once.  Every holder owns a reference, and the
+    bytes are freed when the last one is released.  References may be taken
+    and released from any thread.
+*/
+struct message_buffer {
+    struct vector *bytes;
+    atomic_uint refs;
+};
+
+DECLARE_RESULT_TYPE_CUSTOM(struct message_buffer *, message_buffer)
+
+/** Takes ownership of `bytes`, which are freed if this fails.  The caller
+    holds the first reference. */
+struct result_message_buffer make_message_buffer(struct vector *bytes);
+
+/** Take another reference to `buffer`, and return it. */
+struct message_buffer *message_buffer_retain(struct message_buffer *buffer);
+void message_buffer_release(struct message_buffer *buffer);
+
+/** Sends the bytes of `buffer` starting at `offset`, without copying them.
+
+    @return the number of bytes sent, which may be fewer than were left on a
+    non-blocking socket, or -1 with errno set.
+*/
+struct result_s32 message_buffer_send(int fd, const struct message_buffer *buffer,
+                                      size_t offset);
+
+/** The longest message `message_recv()` accepts, in bytes.  A peer that sends
+    a longer one is disconnected.  It is also the longest netstring, which
+    can't be longer than the message it's in. */
+#define MESSAGE_MAX_SIZE SEXP_NETSTRING_MAX_LENGTH
+
+/** Reads messages from a socket.  A message can arrive over several reads, so
+    the bytes received so far are kept here, along with how far they have been
+    scanned. */
+struct message_reader {
+    struct vector *buf;
+
+    // the message being received starts at `start`.  The bytes before it
+    // belong to messages that were already returned.
+    size_t start;
+
+    // bytes of `buf` that have already been fed to `stream`.
+    size_t scanned;
+    struct sexp_stream stream;
+
+    // set once the peer has hung up, or the socket failed.
+    bool closed;
+};
+
+/** must be freed with `free_message_reader()`.  Returns NULL if allocation
+    fails. */
+struct message_reader *make_message_reader(void);
+void free_message_reader(struct message_reader *reader);
+
+/** Reads from `fd` into the reader.  Once a complete message has been received
+    it is returned, otherwise NULL is returned.
+
+    Each call only scans the bytes that arrived since the last call, so a large
+    message is scanned once, and read once it is complete.
+
+    Several messages can arrive in a single read.  They are returned by the
+    following calls, one per call, before `fd` is read again.  A partial
+    message at the end of a read is kept until the rest of it arrives.
+
+    The strings and symbols in the message are borrowed from the reader rather
+    than copied, so the message must be freed before the reader is used
+    again. */
+struct result_sexp message_recv(int fd, struct message_reader *reader);
 
 /** Return the type of the message. */
 enum message_type message_get_type(const sexp *msg);
@@ -56,6 +153,7 @@ enum message_type message_get_type(const sexp *msg);
  * text for debug/logging purposes. This generic message is associated with the
  * text field in the message union. */
 struct result_sexp make_text_message(const char *message);
+/** The returned string is a copy, and must be freed. */
 struct result_str unwrap_text_message(const sexp *msg);
 /* STATUS
 
@@ -77,7 +175,12 @@ DECLARE_RESULT_TYPE_CUSTOM(enum message_status, message_status)
 
 struct result_sexp make_status_message(enum message_status status);
 struct result_message_status  unwrap_status_message(const sexp *msg);
-struct result_s32 message_status_send(int fd, enum message_status status, char *brief);
+struct result_s32 message_status_send(int fd, enum message_status status, char *brief,
+                                      enum message_encoding encoding);
+/** Returns the bytes `message_status_send()` would send. */
+struct result_vec message_status_encode(enum message_status status,
+                                        const char *brief,
+                                        enum message_encoding encoding);
 
 /* USER_CREDENTIALS
  *
@@ -86,6 +189,9 @@ struct result_s32 message_status_send(int fd, enum message_status status, char *
 struct user_credentials {
     struct vector* username;
     struct vector* password;
+
+    // the encoding the client wants the server to send.
+    enum message_encoding encoding;
 };
 
 DECLARE_RESULT_TYPE_CUSTOM(struct user_credentials, user_credentials)
@@ -94,7 +200,8 @@ struct result_sexp
 make_user_credentials_message(const struct user_credentials *creds);
 
 struct result_sexp
-make_user_credentials_message_str(const char* username, const char *password);
+make_user_credentials_message_str(const char* username, const char *password,
+                                  enum message_encoding encoding);
 
 struct result_user_credentials
 unwrap_user_credentials_message(const sexp *msg);
@@ -111,36 +218,77 @@ struct player_update {
 
 DECLARE_RESULT_TYPE_CUSTOM(struct player_update, player_update)
 
-struct result_sexp
-make_player_update_message(const struct player_update *player_update);
+/** returns the message already encoded, ready for `message_send_encoded()`. */
+struct result_vec
+make_player_update_message(const struct player_update *player_update,
+                           enum message_encoding encoding);
 
 struct result_player_update unwrap_player_update_message(const struct sexp *msg);
 
 
 /* SCENARIO_TICK
  *
- * main message body structure.
- *  
+ * Each player is only sent the tanks it can see, see tank-view.h.  A keyframe
+ * carries every tank in view.  Between keyframes, a delta only carries the
+ * changes since `base_tick`, which the client must already have.  A client
+ * that missed a tick waits for the next keyframe.
  */
+
+/** A player with tanks in view. */
+struct tick_player {
+    u32 id;
+    char username[50];
+};
+
 struct scenario_tick {
-    struct vector* players_public_data;
+    u32 tick_number;
+    bool keyframe;
+
+    // deltas only.
+    u32 base_tick;
+
+    // a keyframe names every player with a tank in view, and a delta names
+    // the players whose tanks just came into view.  struct tick_player
+    struct vector* players;
+
+    // a keyframe carries every tank in view, and a delta carries the tanks
+    // that came into view or changed.  struct tank_delta
+    struct vector* changes;
+
+    // deltas only.  The tanks that went out of view.  struct tank_key
+    struct vector* removals;
 };
 
 void free_scenario_tick(struct scenario_tick tick);
 
 DECLARE_RESULT_TYPE_CUSTOM(struct scenario_tick, scenario_tick)
 
-struct result_sexp make_scenario_tick_message(const struct scenario_tick *tick);
+/** The tick is written straight from its vectors into the returned buffer,
+    in `encoding`, ready for `message_send_encoded()`. */
+struct result_vec make_scenario_tick_message(const struct scenario_tick *tick,
+                                             enum message_encoding encoding);
 struct result_scenario_tick unwrap_scenario_tick_message(const sexp *msg);
+
+/** The same, but the tick's vectors are allocated from `alloc`, so a reader
+    can keep them in an arena that is reset once the tick is applied. */
+struct result_scenario_tick
+unwrap_scenario_tick_message_in(const sexp *msg,
+                                const struct allocator *alloc);
 void message_scenario_tick_add_player(sexp **msg, const struct player_data* pd);
 
 /* JOIN SCENARIO
  * (JOIN-SCENARIO scenario-name)
+ *
+ * CREATE SCENARIO
+ * (CREATE-SCENARIO scenario-name)
  */
 
 struct result_sexp make_join_scenario_message(const char *scenario_name);
 struct result_sexp make_return_to_lobby_message();
 struct result_sexp make_list_scenarios_message();
-struct result_sexp make_create_scenario_message();
+struct result_sexp make_create_scenario_message(const char *scenario_name);
+
+/** the scenario name of a JOIN-SCENARIO or CREATE-SCENARIO message. */
+struct result_str unwrap_scenario_name_message(const sexp *msg);
 
 #endif
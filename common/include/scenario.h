@@ -29,6 +29,16 @@ struct scenario_params {
 #define TANK_MAX_SPEED 5
 #define TANK_SHELL_DAMAGE 75
 
+// how far a player can see from each of its tanks.
+#define TANK_SENSOR_RANGE 64
+
+// how many tanks each player has.
+#define TANKS_IN_SCENARIO 36
+
+// targets are kept within this many units of the origin on each axis, so
+// tanks, which start near it, stay well away from the edges of an s32.
+#define TANK_MAP_EXTENT (1 << 24)
+
 struct tank { // TODO change out these x/y fields with coordinate fields.
     u32 health;
     enum tank_command cmd;
@@ -64,4 +74,19 @@ struct vector *player_public_data_get_all(const struct vector *player_data);
 
 /** frees all the `struct player_public_data` elements in the vector. */
 void free_all_player_public_data(struct vector *player_public_data);
+
+/** Identifies a tank by its player's id, and its index in that player's
+    tanks. */
+struct tank_key {
+    u32 player_id;
+    u32 tank;
+};
+
+/** A tank's position and health, as a player last saw it. */
+struct tank_delta {
+    u32 player_id;
+    u32 tank;
+    struct coord pos;
+    u32 health;
+};
 #endif
@@ -10,6 +10,7 @@
 
 #include "sexp/sexp-base.h"  // IWYU pragma: export
 #include "sexp/sexp-io.h"    // IWYU pragma: export
+#include "sexp/sexp-pool.h"  // IWYU pragma: export
 #include "sexp/sexp-utils.h" // IWYU pragma: export
 
 #endif
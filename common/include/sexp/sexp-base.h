@@ -14,10 +14,15 @@
 
     2. The `SEXP_MEMORY_TREE` method allocates memory for every cons/atom in a
     sexp.
+
+    3. The `SEXP_MEMORY_BORROWED` method is only used by `sexp_read()`.  It is a
+    linear sexp whose symbols and strings are not copied; they point into the
+    string that was read.  The sexp is only valid while that string is.
 */
 enum sexp_memory_method {
     SEXP_MEMORY_LINEAR,
-    SEXP_MEMORY_TREE
+    SEXP_MEMORY_TREE,
+    SEXP_MEMORY_BORROWED
 };
 
 /** Type of S-Expression (sexp) element.
@@ -67,36 +72,49 @@ struct cons {
         
     Linear S-Expressions
     ============================================================================
-    When initialized through `make_sexp()`, the caller will receive a handle to
-    an sexp.  If a function such as `sexp_append()` is called on a child sexp,
-    it could require that the sexp be realloc'ed.  The root sexp isn't passed
-    into any utility functions to maintain transparency between memory layouts.
-    This means that if a realloc occurs, the caller will have a bad handle to
-    the root sexp, causing a memory leak.
+    When initialized through `make_sexp()` or `sexp_read()`, the caller will
+    receive a handle to an sexp.  If a function such as `sexp_push()` is called
+    on a child sexp, it could require that the sexp be realloc'ed.  The root
+    sexp isn't passed into any utility functions to maintain transparency
+    between memory layouts.  This means that if a realloc occurs, the caller
+    would have a bad handle to the root sexp, causing a memory leak.
 
     To solve this, a linear sexp performs two memory allocations.  The result of
-    the first is passed to the caller, and is never realloc'ed.  It contains the
-    result of the second allocation, which is the actual sexp handle.
+    the first is passed to the caller, and is never realloc'ed.  It is of type
+    `SEXP_LINEAR_ROOT`, and its data contains a pointer to the second
+    allocation, a `struct sexp_linear_block`.  The block holds the capacity and
+    used length of the allocation, a pointer back to the handle, and then every
+    sexp in the expression, one after another.  All of the utility functions
+    accept the handle in place of the value it contains.
+
+    The first sexp in the block is the value the user wants to encode, and is
+    the only sexp in the block with `is_root = true`.  The rest of the block is
+    laid out in pre-order:
 
-    The first node is special in linear S-Expressions.  Regardless of the
-    desired sexp type, the root node is always of type `SEXP_LINEAR_ROOT`.  the
-    corresponding union type contains the capacity of the allocated memory,
-    along with a pointer to the sexp that represents the data the user wants to
-    encode.
+    - Atoms store their data directly after the header.  `SEXP_SYMBOL` and
+      `SEXP_STRING` are null terminated (`data_length` includes the
+      terminator), and padded to a multiple of four bytes.
 
-    The sexp pointed to in root node is also special.  It is a list with the
-    form `(ROOT_HANDLE CAPACITY VALUE)`.  `ROOT_HANDLE` points back to the
-    root node, and is of type `SEXP_LINEAR_ROOT`.  `CAPACITY` contains the
-    capacity of the sexp, and is a `SEXP_INTEGER`.  Finally, `VALUE` is whatever
-    the desired sexp is.
+    - A `SEXP_CONS` is immediately followed by its CAR.  Its `data_length` is
+      the size of the CAR in bytes, so the CDR starts right after the CAR, and
+      is either the next `SEXP_CONS` of the list or a `SEXP_LIST_TERMINATOR`.
+
+    - A `SEXP_TAG` is immediately followed by the tag, and then the atom.  Its
+      `data_length` is the size of the tag in bytes.
 
     Lists in a linear sexp are terminated with a sexp with type
     `SEXP_LIST_TERMINATOR`.  This isn't a "real" sexp type, it is only used as
-    the last element in a list.  The `data_length` field of a
-    `SEXP_LIST_TERMINATOR` is used to indicate the size of the list in bytes.
-    Thus the "parent" of any sexp can be found be jumping back from the list
-    terminator.  This can be done recursively until the sexp with `is_root =
-    true` is found.
+    the last element in a list (an empty list is a lone terminator, and is
+    considered nil).  The `data_length` field of a `SEXP_LIST_TERMINATOR` is
+    used to indicate the size of the list in bytes.  Thus the start of any list
+    can be found by jumping back from the list terminator.  Since a list that
+    is not the root is always the CAR of the `SEXP_CONS` directly before it,
+    this can be done recursively until the sexp with `is_root = true` is found.
+    This is how the block is found when a sexp is pushed to a nested list.
+
+    Pointers to sexps inside of a linear block are only valid until the next
+    function that grows the block (eg `sexp_push()`).  The pointer returned by
+    such a function is valid, and the handle is always valid.
 
     Tree S-Expressions
     ============================================================================
@@ -105,11 +123,14 @@ struct cons {
     structure.
 
     @param is_root boolean flag to indicate if the current sexp is the topmost
-    object.  Linear sexps must know the capacity of the entire block of data
-    allocated in addition to the length of used space.  This is accomplished
-    through an implicit/hidden CONS cell as the root sexp.  The CAR of this CONS
-    cell contains an integer SEXP that tracks buffer capaicity.  The CDR
-    contains the actual first element of the sexp.
+    object.  In a linear sexp, this is set on the handle and on the first sexp
+    in the block.  It is always false for tree sexps.
+
+    @param is_borrowed boolean flag, only used by linear sexps.  When set on a
+    `SEXP_SYMBOL` or `SEXP_STRING`, `data` contains a pointer to the atom in
+    the string it was read from, and `data_length` is its length.  The atom is
+    not null terminated.  When set on a handle, the block was read with
+    `SEXP_MEMORY_BORROWED`.
 
     @param sexp_type corresponds to the `sexp_type` enumeration.  This field
     specifies the format of the `data` field.
@@ -128,23 +149,40 @@ struct cons {
 struct sexp{
     u32 is_linear: 1;
     u32 is_root: 1;
+    u32 is_borrowed: 1;
     u32 sexp_type: 3;
-    u32 data_length: 27;
+    u32 data_length: 26;
     
     u8 data[];
 };
 
 typedef struct sexp sexp;
 
-#define SEXP_MAX_LENGTH (0x7ffffff)
+#define SEXP_MAX_LENGTH (0x3ffffff)
 
 union sexp_data {
     struct cons cons;
     s32 integer;
     
-    struct sexp *linear_root;
+    struct sexp_linear_block *linear_block;
+};
+
+/** Header of the single allocation that holds a linear sexp.
+
+    `length` and `capacity` are in bytes, and only count `data`.  See the
+    documentation for `struct sexp` for the layout of `data`.
+*/
+struct sexp_linear_block {
+    struct sexp *handle;
+    u32 capacity;
+    u32 length;
+
+    u8 data[];
 };
 
+/** Linear atoms are padded so every sexp header stays four byte aligned. */
+#define SEXP_LINEAR_ALIGN(n) (((n) + 3) & ~(size_t)3)
+
 /************************** ERRORS AND RETURN TYPES ***************************/
 
 #define READER_ERROR_CODE_ENUM_VALUES           \
@@ -204,7 +242,9 @@ DECLARE_RESULT_TYPE_CUSTOM(struct sexp *, sexp)
 /******************************** INITIALIZERS ********************************/
 /** Initialize a new S-Expression (sexp) object.
 
-    creates a new sexp type, using the indicated method.
+    creates a new sexp type, using the indicated method.  When `method` is
+    `SEXP_MEMORY_LINEAR`, the handle to a new block is returned.  A linear
+    `SEXP_CONS` or `SEXP_NIL` is an empty list that elements may be pushed to.
 */
 struct result_sexp make_sexp(enum sexp_type type,
                              enum sexp_memory_method method, void *data);
@@ -213,6 +253,82 @@ struct result_sexp make_integer_sexp(s32 num);
 struct result_sexp make_string_sexp(const char *str);
 struct result_sexp make_symbol_sexp(const char *sym);
 struct result_sexp make_cons_sexp();
+
+/** Frees a sexp.  For linear sexps, this must be the handle; sexps inside of
+    the block are owned by it, and freeing them does nothing. */
 void free_sexp(sexp *s);
 
+/****************************** LINEAR LAYOUT *********************************/
+/* These functions are the building blocks for the linear layout.  They are
+   used by the reader and the utility functions, and generally shouldn't be
+   needed anywhere else. */
+
+/** Create a handle to an empty linear block with at least `capacity` bytes
+    available.  The block contains no value until one is emitted into it. */
+struct result_sexp make_linear_sexp_block(size_t capacity);
+
+/** Ensure at least `n` more bytes can be added to the block without a
+    realloc. */
+struct result_void sexp_linear_reserve(struct sexp *handle, size_t n);
+
+/** If `s` is the handle of a linear sexp, return the value it contains.
+    Otherwise, `s` is returned unchanged. */
+struct sexp *sexp_linear_value(const struct sexp *s);
+
+/** Number of bytes `s` (and everything it contains) would occupy in a linear
+    block.  `s` may use either memory layout.  For a linear `SEXP_CONS`, this
+    is the size of the rest of the list, including the terminator. */
+size_t sexp_linear_size(const struct sexp *s);
+
+/** Number of bytes a new atom would occupy in a linear block. */
+size_t sexp_linear_atom_size(enum sexp_type type, const void *data);
+
+/** Append a borrowed `SEXP_SYMBOL` or `SEXP_STRING` to the end of the block.
+    Only the pointer `str` is stored, so it must outlive the block.
+
+    @return byte offset of the new sexp within the block. */
+struct result_u32 sexp_linear_emit_borrowed(struct sexp *handle,
+                                            enum sexp_type type,
+                                            const char *str, size_t length);
+
+/** Append a sexp to the end of the block.  Atoms copy `data`, which must be
+    `data_length` bytes long.  For `SEXP_CONS`, `SEXP_TAG`, and
+    `SEXP_LIST_TERMINATOR` the `data_length` field is left as zero, and must be
+    set by the caller once it is known (see `struct sexp`).
+
+    @return byte offset of the new sexp within the block. */
+struct result_u32 sexp_linear_emit(struct sexp *handle, enum sexp_type type,
+                                   const void *data, size_t data_length);
+
+/** Return the sexp at the byte offset `offset` of the block. */
+struct sexp *sexp_linear_at(const struct sexp *handle, u32 offset);
+
+/** Return the number of bytes currently used in the block. */
+u32 sexp_linear_tell(const struct sexp *handle);
+
+/** Copy `s` (either layout) into `dst`, which must have at least
+    `sexp_linear_size(s)` bytes available.
+
+    @return pointer to the byte after the last one written. */
+u8 *sexp_linear_write(u8 *dst, const struct sexp *s);
+
+/** Write a single atom to `dst`, which must have at least
+    `sexp_linear_atom_size(type, data)` bytes available.  A `SEXP_CONS` or
+    `SEXP_NIL` is written as an empty list.
+
+    @return pointer to the byte after the last one written. */
+u8 *sexp_linear_write_atom(u8 *dst, enum sexp_type type, const void *data);
+
+/** Make room for a new element at the end of the linear list `list`.  `list`
+    may be any `SEXP_CONS` in the list, or the terminator of an empty list.
+
+    A `SEXP_CONS` is inserted before the terminator, followed by `item_size`
+    uninitialized bytes for its CAR.  The sizes of every list containing `list`
+    are updated, and the block is realloc'ed if it isn't large enough.
+
+    @return pointer to the new `SEXP_CONS`.  The CAR must be written by the
+    caller.
+*/
+struct result_sexp sexp_linear_grow_list(struct sexp *list, size_t item_size);
+
 #endif
@@ -2,6 +2,7 @@
 #define SEXP_IO_H
 
 #include "sexp/sexp-base.h"
+#include "vector.h"
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -25,6 +26,66 @@
 struct result_sexp sexp_read(const char *sexp_str,
                              enum sexp_memory_method method);
 
+/** The same, but the sexp is the first `length` bytes of `sexp_str`, so the
+    netstrings in it can hold null characters.  `sexp_str[length]` must still
+    be a null character.  A netstring that runs past `length` fails with
+    SEXP_RESULT_BAD_NETSTRING_LENGTH. */
+struct result_sexp sexp_read_n(const char *sexp_str, size_t length,
+                               enum sexp_memory_method method);
+
+/** The longest netstring that is read or scanned.  A longer one fails with
+    SEXP_RESULT_BAD_NETSTRING_LENGTH. */
+#define SEXP_NETSTRING_MAX_LENGTH (1u << 24)
+
+/** Where a `struct sexp_stream` is within the text of a sexp. */
+enum sexp_stream_state {
+    SEXP_STREAM_BETWEEN,   // not inside of an atom.
+    SEXP_STREAM_DIGITS,    // a number, or the length of a netstring.
+    SEXP_STREAM_NETSTRING, // inside of a netstring's data.
+    SEXP_STREAM_SYMBOL,    // inside of an unescaped symbol.
+    SEXP_STREAM_ESCAPED,   // inside of an |escaped symbol|.
+    SEXP_STREAM_STRING,    // inside of a "string".
+    SEXP_STREAM_TOO_LONG,  // after a netstring that is too long to scan.
+};
+
+/** Finds where a text sexp ends while it is still arriving, without scanning
+    any byte twice.  Parens inside of strings, escaped symbols, and netstrings
+    are skipped the same way `sexp_read()` skips them.
+
+    Initialize with `sexp_stream_init()`.
+*/
+struct sexp_stream {
+    enum sexp_stream_state state;
+    u32 depth;
+
+    // the length of the netstring while reading SEXP_STREAM_DIGITS, and the
+    // number of bytes left in it while reading SEXP_STREAM_NETSTRING.
+    u32 netstring_length;
+
+    // a tag's atom is part of the tag, so it doesn't end a top-level sexp.
+    bool in_tag;
+};
+
+void sexp_stream_init(struct sexp_stream *stream);
+
+/** Scans the next `length` bytes of a text sexp.
+
+    Scanning stops just after the end of the first complete top-level sexp,
+    and `*complete` is set.  The stream is then ready to scan the next sexp.
+    A top-level atom that isn't quoted is only complete once the byte after it
+    has been scanned.
+
+    Malformed text is not detected here.  It is reported by `sexp_read()` once
+    the sexp is complete.  The exception is a netstring longer than
+    SEXP_NETSTRING_MAX_LENGTH, since the text after it can't be scanned: the
+    scan stops just after its length with `*complete` set, and the stream is
+    left in SEXP_STREAM_TOO_LONG until it is initialized again.
+
+    @return the number of bytes scanned.
+*/
+size_t sexp_stream_scan(struct sexp_stream *stream, const char *data,
+                        size_t length, bool *complete);
+
 /** Converts the S-Expression (sexp) to a string
 
     WARNING, this result must be free'ed!
@@ -41,6 +102,102 @@ struct result_str sexp_serialize(const struct sexp *sexp);
  */
 struct result_vec sexp_serialize_vec(const struct sexp *sexp);
 
+/******************************* BINARY ENCODING ******************************/
+/** The binary encoding is a compact alternative to the text transport.  Every
+    sexp starts with a one byte `enum sexp_binary_node`.
+
+    - integers are followed by their zigzag encoded value as a varint.
+    - symbols and strings are followed by their length as a varint, and then
+      their bytes.
+    - tags are followed by the binary tag and atom.
+    - lists are followed by their elements, and closed with `SEXP_BINARY_END`.
+
+    Varints are little-endian base 128 (LEB128), and are at most
+    `SEXP_BINARY_VARINT_MAX` bytes long.
+*/
+enum sexp_binary_node {
+    SEXP_BINARY_INTEGER = 0x01,
+    SEXP_BINARY_SYMBOL  = 0x02,
+    SEXP_BINARY_STRING  = 0x03,
+    SEXP_BINARY_TAG     = 0x04,
+    SEXP_BINARY_LIST    = 0x05,
+    SEXP_BINARY_END     = 0x06,
+};
+
+#define SEXP_BINARY_VARINT_MAX 5
+
+/** The deepest lists and tags can be nested, counting the list that
+    `sexp_read_binary_list()` returns.  Deeper sexps fail to read. */
+#define SEXP_BINARY_MAX_DEPTH 64
+
+/** Writes `value` to `dst` as a varint.  `dst` must have room for
+    `SEXP_BINARY_VARINT_MAX` bytes.
+
+    @return the number of bytes written. */
+u32 sexp_binary_put_varint(u8 *dst, u32 value);
+
+/** Reads a varint from the first `length` bytes of `data` into `value`.
+
+    @return the number of bytes read, or 0 if the varint is truncated or
+            malformed. */
+u32 sexp_binary_get_varint(const u8 *data, size_t length, u32 *value);
+
+/** Appends the binary encoding of the sexp to the end of `buffer`.
+
+    @return the number of bytes appended. */
+struct result_s32 sexp_serialize_binary(const struct sexp *sexp,
+                                        struct vector *buffer);
+
+/** Reads every binary sexp in `data` as the elements of a single list.  When
+    `head` is not NULL, it is added to the front of the list as a symbol.
+
+    Only the linear and borrowed memory methods are supported.  Borrowed
+    symbols and strings point into `data`, and `head` is always borrowed by a
+    borrowed sexp.
+
+    @param head optional symbol at the start of the list.
+    @param data the binary sexps.
+    @param length length of `data` in bytes.
+    @param method `SEXP_MEMORY_LINEAR` or `SEXP_MEMORY_BORROWED`.
+    @return the list, or an error if `data` is malformed.
+*/
+struct result_sexp sexp_read_binary_list(const char *head, const void *data,
+                                         size_t length,
+                                         enum sexp_memory_method method);
+
+/********************************* SEXP WRITER ********************************/
+enum sexp_encoding {
+    SEXP_ENCODING_TEXT,
+    SEXP_ENCODING_BINARY,
+};
+
+/** Writes a sexp straight to a buffer, one element at a time, without building
+    it first.  The output is the same as serializing the equivalent sexp with
+    `sexp_serialize()` or `sexp_serialize_binary()`.
+
+    Initialize with `sexp_writer_init()`.  Every list that is begun must be
+    ended.
+*/
+struct sexp_writer {
+    struct vector *buffer;
+    enum sexp_encoding encoding;
+
+    // text elements after the first in a list are separated by a space.
+    bool needs_space;
+};
+
+/** Elements are appended to the end of `buffer`. */
+void sexp_writer_init(struct sexp_writer *writer, struct vector *buffer,
+                      enum sexp_encoding encoding);
+
+struct result_void sexp_write_begin_list(struct sexp_writer *writer);
+struct result_void sexp_write_end_list(struct sexp_writer *writer);
+struct result_void sexp_write_int(struct sexp_writer *writer, s32 integer);
+struct result_void sexp_write_sym(struct sexp_writer *writer,
+                                  const char *sym, size_t length);
+struct result_void sexp_write_str(struct sexp_writer *writer,
+                                  const char *str, size_t length);
+
 /* TODO finish documenting this function*/
 /** Serialize the sexp and send it to the specified file. */
 struct result_s32 sexp_fprint(const struct sexp*, FILE*);
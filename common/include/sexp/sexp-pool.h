@@ -0,0 +1,52 @@
+#ifndef SEXP_POOL_H
+#define SEXP_POOL_H
+
+#include "nonstdint.h"
+#include "sexp/sexp-base.h"
+
+#include <stddef.h>
+
+/**************************** SEXP NODE ALLOCATOR *****************************/
+/** Size-class pool allocator for tree sexp nodes and linear handles.
+
+    Most tree nodes are the same few sizes: cons cells and integers hold a
+    `union sexp_data`, and most symbols and strings are short.  Nodes of those
+    sizes are carved out of large slabs, and kept on a free list per size class
+    when they're freed, so making and freeing a message rarely reaches malloc.
+    Larger nodes are malloc'ed on their own.
+
+    Each thread has its own free lists, so the pool rarely locks.  A node can
+    be freed on a different thread than it was made on, in which case it goes
+    onto the freeing thread's lists.  So that a thread that only frees doesn't
+    hoard nodes while another keeps allocating slabs, a thread only keeps a
+    couple of slabs' worth of free nodes per size class, and gives the rest
+    back to a shared pool that threads refill from before allocating a slab.
+    Slabs are never freed, but the pool only holds about as much memory as
+    the most nodes that were alive at once.
+*/
+
+/** the number of size classes.  Nodes are 24, 32, or 64 bytes. */
+#define SEXP_POOL_CLASSES 3
+
+/** Returns an uninitialized node with room for `data_length` bytes of data,
+    or NULL. */
+struct sexp *sexp_pool_alloc(size_t data_length);
+
+/** Frees a node made by `sexp_pool_alloc()`.  Its `data_length` has to be
+    the one it was allocated with. */
+void sexp_pool_free(struct sexp *node);
+
+/** Nodes freed together are gathered here, and handed back to the pool all
+    at once by `sexp_pool_free_batch()`. */
+struct sexp_pool_batch {
+    void *heads[SEXP_POOL_CLASSES];
+    void *tails[SEXP_POOL_CLASSES];
+    size_t counts[SEXP_POOL_CLASSES];
+};
+
+#define SEXP_POOL_BATCH_INIT {0}
+
+void sexp_pool_batch_add(struct sexp_pool_batch *batch, struct sexp *node);
+void sexp_pool_free_batch(struct sexp_pool_batch *batch);
+
+#endif
@@ -102,6 +102,44 @@ struct result_sexp sexp_last(sexp *list);
 struct result_sexp sexp_rlast(struct result_sexp list);
 
 
+/******************************** LIST BUILDER ********************************/
+/** Builds a list by appending to its end.  The `sexp_push_*()` functions find
+    the end of the list on every call, so pushing n elements onto a list takes
+    O(n^2) time.  The builder remembers the last cons, so each push is O(1).
+
+    The list may only be changed through the builder until
+    `sexp_builder_finish()` hands it to the caller.  Like `sexp_push()`, pushing
+    an item onto a linear list copies it into the block and frees it.
+*/
+struct sexp_list_builder {
+    sexp *list;
+
+    // the last cons in the list, or NULL while the list is empty.
+    sexp *tail;
+};
+
+/** Start building an empty list with the given memory layout. */
+struct result_void sexp_builder_init(struct sexp_list_builder *builder,
+                                     enum sexp_memory_method method);
+
+/** Put `item` at the end of the list, unless `item` is an error.
+
+    @return the new last cons of the list, or an error.
+*/
+struct result_sexp sexp_builder_push(struct sexp_list_builder *builder,
+                                     struct result_sexp item);
+
+struct result_sexp sexp_builder_push_integer(struct sexp_list_builder *builder,
+                                             s32 num);
+struct result_sexp sexp_builder_push_string(struct sexp_list_builder *builder,
+                                            const char *str);
+struct result_sexp sexp_builder_push_symbol(struct sexp_list_builder *builder,
+                                            const char *sym);
+
+/** Return the built list.  An empty tree list is NIL. */
+sexp *sexp_builder_finish(struct sexp_list_builder *builder);
+
+
 /******************************** LIST PUSHERS ********************************/
 /** Create a new integer S-Expression and put it at the end of list
 
@@ -196,7 +234,8 @@ struct result_s32 sexp_int_val(const sexp *s);
 */
 struct result_s32 sexp_rint_val(struct result_sexp s);
 
-/** Returns the string value of the sexp.  sexp must be of type SEXP_STRING.
+/** Returns the string value of the sexp.  sexp must be of type SEXP_STRING,
+    and must not be borrowed (see `sexp_view_val()`).
 
     @return string value of sexp
 */
@@ -210,6 +249,7 @@ struct result_str sexp_str_val(const sexp *s);
 struct result_str sexp_rstr_val(struct result_sexp s);
 
 /** Returns the symbol value of the sexp.  sexp must be of type SEXP_SYMBOL,
+    and must not be borrowed (see `sexp_view_val()`).
 
     @return symbol value of sexp
 */
@@ -222,6 +262,22 @@ struct result_str sexp_sym_val(const sexp *s);
 */
 struct result_str sexp_rsym_val(struct result_sexp s);
 
+/** A symbol or string, which is not necessarily null terminated. */
+struct sexp_view {
+    const char *str;
+    u32 length;
+};
+
+DECLARE_RESULT_TYPE_CUSTOM(struct sexp_view, sexp_view)
+
+/** Returns a view of the data in a SEXP_SYMBOL or SEXP_STRING.  This works for
+    every memory layout, and is the only way to get the value of a borrowed
+    atom.  Nothing is copied; the view is only valid as long as the sexp is.
+
+    @return the location and length of the atom, not including any terminator.
+*/
+struct result_sexp_view sexp_view_val(const sexp *s);
+
 struct result_sexp sexp_tag_get_tag(const sexp *s);
 struct result_sexp sexp_tag_get_atom(const sexp *s);
 
@@ -0,0 +1,57 @@
+#ifndef SPATIAL_GRID_H
+#define SPATIAL_GRID_H
+
+#include "error.h"
+#include "nonstdint.h"
+#include "scenario.h"
+#include "vector.h"
+
+/**
+ * A uniform grid of square cells, which indexes items by their position.
+ *
+ * Items are identified by a dense id, from 0 up to the grid's length.  The map
+ * has no bounds, so the cells are hashed into a fixed number of buckets, each
+ * a doubly linked list threaded through per-item arrays.  Inserting, moving,
+ * and finding the item at a position are O(1), as long as items are spread
+ * out.
+ */
+struct spatial_grid {
+    s32 cell_size;
+
+    u32 bucket_mask;
+    struct vector *buckets; // u32 first item in each bucket
+
+    // indexed by item id.
+    struct vector *positions; // struct coord
+    struct vector *next;      // u32
+    struct vector *prev;      // u32
+};
+
+/** marks the end of a bucket's list. */
+#define SPATIAL_GRID_NONE UINT32_MAX
+
+struct result_void make_spatial_grid(struct spatial_grid *grid, s32 cell_size);
+void free_spatial_grid(struct spatial_grid *grid);
+
+/**
+ * Removes every item, and makes room for ids 0 to `len` - 1.
+ *
+ * The ids have to be inserted again before they are used.
+ */
+struct result_void spatial_grid_reset(struct spatial_grid *grid, u32 len);
+
+void spatial_grid_insert(struct spatial_grid *grid, u32 id, struct coord pos);
+void spatial_grid_move(struct spatial_grid *grid, u32 id, struct coord pos);
+
+/** Returns the lowest id of the items at `pos`, or SPATIAL_GRID_NONE. */
+u32 spatial_grid_find(const struct spatial_grid *grid, struct coord pos);
+
+/**
+ * Pushes the id of every item within `radius` of `center` onto `ids`, a
+ * vector of u32.  The ids are in no particular order.
+ */
+struct result_void spatial_grid_query_radius(const struct spatial_grid *grid,
+                                             struct coord center, s32 radius,
+                                             struct vector *ids);
+
+#endif
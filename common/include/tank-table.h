@@ -0,0 +1,92 @@
+#ifndef TANK_TABLE_H
+#define TANK_TABLE_H
+
+#include "error.h"
+#include "nonstdint.h"
+#include "scenario.h"
+#include "spatial-grid.h"
+
+#include <stdbool.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define TANK_KERNEL_X86
+#endif
+
+/**
+ * Every tank in a scenario, stored as a structure of arrays indexed by tank id.
+ *
+ * Each pass of the simulation only reads a few of a tank's fields, so keeping
+ * each field in its own contiguous array lets a pass stream through just the
+ * memory it needs.
+ *
+ * `target` is where a TANK_MOVE tank moves to, or where a TANK_FIRE tank aims.
+ */
+struct tank_table {
+    u32 len;
+    u32 capacity;
+
+    u32 *health;
+    enum tank_command *cmd;
+    s32 *pos_x, *pos_y;
+    s32 *target_x, *target_y;
+};
+
+void make_tank_table(struct tank_table *table);
+void free_tank_table(struct tank_table *table);
+
+/** Appends a tank, whose id is the table's old length. */
+struct result_void tank_table_push(struct tank_table *table,
+                                   const struct tank *tank);
+
+/** Removes `count` tanks starting at `first`.  The ids of the tanks after
+    them shift down by `count`. */
+void tank_table_remove(struct tank_table *table, u32 first, u32 count);
+
+/*
+ * The passes of a tick.  Each one only touches the tanks from `first` up to,
+ * but not including, `last`, so disjoint ranges can run on different threads
+ * at the same time.
+ */
+
+/** Heals every TANK_HEAL tank, up to 100 health. */
+void tank_table_heal(struct tank_table *table, u32 first, u32 last);
+
+/**
+ * Adds the damage of every shot fired by a TANK_FIRE tank to `damage`, which
+ * is indexed by the id of the tank that was hit.  The grid holds every tank's
+ * position.  Nothing's health changes until the damage is applied.
+ *
+ * Returns the number of shots that hit.
+ */
+u32 tank_table_fire(const struct tank_table *table,
+                    const struct spatial_grid *grid, u32 first, u32 last,
+                    u32 *damage);
+
+/**
+ * Takes the damage in each of the `len` arrays off the tanks' health, and
+ * zeroes it.  Damage adds up the same in any order, so it doesn't matter
+ * which array a shot was gathered into.
+ */
+void tank_table_apply_damage(struct tank_table *table, u32 first, u32 last,
+                             u32 *const *damage, size_t len);
+
+/** The ways to run a pass over the table.  They all give the same results,
+    bit for bit, but the vector kernels go over several tanks at once. */
+enum tank_kernel {
+    TANK_KERNEL_SCALAR,
+    TANK_KERNEL_SSE2,  // 4 tanks at a time
+    TANK_KERNEL_AVX2,  // 8 tanks at a time
+
+    TANK_KERNEL_COUNT,
+};
+
+/** whether this CPU can run `kernel`. */
+bool tank_kernel_supported(enum tank_kernel kernel);
+
+/** Moves every TANK_MOVE tank towards its target, at most TANK_MAX_SPEED
+    units, using the widest kernel this CPU supports. */
+void tank_table_move(struct tank_table *table);
+void tank_table_move_with(struct tank_table *table, enum tank_kernel kernel);
+void tank_table_move_range(struct tank_table *table, u32 first, u32 last);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef TANK_VIEW_H
+#define TANK_VIEW_H
+
+#include "error.h"
+#include "nonstdint.h"
+#include "scenario.h"
+#include "spatial-grid.h"
+#include "vector.h"
+
+/**
+ * Interest management: what a player can see of its scenario.
+ *
+ * A player sees all of its own tanks, and every other tank within
+ * TANK_SENSOR_RANGE of one of them.  A view is a vector of `struct
+ * tank_delta`, sorted by player id and then tank, so two views can be compared
+ * in a single pass.
+ */
+
+/**
+ * The tanks that views are taken from.
+ *
+ * `grid` holds every tank's position, by tank id.  The `p`th player owns the
+ * `tanks_per_player` tanks starting at id `p * tanks_per_player`, and
+ * `player_ids` must be ascending.
+ */
+struct tank_view_source {
+    const struct spatial_grid *grid;
+    const u32 *health;
+
+    const u32 *player_ids;
+    u32 num_players;
+    u32 tanks_per_player;
+};
+
+/**
+ * Replaces `view` with what the `player`th player of `src` can see.
+ *
+ * `scratch` is a vector of u32, which holds the ids found along the way.
+ */
+struct result_void tank_view_collect(const struct tank_view_source *src,
+                                     u32 player, struct vector *scratch,
+                                     struct vector *view);
+
+/**
+ * Compares the view a player was last sent, `was`, with the one it has now.
+ *
+ * Pushes a `struct tank_delta` onto `changes` for every tank that came into
+ * view, moved or whose health changed, and a `struct tank_key` onto `removals`
+ * for every tank that went out of view.  The id of every player with a tank in
+ * `now`, but none in `was`, is pushed onto `new_players`, a vector of u32.
+ *
+ * Returns -1 if allocation fails.
+ */
+int tank_view_diff(const struct vector *was, const struct vector *now,
+                   struct vector *changes, struct vector *removals,
+                   struct vector *new_players);
+
+/** Pushes the id of every player with a tank in `view` onto `players`, a
+    vector of u32, in order.  Returns -1 if allocation fails. */
+int tank_view_players(const struct vector *view, struct vector *players);
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef TICK_SCHEDULER_H
+#define TICK_SCHEDULER_H
+
+#include "nonstdint.h"
+
+#include <stdbool.h>
+
+/**
+ * Fixed timestep tick scheduling.
+ *
+ * The nth tick is due `n` periods after the scheduler started, on the
+ * CLOCK_MONOTONIC clock, so deadlines don't drift however long each tick
+ * takes.  A tick that finishes after the next deadline is an overrun, and the
+ * scheduler's policy decides what happens to the deadlines that were missed.
+ *
+ * The scheduler doesn't sleep or read the clock itself, the caller passes in
+ * the time, which keeps the policies testable.
+ */
+
+enum tick_overrun_policy {
+    // drop the missed ticks, and wait for the next deadline on the schedule.
+    TICK_OVERRUN_SKIP,
+
+    // run the missed ticks back to back, up to TICK_MAX_CATCH_UP of them,
+    // then skip the rest.
+    TICK_OVERRUN_CATCH_UP,
+
+    // push every later deadline back, so the simulation runs slower instead
+    // of dropping ticks.
+    TICK_OVERRUN_SLOW,
+};
+
+#define TICK_MAX_CATCH_UP 5
+
+struct tick_config {
+    u64 period_ns;
+    enum tick_overrun_policy policy;
+};
+
+/** how late ticks started, relative to their deadlines. */
+struct tick_stats {
+    u64 ticks;
+    u64 overruns;
+    u64 skipped;
+
+    u64 jitter_min_ns;
+    u64 jitter_max_ns;
+    u64 jitter_total_ns;
+};
+
+struct tick_scheduler {
+    struct tick_config config;
+
+    // when the next tick is due.
+    u64 deadline_ns;
+
+    // ticks still owed after an overrun, with TICK_OVERRUN_CATCH_UP.
+    u32 catch_up;
+
+    struct tick_stats stats;
+};
+
+/** the current CLOCK_MONOTONIC time. */
+u64 tick_clock_now(void);
+
+void make_tick_scheduler(struct tick_scheduler *sched,
+                         struct tick_config config, u64 now_ns);
+
+/** Records that the tick due at `deadline_ns` started at `now_ns`. */
+void tick_scheduler_begin(struct tick_scheduler *sched, u64 now_ns);
+
+/**
+ * Schedules the next tick, once the last one finished at `now_ns`.
+ *
+ * Returns true if the next tick should run right away, to catch up.
+ * Otherwise, the next tick is due at `deadline_ns`.
+ */
+bool tick_scheduler_end(struct tick_scheduler *sched, u64 now_ns);
+
+/** Returns the stats since the last call, and starts a new window. */
+struct tick_stats tick_scheduler_take_stats(struct tick_scheduler *sched);
+
+const char *tick_overrun_policy_name(enum tick_overrun_policy policy);
+
+/** Returns -1 if `name` isn't a policy's name. */
+int tick_overrun_policy_parse(const char *name,
+                              enum tick_overrun_policy *policy);
+
+#endif
@@ -1,8 +1,10 @@
 #ifndef VECTOR_H
 #define VECTOR_H
 
+#include "allocator.h"
 #include "error.h"
 
+#include <stdbool.h>
 #include <stddef.h>
 
 /**
@@ -27,10 +29,30 @@ DECLARE_RESULT_TYPE_CUSTOM(vector *, vec)
  * this parameter is zero, the "default" value of 10 will be used. Otherwise,
  * this parameter can be used to minimize the amount of calls to `vec_reserve`.
  *
+ * the allocated space isn't zeroed, see `vec_set_zeroing`.
+ *
  * @return NULL if failed to allocate space, a pointer to the vector otherwise.
  */
 struct vector* make_vector(size_t elem_len, size_t size_hint);
 
+/**
+ * initialize a new vector, which allocates from `alloc`.
+ *
+ * the vector itself is allocated from `alloc` too, and so are its data when
+ * it grows.  `make_vector` is the same as this with `g_system_allocator`.  A
+ * vector made with an arena's allocator mustn't be used after the arena is
+ * reset, and doesn't have to be freed before then.
+ *
+ * @param[in] alloc the allocator to use.  It is copied, so it doesn't have to
+ * outlive the vector, but whatever it allocates from does.
+ * @param[in] elem_len the size of individual elements.
+ * @param[in] size_hint as for `make_vector`.
+ *
+ * @return NULL if failed to allocate space, a pointer to the vector otherwise.
+ */
+struct vector* make_vector_in(const struct allocator *alloc, size_t elem_len,
+                              size_t size_hint);
+
 /**
  * frees the resources used by vector.
  *
@@ -51,7 +73,9 @@ size_t vec_element_len(const struct vector* vec);
  *
  * This function will not reallocate unless necessary. It is also not garunteed
  * that the capacity of the vector will be exactly n after calling this
- * function. emphasis on *at least* n elements. 
+ * function. emphasis on *at least* n elements. When it does reallocate, the
+ * capacity is at least doubled, so growing a vector one element at a time
+ * only reallocates a logarithmic number of times. The new space isn't zeroed.
  *
  * @param[in,out] vec The initialized vector for which to acquire additional
  * resources.
@@ -95,6 +119,9 @@ int vec_pushn(struct vector* vec, const void* src, size_t n);
  * makes the vector exactly `n` elements in length, padding/truncating as
  * necessary.
  *
+ * the padding is uninitialized, unless zeroing is turned on with
+ * `vec_set_zeroing`.
+ *
  * @param[in,out] vec the vector to resize.
  * @param[in] n the new length of the vector.
  *
@@ -103,6 +130,37 @@ int vec_pushn(struct vector* vec, const void* src, size_t n);
  */
 int vec_resize(struct vector* vec, size_t n);
 
+/**
+ * turns zeroing on or off.  While it's on, `vec_resize` zeroes the elements it
+ * adds.  It's off for a new vector.
+ *
+ * @param[in,out] vec the vector to change.
+ * @param[in] zeroing whether to zero padding from now on.
+ */
+void vec_set_zeroing(struct vector* vec, bool zeroing);
+
+/**
+ * appends `n` uninitialized elements, for the caller to write in place.
+ *
+ * this saves copying elements that are built up somewhere else first. the
+ * pointer is invalidated like one from `vec_ref`, by anything that changes the
+ * vector's capacity.
+ *
+ * @param[in,out] vec the vector to extend.
+ * @param[in] n the number of elements to append.
+ *
+ * @return a pointer to the first new element, or NULL if there was an
+ * allocation failure, in which case the vector is left alone.
+ */
+void* vec_extend_uninit(struct vector* vec, size_t n);
+
+/**
+ * appends one uninitialized element, see `vec_extend_uninit`.
+ *
+ * @return a pointer to the new element, or NULL on an allocation failure.
+ */
+void* vec_push_uninit(struct vector* vec);
+
 /**
  * remove the last element from the vector, and copy it into `dst`.
  *
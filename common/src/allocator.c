@@ -0,0 +1,35 @@
+#include "allocator.h"
+
+#include <stdlib.h>
+
+void *system_allocator_resize(void *ctx, void *ptr, size_t old_size,
+                              size_t new_size) {
+    (void)ctx;
+    (void)old_size;
+    return realloc(ptr, new_size);
+}
+
+void system_allocator_release(void *ctx, void *ptr, size_t size) {
+    (void)ctx;
+    (void)size;
+    free(ptr);
+}
+
+const struct allocator g_system_allocator = {
+    .resize = &system_allocator_resize,
+    .release = &system_allocator_release,
+};
+
+void *allocator_alloc(const struct allocator *alloc, size_t size) {
+    return alloc->resize(alloc->ctx, NULL, 0, size);
+}
+
+void *allocator_resize(const struct allocator *alloc, void *ptr,
+                       size_t old_size, size_t new_size) {
+    return alloc->resize(alloc->ctx, ptr, old_size, new_size);
+}
+
+void allocator_release(const struct allocator *alloc, void *ptr, size_t size) {
+    if (ptr != NULL)
+        alloc->release(alloc->ctx, ptr, size);
+}
@@ -0,0 +1,137 @@
+#include "arena.h"
+#include "error.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct arena_block {
+    struct arena_block *next; // the block before this one
+    size_t capacity;
+    _Alignas(max_align_t) u8 data[];
+};
+
+/** chains a block with room for `capacity` bytes onto the arena. */
+int arena_push_block(struct arena *arena, size_t capacity) {
+    struct arena_block *block = malloc(sizeof(struct arena_block) + capacity);
+    if (block == NULL)
+        return -1;
+
+    block->next = arena->blocks;
+    block->capacity = capacity;
+    arena->blocks = block;
+    arena->used = 0;
+    return 0;
+}
+
+struct result_void make_arena(struct arena *arena, size_t size) {
+    arena->blocks = NULL;
+    if (arena_push_block(arena, size) < 0)
+        return RESULT_MSG_ERROR(void, "failed to allocate arena");
+
+    return result_void_ok(0);
+}
+
+/** frees the blocks before the newest one. */
+void arena_free_old_blocks(struct arena *arena) {
+    struct arena_block *block = arena->blocks->next;
+    arena->blocks->next = NULL;
+
+    while (block != NULL) {
+        struct arena_block *next = block->next;
+        free(block);
+        block = next;
+    }
+}
+
+void free_arena(struct arena *arena) {
+    if (arena->blocks == NULL)
+        return;
+
+    arena_free_old_blocks(arena);
+    free(arena->blocks);
+    arena->blocks = NULL;
+}
+
+void *arena_alloc(struct arena *arena, size_t size, size_t align) {
+    struct arena_block *block = arena->blocks;
+    size_t offset = (arena->used + align - 1) & ~(align - 1);
+
+    if (offset + size > block->capacity) {
+        size_t capacity = block->capacity * 2;
+        if (capacity < size)
+            capacity = size;
+
+        if (arena_push_block(arena, capacity) < 0)
+            return NULL;
+
+        block = arena->blocks;
+        offset = 0;
+    }
+
+    arena->used = offset + size;
+    return &block->data[offset];
+}
+
+void arena_reset(struct arena *arena) {
+    arena->used = 0;
+    if (arena->blocks->next == NULL)
+        return;
+
+    size_t capacity = 0;
+    for (struct arena_block *block = arena->blocks; block != NULL;
+         block = block->next)
+        capacity += block->capacity;
+
+    // the newest block is the largest, so it's kept if a block that fits
+    // everything can't be had.
+    arena_free_old_blocks(arena);
+
+    struct arena_block *newest = arena->blocks;
+    if (arena_push_block(arena, capacity) < 0)
+        return;
+
+    arena->blocks->next = NULL;
+    free(newest);
+}
+
+/** whether the `size` bytes at `ptr` are the arena's last allocation. */
+bool arena_is_last(const struct arena *arena, const void *ptr, size_t size) {
+    return (const u8 *)ptr + size == &arena->blocks->data[arena->used];
+}
+
+void *arena_allocator_resize(void *ctx, void *ptr, size_t old_size,
+                             size_t new_size) {
+    struct arena *arena = ctx;
+    struct arena_block *block = arena->blocks;
+
+    // a vector that is pushed onto is usually the last thing allocated.
+    if (ptr != NULL && arena_is_last(arena, ptr, old_size)) {
+        size_t offset = (u8 *)ptr - block->data;
+        if (offset + new_size <= block->capacity) {
+            arena->used = offset + new_size;
+            return ptr;
+        }
+    }
+
+    void *moved = arena_alloc(arena, new_size, _Alignof(max_align_t));
+    if (moved != NULL && ptr != NULL)
+        memcpy(moved, ptr, old_size < new_size ? old_size : new_size);
+
+    return moved;
+}
+
+void arena_allocator_release(void *ctx, void *ptr, size_t size) {
+    struct arena *arena = ctx;
+
+    if (arena_is_last(arena, ptr, size))
+        arena->used = (u8 *)ptr - arena->blocks->data;
+}
+
+struct allocator arena_allocator(struct arena *arena) {
+    return (struct allocator) {
+        .resize = &arena_allocator_resize,
+        .release = &arena_allocator_release,
+        .ctx = arena,
+    };
+}
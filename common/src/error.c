@@ -39,7 +39,7 @@ void free_error(const struct error e) {
 /******************************* Generic Error ********************************/
 
 char *describe_msg_error(void *self) {
-    size_t len = strlen(self);
+    size_t len = strlen(self) + 1; // include the null terminator
     char *new_str = malloc(len);
     memcpy(new_str, self, len);
 
@@ -0,0 +1,132 @@
+#include "id-map.h"
+#include "error.h"
+#include "vector.h"
+
+#include <string.h>
+
+/** the map starts with this many entries, which has to be a power of 2. */
+#define ID_MAP_INITIAL_CAPACITY 16
+
+/** fills every entry of the table with ID_MAP_NONE. */
+void id_map_clear(struct id_map *map) {
+    memset(vec_dat(map->entries), 0xff,
+           vec_len(map->entries) * sizeof(struct id_map_entry));
+    map->len = 0;
+}
+
+struct result_void make_id_map(struct id_map *map) {
+    map->mask = ID_MAP_INITIAL_CAPACITY - 1;
+    map->entries = make_vector(sizeof(struct id_map_entry),
+                               ID_MAP_INITIAL_CAPACITY);
+    if (map->entries == NULL ||
+        vec_resize(map->entries, ID_MAP_INITIAL_CAPACITY) < 0) {
+        free_vector(map->entries);
+        map->entries = NULL;
+        return RESULT_MSG_ERROR(void, "failed to allocate id map");
+    }
+
+    id_map_clear(map);
+    return result_void_ok(0);
+}
+
+void free_id_map(struct id_map *map) {
+    free_vector(map->entries);
+    map->entries = NULL;
+}
+
+/** ids are often handed out in order, so they're mixed up before they're
+    masked. */
+u32 id_map_slot(const struct id_map *map, u32 id) {
+    return (id * 2654435761u) & map->mask;
+}
+
+/** returns the entry holding `id`, or the empty entry where it would go. */
+struct id_map_entry *id_map_probe(const struct id_map *map, u32 id) {
+    struct id_map_entry *entries = vec_dat(map->entries);
+
+    u32 slot = id_map_slot(map, id);
+    while (entries[slot].id != id && entries[slot].id != ID_MAP_NONE)
+        slot = (slot + 1) & map->mask;
+
+    return &entries[slot];
+}
+
+/** doubles the table, and puts every entry back in it. */
+struct result_void id_map_grow(struct id_map *map) {
+    size_t capacity = vec_len(map->entries);
+
+    struct vector *old = map->entries;
+    map->entries = make_vector(sizeof(struct id_map_entry), capacity * 2);
+    if (map->entries == NULL || vec_resize(map->entries, capacity * 2) < 0) {
+        free_vector(map->entries);
+        map->entries = old;
+        return RESULT_MSG_ERROR(void, "failed to grow id map");
+    }
+
+    map->mask = capacity * 2 - 1;
+    id_map_clear(map);
+
+    const struct id_map_entry *entries = vec_dat(old);
+    for (size_t e = 0; e < capacity; e++) {
+        if (entries[e].id == ID_MAP_NONE)
+            continue;
+
+        *id_map_probe(map, entries[e].id) = entries[e];
+        map->len++;
+    }
+
+    free_vector(old);
+    return result_void_ok(0);
+}
+
+struct result_void id_map_set(struct id_map *map, u32 id, u32 value) {
+    if (id == ID_MAP_NONE)
+        return RESULT_MSG_ERROR(void, "id %u is reserved", id);
+
+    // kept at most half full, so probes stay short.
+    if ((map->len + 1) * 2 > vec_len(map->entries))
+        RESULT_CALL(void, id_map_grow(map));
+
+    struct id_map_entry *entry = id_map_probe(map, id);
+    if (entry->id == ID_MAP_NONE)
+        map->len++;
+
+    *entry = (struct id_map_entry) { .id = id, .value = value };
+    return result_void_ok(0);
+}
+
+u32 id_map_get(const struct id_map *map, u32 id) {
+    if (id == ID_MAP_NONE)
+        return ID_MAP_NONE;
+
+    // an empty entry's value is ID_MAP_NONE too.
+    return id_map_probe(map, id)->value;
+}
+
+void id_map_remove(struct id_map *map, u32 id) {
+    if (id == ID_MAP_NONE)
+        return;
+
+    struct id_map_entry *entries = vec_dat(map->entries);
+    struct id_map_entry *entry = id_map_probe(map, id);
+    if (entry->id == ID_MAP_NONE)
+        return;
+
+    u32 hole = entry - entries;
+    map->len--;
+
+    // every entry up to the next empty one was probed past the hole, unless
+    // its own slot is between the hole and it.  Those are moved back, so
+    // they're still found.
+    for (u32 next = (hole + 1) & map->mask; entries[next].id != ID_MAP_NONE;
+         next = (next + 1) & map->mask) {
+        u32 home = id_map_slot(map, entries[next].id);
+        if (((next - home) & map->mask) < ((next - hole) & map->mask))
+            continue;
+
+        entries[hole] = entries[next];
+        hole = next;
+    }
+
+    entries[hole] = (struct id_map_entry) { ID_MAP_NONE, ID_MAP_NONE };
+}
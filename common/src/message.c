@@ -2,11 +2,14 @@
 #include "error.h"
 #include "scenario.h"
 #include "message.h"
+#include "sexp/sexp-io.h"
 #include "sexp/sexp-utils.h"
 #include "vector.h"
 #include "nonstdint.h"
 #include "enum_reflect.h"
 
+#include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <netinet/in.h>
 #include <stdbool.h>
@@ -16,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 REFLECT_ENUM(message_type, MESSAGE_TYPE_ENUM_VALUES)
@@ -25,6 +29,7 @@ IMPL_RESULT_TYPE_CUSTOM(enum message_status, message_status)
 IMPL_RESULT_TYPE_CUSTOM(struct user_credentials, user_credentials)
 IMPL_RESULT_TYPE_CUSTOM(struct player_update, player_update)   
 IMPL_RESULT_TYPE_CUSTOM(struct scenario_tick, scenario_tick)
+IMPL_RESULT_TYPE_CUSTOM(struct message_buffer *, message_buffer)
 
 void print_hex(const void *data, size_t len) {
     for (char *c = (char *)data, i = 1; c < (char *)data + len; c++, i++) {
@@ -36,24 +41,6 @@ void print_hex(const void *data, size_t len) {
     printf("\n");
 }
 
-struct result_sexp coords_vec_to_sexp(struct vector *coords) {
-    struct result_sexp r;
-    r = make_sexp(SEXP_CONS, SEXP_MEMORY_TREE, NULL);
-    if (r.status == RESULT_ERROR)
-        return r;
-
-    sexp *root = r.ok;
-
-    for (u32 i = 0; i < vec_len(coords); i++) {
-        struct coord *c = vec_ref(coords, i);
-        
-        sexp_push_integer(root, c->x);
-        sexp_push_integer(root, c->x);
-    }
-
-    return result_sexp_ok(root);
-}
-
 struct result_vec coords_sexp_to_vector(sexp *coords) {
     struct vector *vec = make_vector(sizeof(struct coord), 32);
 
@@ -85,51 +72,436 @@ struct result_vec coords_sexp_to_vector(sexp *coords) {
     return result_vec_ok(vec);
 }
 
-struct result_s32 message_send(int fd, const sexp *msg) {
-    char *msg_str;
-    RESULT_UNWRAP(s32, msg_str, sexp_serialize(msg));
+#define MESSAGE_WIRE_TYPE_INVALID 0xff
+
+/** the one byte header of a binary message, see the message table in plan.org.
+    Every status is sent as a MSG_RESPONSE_STATUS, which carries the status in
+    its body, so 0x82 and 0x83 are unused. */
+u8 message_wire_type(enum message_type type) {
+    // requests are numbered in the same order as the enum.
+    if (type < MSG_REQUEST_NULL)
+        return type;
+
+    switch (type) {
+    case MSG_RESPONSE_SCENARIO_TICK:
+        return 0x80;
+    case MSG_RESPONSE_STATUS:
+        return 0x81;
+    default:
+        return MESSAGE_WIRE_TYPE_INVALID;
+    }
+}
 
-    int bytes_sent = send(fd, msg_str, strlen(msg_str), 0);
+enum message_type message_from_wire_type(u8 wire_type) {
+    if (wire_type < MSG_REQUEST_NULL)
+        return wire_type;
+
+    switch (wire_type) {
+    case 0x80:
+        return MSG_RESPONSE_SCENARIO_TICK;
+    case 0x81:
+        return MSG_RESPONSE_STATUS;
+    default:
+        return MSG_NULL;
+    }
+}
 
+struct result_vec message_encode_text(const sexp *msg) {
+    vector *buf = make_vector(sizeof(char), 64);
+    if (buf == NULL)
+        return RESULT_MSG_ERROR(vec, "failed to allocate message buffer");
+
+    char *msg_str;
+    struct result_str r = sexp_serialize(msg);
+    if (r.status == RESULT_ERROR) {
+        free_vector(buf);
+        return result_vec_error(r.error);
+    }
+    msg_str = r.ok;
+
+    int pushed = vec_pushn(buf, msg_str, strlen(msg_str));
     free(msg_str);
+
+    if (pushed < 0) {
+        free_vector(buf);
+        return RESULT_MSG_ERROR(vec, "vector resize failed");
+    }
+
+    return result_vec_ok(buf);
+}
+
+struct result_vec message_encode_binary(const sexp *msg) {
+    u8 wire_type = message_wire_type(message_get_type(msg));
+    if (wire_type == MESSAGE_WIRE_TYPE_INVALID)
+        return RESULT_MSG_ERROR(vec, "message has no binary message type");
+
+    // the header's length depends on the body's length, so the body is written
+    // after enough space to hold the largest possible header.
+    const u32 header_max = 1 + SEXP_BINARY_VARINT_MAX;
+    vector *buf = make_vector(sizeof(u8), 64);
+    if (buf == NULL)
+        return RESULT_MSG_ERROR(vec, "failed to allocate message buffer");
+    if (vec_resize(buf, header_max) < 0) {
+        free_vector(buf);
+        return RESULT_MSG_ERROR(vec, "failed to allocate message buffer");
+    }
+
+    // the message type replaces the header symbol.
+    const sexp *body = NULL;
+    if (sexp_type(msg) == SEXP_CONS) {
+        struct result_sexp r = sexp_cdr(msg);
+        if (r.status == RESULT_ERROR) {
+            free_vector(buf);
+            return result_vec_error(r.error);
+        }
+        body = r.ok;
+    }
+
+    while (body != NULL && sexp_is_nil(body) == false) {
+        struct result_sexp car = sexp_car(body);
+        struct result_s32 r = car.status == RESULT_OK
+            ? sexp_serialize_binary(car.ok, buf)
+            : result_s32_error(car.error);
+
+        struct result_sexp cdr = r.status == RESULT_OK
+            ? sexp_cdr(body)
+            : result_sexp_error(r.error);
+
+        if (cdr.status == RESULT_ERROR) {
+            free_vector(buf);
+            return result_vec_error(cdr.error);
+        }
+        body = cdr.ok;
+    }
+
+    u32 body_length = vec_len(buf) - header_max;
+
+    u8 header[1 + SEXP_BINARY_VARINT_MAX];
+    header[0] = wire_type;
+    u32 header_length = 1 + sexp_binary_put_varint(header + 1, body_length);
+
+    u8 *frame = vec_dat(buf);
+    memcpy(frame, header, header_length);
+    memmove(frame + header_length, frame + header_max, body_length);
+    vec_resize(buf, header_length + body_length);
+
+    return result_vec_ok(buf);
+}
+
+struct result_vec message_encode(const sexp *msg,
+                                 enum message_encoding encoding) {
+    if (encoding == MESSAGE_ENCODING_BINARY)
+        return message_encode_binary(msg);
+    else
+        return message_encode_text(msg);
+}
+
+struct result_s32 message_send(int fd, const sexp *msg,
+                               enum message_encoding encoding) {
+    vector *bytes;
+    RESULT_UNWRAP(s32, bytes, message_encode(msg, encoding));
+
+    struct result_s32 r = message_send_encoded(fd, bytes);
+
+    free_vector(bytes);
+    return r;
+}
+
+struct result_s32 message_send_encoded(int fd, const struct vector *message) {
+    int bytes_sent = send(fd, vec_byte_ref(message, 0), vec_len(message), 0);
     return result_s32_ok(bytes_sent);
 }
 
-struct result_sexp message_recv(int fd, struct vector* buf) {
-    size_t space_available = vec_cap(buf) - vec_len(buf);
-    
-    if (space_available < 50) {
-        vec_reserve(buf, vec_len(buf) * 2);
-        space_available = vec_cap(buf) - vec_len(buf);
+struct result_message_buffer make_message_buffer(struct vector *bytes) {
+    struct message_buffer *buffer = malloc(sizeof(struct message_buffer));
+    if (buffer == NULL) {
+        free_vector(bytes);
+        return RESULT_MSG_ERROR(message_buffer, "failed to allocate message");
     }
 
-    int bytes_read = read(fd, (char *)vec_last(buf) + 1, space_available);
-    vec_resize(buf, vec_len(buf) + bytes_read);
+    buffer->bytes = bytes;
+    atomic_init(&buffer->refs, 1);
+
+    return result_message_buffer_ok(buffer);
+}
+
+struct message_buffer *message_buffer_retain(struct message_buffer *buffer) {
+    atomic_fetch_add_explicit(&buffer->refs, 1, memory_order_relaxed);
+    return buffer;
+}
 
-    // increases with open paren, decreases with close paren
-    s32 paren_count = 0;
-    for (char *c = vec_dat(buf); c < (char *)vec_last(buf); c++) {
-        if (*c == '(')
-            paren_count++;
-        else if (*c == ')')
-            paren_count--;
+void message_buffer_release(struct message_buffer *buffer) {
+    if (buffer == NULL)
+        return;
+
+    if (atomic_fetch_sub_explicit(&buffer->refs, 1, memory_order_acq_rel) != 1)
+        return;
+
+    free_vector(buffer->bytes);
+    free(buffer);
+}
+
+struct result_s32 message_buffer_send(int fd, const struct message_buffer *buffer,
+                                      size_t offset) {
+    if (offset >= vec_len(buffer->bytes))
+        return result_s32_ok(0);
+
+    struct iovec iov = {
+        .iov_base = vec_byte_ref(buffer->bytes, offset),
+        .iov_len = vec_len(buffer->bytes) - offset,
+    };
+    struct msghdr header = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+    // a peer that hung up shouldn't kill the server with SIGPIPE.
+    return result_s32_ok(sendmsg(fd, &header, MSG_NOSIGNAL));
+}
+
+/** starts writing a message of `type` to `buffer`.  The body is written with
+    `writer`, then the message is closed by `message_writer_finish()`.  A
+    binary message's header depends on the length of its body, so space for
+    the largest possible header is reserved in front of it. */
+struct result_void message_writer_begin(struct sexp_writer *writer,
+                                        vector *buffer,
+                                        enum message_type type,
+                                        enum message_encoding encoding) {
+    if (encoding == MESSAGE_ENCODING_BINARY) {
+        sexp_writer_init(writer, buffer, SEXP_ENCODING_BINARY);
+        if (vec_resize(buffer, 1 + SEXP_BINARY_VARINT_MAX) < 0)
+            return RESULT_MSG_ERROR(void, "vector resize failed");
+
+        return result_void_ok(0);
     }
 
-    if (paren_count < 0) {
-        // TODO this is an error state (extra close paren)
+    sexp_writer_init(writer, buffer, SEXP_ENCODING_TEXT);
+
+    const char *header = g_reflected_message_type[type];
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+    RESULT_CALL(void, sexp_write_sym(writer, header, strlen(header)));
+
+    return result_void_ok(0);
+}
+
+/** closes a message started by `message_writer_begin()`.  A binary message's
+    header is written just in front of its body, and the message is moved to
+    the start of the buffer. */
+struct result_void message_writer_finish(struct sexp_writer *writer,
+                                         enum message_type type) {
+    if (writer->encoding == SEXP_ENCODING_TEXT)
+        return sexp_write_end_list(writer);
+
+    const u32 header_max = 1 + SEXP_BINARY_VARINT_MAX;
+    u32 body_length = vec_len(writer->buffer) - header_max;
+
+    u8 header[1 + SEXP_BINARY_VARINT_MAX];
+    header[0] = message_wire_type(type);
+    u32 header_length = 1 + sexp_binary_put_varint(header + 1, body_length);
+
+    u8 *frame = vec_dat(writer->buffer);
+    memcpy(frame, header, header_length);
+    memmove(frame + header_length, frame + header_max, body_length);
+
+    if (vec_resize(writer->buffer, header_length + body_length) < 0)
+        return RESULT_MSG_ERROR(void, "vector resize failed");
+
+    return result_void_ok(0);
+}
+
+struct message_reader *make_message_reader(void) {
+    struct message_reader *reader = malloc(sizeof(struct message_reader));
+    if (reader == NULL)
+        return NULL;
+
+    reader->buf = make_vector(sizeof(char), 64);
+    if (reader->buf == NULL) {
+        free(reader);
+        return NULL;
     }
 
-    if (paren_count == 0 && vec_len(buf) > 0) {
-        // closed parenthesis, and a non-empty buffer. complete message.
+    reader->start = 0;
+    reader->scanned = 0;
+    reader->closed = false;
+    sexp_stream_init(&reader->stream);
+
+    return reader;
+}
+
+void free_message_reader(struct message_reader *reader) {
+    if (reader == NULL)
+        return;
+
+    free_vector(reader->buf);
+    free(reader);
+}
 
-        // FIXME assumes no errors can happen.
-        struct result_sexp r = sexp_read(vec_dat(buf), SEXP_MEMORY_TREE);
-        vec_resize(buf, 0);
+/** moves the message being received to the front of the buffer, dropping the
+    messages that were already returned. */
+void message_reader_compact(struct message_reader *reader) {
+    if (reader->start == 0)
+        return;
+
+    struct vector *buf = reader->buf;
+    size_t tail = vec_len(buf) - reader->start;
+    memmove(vec_dat(buf), (char *)vec_dat(buf) + reader->start, tail);
+    vec_resize(buf, tail);
+
+    reader->scanned -= reader->start;
+    reader->start = 0;
+}
 
-        return r; 
+/** marks the message at `reader->start` as returned.  It ends at `end`. */
+void message_reader_consume(struct message_reader *reader, size_t end) {
+    reader->start = end;
+    reader->scanned = end;
+    sexp_stream_init(&reader->stream);
+}
+
+/** reads a binary message from the reader's buffer.  Returns NULL if the
+    message hasn't been completely received. */
+struct result_sexp message_recv_binary(struct message_reader *reader) {
+    const u8 *data = (u8 *)vec_dat(reader->buf) + reader->start;
+    size_t length = vec_len(reader->buf) - reader->start;
+
+    u32 body_length;
+    u32 n = sexp_binary_get_varint(data + 1, length - 1, &body_length);
+    if (n == 0) {
+        if (length - 1 < SEXP_BINARY_VARINT_MAX)
+            return result_sexp_ok(NULL);
+
+        // there is no way to find the start of the next message.
+        message_reader_consume(reader, vec_len(reader->buf));
+        return RESULT_MSG_ERROR(sexp, "binary message has an invalid length");
     }
-    
-    return result_sexp_ok(NULL);
+
+    size_t header_length = 1 + n;
+    if (body_length > MESSAGE_MAX_SIZE - header_length) {
+        // the message is never buffered, so the peer is dropped.
+        message_reader_consume(reader, vec_len(reader->buf));
+        reader->closed = true;
+        return RESULT_MSG_ERROR(sexp, "binary message is too long");
+    }
+
+    if (length - header_length < body_length)
+        return result_sexp_ok(NULL);
+
+    enum message_type type = message_from_wire_type(data[0]);
+    struct result_sexp r = sexp_read_binary_list(g_reflected_message_type[type],
+                                                 data + header_length,
+                                                 body_length,
+                                                 SEXP_MEMORY_BORROWED);
+
+    message_reader_consume(reader,
+                           reader->start + header_length + body_length);
+    return r;
+}
+
+/** reads a text message from the reader's buffer.  Only the bytes that arrived
+    since the last call are scanned.  Returns NULL if the message hasn't been
+    completely received. */
+struct result_sexp message_recv_text(struct message_reader *reader) {
+    struct vector *buf = reader->buf;
+
+    bool complete;
+    reader->scanned += sexp_stream_scan(&reader->stream,
+                                        (char *)vec_dat(buf) + reader->scanned,
+                                        vec_len(buf) - reader->scanned,
+                                        &complete);
+    if (complete == false)
+        return result_sexp_ok(NULL);
+
+    // there is no way to find the start of the next message.
+    if (reader->stream.state == SEXP_STREAM_TOO_LONG) {
+        message_reader_consume(reader, vec_len(buf));
+        reader->closed = true;
+        return RESULT_MSG_ERROR(sexp, "text message has a netstring that is "
+                                "too long");
+    }
+
+    // the reader needs a null terminated string, but the next message may
+    // start right after this one.  Its first byte is put back once the
+    // message has been read, since the borrowed atoms don't include it.
+    if (vec_reserve(buf, vec_len(buf) + 1) < 0)
+        return RESULT_MSG_ERROR(sexp, "failed to allocate message buffer");
+
+    char *text = vec_dat(buf);
+    char next = text[reader->scanned];
+    text[reader->scanned] = '\0';
+
+    struct result_sexp r = sexp_read_n(text + reader->start,
+                                       reader->scanned - reader->start,
+                                       SEXP_MEMORY_BORROWED);
+
+    text[reader->scanned] = next;
+    message_reader_consume(reader, reader->scanned);
+
+    return r;
+}
+
+/** returns the next complete message in the reader's buffer, or NULL. */
+struct result_sexp message_reader_next(struct message_reader *reader) {
+    struct vector *buf = reader->buf;
+    const char *data = vec_dat(buf);
+
+    // whitespace between messages isn't part of either message.
+    if (reader->scanned == reader->start) {
+        while (reader->start < vec_len(buf) &&
+               isspace((unsigned char)data[reader->start]))
+            reader->start++;
+        reader->scanned = reader->start;
+    }
+
+    if (reader->start == vec_len(buf))
+        return result_sexp_ok(NULL);
+
+    // a text message can't start with a binary message type.
+    if (message_from_wire_type(data[reader->start]) != MSG_NULL)
+        return message_recv_binary(reader);
+    else
+        return message_recv_text(reader);
+}
+
+struct result_sexp message_recv(int fd, struct message_reader *reader) {
+    // messages that arrived together are returned before reading again.
+    struct result_sexp r = message_reader_next(reader);
+    if (r.status == RESULT_ERROR || r.ok != NULL)
+        return r;
+
+    message_reader_compact(reader);
+
+    // only the message being received is left, and it already fills the
+    // limit without being complete.
+    struct vector *buf = reader->buf;
+    if (vec_len(buf) >= MESSAGE_MAX_SIZE) {
+        message_reader_consume(reader, vec_len(buf));
+        reader->closed = true;
+        return RESULT_MSG_ERROR(sexp, "message is too long");
+    }
+
+    size_t space_available = vec_cap(buf) - vec_len(buf);
+    if (space_available < 50) {
+        size_t capacity = vec_len(buf) * 2;
+        if (capacity > MESSAGE_MAX_SIZE)
+            capacity = MESSAGE_MAX_SIZE;
+
+        if (vec_reserve(buf, capacity) < 0 && space_available == 0)
+            return RESULT_MSG_ERROR(sexp, "failed to allocate message buffer");
+        space_available = vec_cap(buf) - vec_len(buf);
+    }
+
+    // nothing past the limit is buffered.
+    if (space_available > MESSAGE_MAX_SIZE - vec_len(buf))
+        space_available = MESSAGE_MAX_SIZE - vec_len(buf);
+
+    int bytes_read = read(fd, (char *)vec_last(buf) + 1, space_available);
+    if (bytes_read == 0 ||
+        (bytes_read < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+         errno != EINTR))
+        reader->closed = true;
+
+    if (bytes_read <= 0)
+        return result_sexp_ok(NULL);
+
+    vec_resize(buf, vec_len(buf) + bytes_read);
+    return message_reader_next(reader);
 }
 
 /** returns either the enum value or a string for the enum.
@@ -148,21 +520,27 @@ struct result_sexp message_make_header(enum message_type type) {
 enum message_type message_get_type(const sexp *msg) {
     struct error e;
 
-    struct result_sexp type_sym = sexp_nth(msg, 0);
+    // messages without a body are just a header.
+    struct result_sexp type_sym = sexp_type(msg) == SEXP_SYMBOL
+        ? result_sexp_ok((sexp *)msg)
+        : sexp_nth(msg, 0);
     if (type_sym.status == RESULT_ERROR) {
         e = type_sym.error;
         goto error_condition;
     }
 
     if (sexp_type(type_sym.ok) == SEXP_SYMBOL) {
-        struct result_str msg_type_str = sexp_str_val(type_sym.ok);
+        struct result_sexp_view msg_type_str = sexp_view_val(type_sym.ok);
         if (msg_type_str.status == RESULT_ERROR) {
             e = msg_type_str.error;
             goto error_condition;
         }
 
+        struct sexp_view sym = msg_type_str.ok;
         for (int i = 0; i < MSG_NULL; i++) {
-            if (strcmp(msg_type_str.ok, g_reflected_message_type[i]) == 0)
+            const char *name = g_reflected_message_type[i];
+            if (strlen(name) == sym.length &&
+                strncmp(sym.str, name, sym.length) == 0)
                 return i;
         }
     } else if (sexp_type(type_sym.ok) == SEXP_INTEGER) {
@@ -194,9 +572,19 @@ struct result_str unwrap_text_message(const sexp *msg) {
     const sexp *first;
     RESULT_UNWRAP(str, first, sexp_nth(msg, 1));
     
-    // if first is not an integer, then it will return an error.
+    // if first is not a string, then it will return an error.
     // TODO: create a more descriptive error that includes the text message context
-    return sexp_str_val(first);
+    struct sexp_view text;
+    RESULT_UNWRAP(str, text, sexp_view_val(first));
+
+    char *str = malloc(text.length + 1);
+    if (str == NULL)
+        return RESULT_MSG_ERROR(str, "malloc returned NULL");
+
+    memcpy(str, text.str, text.length);
+    str[text.length] = '\0';
+
+    return result_str_ok(str);
 }
 
 /************************** Status Message Functions **************************/
@@ -218,35 +606,61 @@ struct result_message_status unwrap_status_message(const sexp *msg) {
         return result_message_status_error(r.error);
 }
 
-struct result_s32 message_status_send(int fd, enum message_status status, char *brief) {
+struct result_vec message_status_encode(enum message_status status,
+                                        const char *brief,
+                                        enum message_encoding encoding) {
     sexp *msg;
-    RESULT_UNWRAP(s32, msg, make_status_message(status));
+    RESULT_UNWRAP(vec, msg, make_status_message(status));
 
     // add an optional brief description
-    if (msg != NULL)
-        RESULT_CALL(s32, sexp_push_string(msg, brief));
+    if (msg != NULL && brief != NULL) {
+        struct result_sexp r = sexp_push_string(msg, brief);
+        if (r.status == RESULT_ERROR) {
+            free_sexp(msg);
+            return result_vec_error(r.error);
+        }
+    }
 
-    struct result_s32 r = message_send(fd, msg);
+    struct result_vec r = message_encode(msg, encoding);
 
     free_sexp(msg);
+    return r;
+}
+
+struct result_s32 message_status_send(int fd, enum message_status status, char *brief,
+                                      enum message_encoding encoding) {
+    vector *bytes;
+    RESULT_UNWRAP(s32, bytes, message_status_encode(status, brief, encoding));
 
+    struct result_s32 r = message_send_encoded(fd, bytes);
+
+    free_vector(bytes);
     return r;
 }
 
 /********************* User Credentials Message Functions *********************/
+/** symbol requesting a binary encoding at the end of an AUTHENTICATE
+    message. */
+const char MESSAGE_ENCODING_BINARY_SYMBOL[] = "BINARY";
+
 struct result_sexp
 make_user_credentials_message(const struct user_credentials *creds) {
-    return sexp_list(message_make_header(MSG_REQUEST_AUTHENTICATE),
-                     make_string_sexp(vec_dat(creds->username)),
-                     make_string_sexp(vec_dat(creds->password)),
-                     sexp_nil());
+    return make_user_credentials_message_str(vec_dat(creds->username),
+                                             vec_dat(creds->password),
+                                             creds->encoding);
 }
 
 struct result_sexp
-make_user_credentials_message_str(const char *username, const char *password) {
+make_user_credentials_message_str(const char *username, const char *password,
+                                  enum message_encoding encoding) {
+    // sexp_list() ends at the first nil, so a missing password must still be
+    // a string, and the text encoding, which is the default, is left out.
     return sexp_list(message_make_header(MSG_REQUEST_AUTHENTICATE),
                      make_string_sexp(username),
-                     make_string_sexp(password),
+                     make_string_sexp(password != NULL ? password : ""),
+                     encoding == MESSAGE_ENCODING_BINARY
+                         ? make_symbol_sexp(MESSAGE_ENCODING_BINARY_SYMBOL)
+                         : sexp_nil(),
                      sexp_nil());
 }
 
@@ -259,29 +673,95 @@ unwrap_user_credentials_message(const sexp *msg) {
     RESULT_UNWRAP(user_credentials, username, sexp_nth(msg, 1));
     RESULT_UNWRAP(user_credentials, password, sexp_nth(msg, 2));
 
-    char *username_str;
-    char *password_str;
-    RESULT_UNWRAP(user_credentials, username_str, sexp_str_val(username));
-    RESULT_UNWRAP(user_credentials, password_str, sexp_str_val(password));
+    struct sexp_view username_str;
+    struct sexp_view password_str;
+    RESULT_UNWRAP(user_credentials, username_str, sexp_view_val(username));
+    RESULT_UNWRAP(user_credentials, password_str, sexp_view_val(password));
 
-    // data length will be the length of the encoded string
-    creds.username = make_vector(sizeof(char), username->data_length);
-    vec_pushn(creds.username, username_str, username->data_length);
+    // the encoding is optional.  Clients that don't request one get text.
+    creds.encoding = MESSAGE_ENCODING_TEXT;
+
+    struct result_sexp encoding = sexp_nth(msg, 3);
+    if (encoding.status == RESULT_ERROR) {
+        free_error(encoding.error);
+    } else if (sexp_type(encoding.ok) == SEXP_SYMBOL) {
+        struct sexp_view sym;
+        RESULT_UNWRAP(user_credentials, sym, sexp_view_val(encoding.ok));
+
+        if (sym.length == strlen(MESSAGE_ENCODING_BINARY_SYMBOL) &&
+            strncmp(sym.str, MESSAGE_ENCODING_BINARY_SYMBOL, sym.length) == 0)
+            creds.encoding = MESSAGE_ENCODING_BINARY;
+    }
+
+    // the views aren't null terminated, but the credentials are.
+    creds.username = make_vector(sizeof(char), username_str.length + 1);
+    vec_pushn(creds.username, username_str.str, username_str.length);
+    vec_push(creds.username, "");
     
-    creds.password = make_vector(sizeof(char), password->data_length);
-    vec_pushn(creds.password, password_str, password->data_length);
+    creds.password = make_vector(sizeof(char), password_str.length + 1);
+    vec_pushn(creds.password, password_str.str, password_str.length);
+    vec_push(creds.password, "");
 
     return result_user_credentials_ok(creds);
 }
 
 
 /********************** Player Update Message Functions ***********************/
-struct result_sexp
-make_player_update_message(const struct player_update *player_update) {
-    return sexp_list(message_make_header(MSG_REQUEST_PLAYER_UPDATE),
-                     coords_vec_to_sexp(player_update->tank_target_coords),
-                     coords_vec_to_sexp(player_update->tank_instructions),
-                     sexp_nil());
+/** writes (X Y X Y ...) */
+struct result_void message_write_coords(struct sexp_writer *writer,
+                                        const struct vector *coords) {
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+
+    for (u32 i = 0; i < vec_len(coords); i++) {
+        const struct coord *c = vec_ref(coords, i);
+
+        RESULT_CALL(void, sexp_write_int(writer, c->x));
+        RESULT_CALL(void, sexp_write_int(writer, c->y));
+    }
+
+    return sexp_write_end_list(writer);
+}
+
+struct result_void
+player_update_write(struct sexp_writer *writer,
+                    const struct player_update *player_update) {
+    RESULT_CALL(void, message_write_coords(writer,
+                                           player_update->tank_target_coords));
+
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+    for (u32 i = 0; i < vec_len(player_update->tank_instructions); i++) {
+        const enum tank_command *cmd =
+            vec_ref(player_update->tank_instructions, i);
+
+        RESULT_CALL(void, sexp_write_int(writer, *cmd));
+    }
+
+    return sexp_write_end_list(writer);
+}
+
+struct result_vec
+make_player_update_message(const struct player_update *player_update,
+                           enum message_encoding encoding) {
+    vector *buffer = make_vector(sizeof(u8), 64);
+    if (buffer == NULL)
+        return RESULT_MSG_ERROR(vec, "failed to allocate message buffer");
+
+    struct sexp_writer writer;
+    struct result_void r = message_writer_begin(&writer, buffer,
+                                                MSG_REQUEST_PLAYER_UPDATE,
+                                                encoding);
+    if (r.status == RESULT_OK)
+        r = player_update_write(&writer, player_update);
+
+    if (r.status == RESULT_OK)
+        r = message_writer_finish(&writer, MSG_REQUEST_PLAYER_UPDATE);
+
+    if (r.status == RESULT_ERROR) {
+        free_vector(buffer);
+        return result_vec_error(r.error);
+    }
+
+    return result_vec_ok(buffer);
 }
 
 struct result_player_update unwrap_player_update_message(const sexp *msg) {
@@ -299,8 +779,9 @@ struct result_player_update unwrap_player_update_message(const sexp *msg) {
     update.tank_instructions = make_vector(sizeof(enum tank_command),
                                            vec_len(update.tank_target_coords));
 
+    // extra targets or commands are dropped.
     for (u32 c = 0;
-         (c < vec_len(update.tank_target_coords)) || sexp_is_nil(commands);
+         c < vec_len(update.tank_target_coords) && !sexp_is_nil(commands);
          c++) {
 
         sexp *car;
@@ -319,71 +800,272 @@ struct result_player_update unwrap_player_update_message(const sexp *msg) {
 
 /********************** Scenario Tick Message Functions ***********************/
 /*
-  (SCENARIO-TICK (USERNAME1 (X Y X Y X Y ...))
-                 (USERNAME2 (X Y X Y X Y ...))
-                 (USERNAME3 (X Y X Y X Y ...))
-                 ...)
+  (SCENARIO-TICK TICK KEYFRAME ((ID1 USERNAME1) (ID2 USERNAME2) ...)
+                               (ID TANK X Y HEALTH
+                                ID TANK X Y HEALTH
+                                ...))
+
+  (SCENARIO-TICK TICK DELTA BASE-TICK ((ID USERNAME) ...)
+                                      (ID TANK X Y HEALTH ...)
+                                      (ID TANK ID TANK ...))
  */
+const char MESSAGE_TICK_KEYFRAME_SYMBOL[] = "KEYFRAME";
+const char MESSAGE_TICK_DELTA_SYMBOL[] = "DELTA";
 
 void free_scenario_tick(struct scenario_tick tick) {
-    free_vector(tick.players_public_data);
+    free_vector(tick.players);
+    free_vector(tick.changes);
+    free_vector(tick.removals);
 }
- 
-struct result_sexp make_scenario_tick_message(const struct scenario_tick *tick) {
-    sexp *msg_root;
-    RESULT_UNWRAP(sexp, msg_root, make_cons_sexp());
 
-    struct result_sexp msg = result_sexp_ok(msg_root);
+/** writes ((ID USERNAME) ...) */
+struct result_void
+scenario_tick_write_players(struct sexp_writer *writer,
+                            const struct vector *players) {
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+
+    for (u32 p = 0; p < vec_len(players); p++) {
+        const struct tick_player *player = vec_ref(players, p);
 
-    for (u32 p = 0; p < vec_len(tick->players_public_data); p++ ) {
-        struct player_public_data *data = vec_ref(tick->players_public_data, p);
+        RESULT_CALL(void, sexp_write_begin_list(writer));
+        RESULT_CALL(void, sexp_write_int(writer, player->id));
+        RESULT_CALL(void, sexp_write_str(writer, player->username,
+                                         strlen(player->username)));
+        RESULT_CALL(void, sexp_write_end_list(writer));
+    }
 
-        struct result_sexp encoded_player_data = 
-            sexp_list(make_string_sexp(vec_dat(data->username)),
-                      coords_vec_to_sexp(data->tank_positions),
-                      sexp_nil());
+    return sexp_write_end_list(writer);
+}
 
-        msg = sexp_rpush(msg, encoded_player_data);
+/** writes (ID TANK X Y HEALTH ...) */
+struct result_void
+scenario_tick_write_changes(struct sexp_writer *writer,
+                            const struct vector *changes) {
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+
+    for (u32 c = 0; c < vec_len(changes); c++) {
+        const struct tank_delta *delta = vec_ref(changes, c);
+
+        RESULT_CALL(void, sexp_write_int(writer, delta->player_id));
+        RESULT_CALL(void, sexp_write_int(writer, delta->tank));
+        RESULT_CALL(void, sexp_write_int(writer, delta->pos.x));
+        RESULT_CALL(void, sexp_write_int(writer, delta->pos.y));
+        RESULT_CALL(void, sexp_write_int(writer, delta->health));
     }
 
-    if (msg.status == RESULT_ERROR)
-        return msg;
-    else
-        return result_sexp_ok(msg_root);
+    return sexp_write_end_list(writer);
 }
 
-struct result_scenario_tick unwrap_scenario_tick_message(const sexp *msg) {
-    struct scenario_tick tick = {
-        .players_public_data = make_vector(sizeof(struct player_public_data), 10)
-    };
+/** writes (ID TANK ...) */
+struct result_void
+scenario_tick_write_removals(struct sexp_writer *writer,
+                             const struct vector *removals) {
+    RESULT_CALL(void, sexp_write_begin_list(writer));
 
-    s32 num_players;
-    RESULT_UNWRAP(scenario_tick, num_players, sexp_length(msg));
-    num_players--; // remove the "SCENARIO-TICK" symbol
+    for (u32 r = 0; r < vec_len(removals); r++) {
+        const struct tank_key *key = vec_ref(removals, r);
 
-    sexp *player;
-    RESULT_UNWRAP(scenario_tick, player, sexp_cdr(msg))
+        RESULT_CALL(void, sexp_write_int(writer, key->player_id));
+        RESULT_CALL(void, sexp_write_int(writer, key->tank));
+    }
 
-    for (s32 i = 0; i < num_players; i++) {
-        struct player_public_data data;
-        sexp *username;
-        RESULT_UNWRAP(scenario_tick, username, sexp_nth(player, 0));
+    return sexp_write_end_list(writer);
+}
 
-        sexp *tank_coords;
-        RESULT_UNWRAP(scenario_tick, tank_coords, sexp_nth(player, 1));
+struct result_void scenario_tick_write(struct sexp_writer *writer,
+                                       const struct scenario_tick *tick) {
+    RESULT_CALL(void, sexp_write_int(writer, tick->tick_number));
+
+    if (tick->keyframe) {
+        RESULT_CALL(void, sexp_write_sym(writer, MESSAGE_TICK_KEYFRAME_SYMBOL,
+                                         strlen(MESSAGE_TICK_KEYFRAME_SYMBOL)));
+    } else {
+        RESULT_CALL(void, sexp_write_sym(writer, MESSAGE_TICK_DELTA_SYMBOL,
+                                         strlen(MESSAGE_TICK_DELTA_SYMBOL)));
+        RESULT_CALL(void, sexp_write_int(writer, tick->base_tick));
+    }
 
-        char *username_str;
-        RESULT_UNWRAP(scenario_tick, username_str, sexp_str_val(username));
+    RESULT_CALL(void, scenario_tick_write_players(writer, tick->players));
+    RESULT_CALL(void, scenario_tick_write_changes(writer, tick->changes));
 
-        data.username = make_vector(sizeof(char), username->data_length);
-        vec_pushn(data.username, username_str, username->data_length);
+    if (tick->keyframe)
+        return result_void_ok(0);
 
-        RESULT_UNWRAP(scenario_tick, data.tank_positions,
-                      coords_sexp_to_vector(tank_coords));
+    return scenario_tick_write_removals(writer, tick->removals);
+}
 
-        vec_push(tick.players_public_data, &data);
+struct result_vec
+make_scenario_tick_message(const struct scenario_tick *tick,
+                           enum message_encoding encoding) {
+    // most of the message is a few integers per tank.
+    size_t size = 64 + vec_len(tick->players) * 64 +
+        vec_len(tick->changes) * 5 * 8;
+    if (!tick->keyframe)
+        size += vec_len(tick->removals) * 2 * 8;
+
+    vector *buffer = make_vector(sizeof(u8), size);
+    if (buffer == NULL)
+        return RESULT_MSG_ERROR(vec, "failed to allocate message buffer");
+
+    struct sexp_writer writer;
+    struct result_void r = message_writer_begin(&writer, buffer,
+                                                MSG_RESPONSE_SCENARIO_TICK,
+                                                encoding);
+    if (r.status == RESULT_OK)
+        r = scenario_tick_write(&writer, tick);
 
-        RESULT_UNWRAP(scenario_tick, player, sexp_cdr(player));
+    if (r.status == RESULT_OK)
+        r = message_writer_finish(&writer, MSG_RESPONSE_SCENARIO_TICK);
+
+    if (r.status == RESULT_ERROR) {
+        free_vector(buffer);
+        return result_vec_error(r.error);
+    }
+
+    return result_vec_ok(buffer);
+}
+
+/** reads ((ID USERNAME) ...) */
+struct result_void scenario_tick_read_players(const sexp *list,
+                                              struct vector *players) {
+    while (!sexp_is_nil(list)) {
+        sexp *player_data, *id, *username;
+        RESULT_UNWRAP(void, player_data, sexp_car(list));
+        RESULT_UNWRAP(void, id, sexp_nth(player_data, 0));
+        RESULT_UNWRAP(void, username, sexp_nth(player_data, 1));
+
+        struct tick_player player = {0};
+        RESULT_UNWRAP(void, player.id, sexp_int_val(id));
+
+        struct sexp_view username_str;
+        RESULT_UNWRAP(void, username_str, sexp_view_val(username));
+
+        size_t len = username_str.length;
+        if (len > sizeof(player.username) - 1)
+            len = sizeof(player.username) - 1;
+        memcpy(player.username, username_str.str, len);
+
+        if (vec_push(players, &player) < 0)
+            return RESULT_MSG_ERROR(void, "failed to push tick player");
+
+        RESULT_UNWRAP(void, list, sexp_cdr(list));
+    }
+
+    return result_void_ok(0);
+}
+
+/** reads `n` integers at a time from a flat list, into `fields`.  Returns
+    0 at the end of the list. */
+struct result_u8 scenario_tick_read_fields(const sexp **list, s32 *fields,
+                                             int n) {
+    if (sexp_is_nil(*list))
+        return result_u8_ok(0);
+
+    for (int f = 0; f < n; f++) {
+        sexp *car;
+        RESULT_UNWRAP(u8, car, sexp_car(*list));
+        RESULT_UNWRAP(u8, fields[f], sexp_int_val(car));
+        RESULT_UNWRAP(u8, *list, sexp_cdr(*list));
+    }
+
+    return result_u8_ok(1);
+}
+
+/** reads (ID TANK X Y HEALTH ...) */
+struct result_void scenario_tick_read_changes(const sexp *list,
+                                              struct vector *changes) {
+    for (;;) {
+        s32 fields[5];
+        u8 more;
+        RESULT_UNWRAP(void, more, scenario_tick_read_fields(&list, fields, 5));
+        if (!more)
+            return result_void_ok(0);
+
+        struct tank_delta delta = {
+            .player_id = fields[0],
+            .tank = fields[1],
+            .pos = { fields[2], fields[3] },
+            .health = fields[4],
+        };
+        if (vec_push(changes, &delta) < 0)
+            return RESULT_MSG_ERROR(void, "failed to push tank change");
+    }
+}
+
+/** reads (ID TANK ...) */
+struct result_void scenario_tick_read_removals(const sexp *list,
+                                               struct vector *removals) {
+    for (;;) {
+        s32 fields[2];
+        u8 more;
+        RESULT_UNWRAP(void, more, scenario_tick_read_fields(&list, fields, 2));
+        if (!more)
+            return result_void_ok(0);
+
+        struct tank_key key = { .player_id = fields[0], .tank = fields[1] };
+        if (vec_push(removals, &key) < 0)
+            return RESULT_MSG_ERROR(void, "failed to push tank removal");
+    }
+}
+
+struct result_void scenario_tick_read(const sexp *msg,
+                                      struct scenario_tick *tick) {
+    sexp *tick_number, *kind;
+    RESULT_UNWRAP(void, tick_number, sexp_nth(msg, 1));
+    RESULT_UNWRAP(void, kind, sexp_nth(msg, 2));
+    RESULT_UNWRAP(void, tick->tick_number, sexp_int_val(tick_number));
+
+    struct sexp_view kind_str;
+    RESULT_UNWRAP(void, kind_str, sexp_view_val(kind));
+    tick->keyframe =
+        kind_str.length == strlen(MESSAGE_TICK_KEYFRAME_SYMBOL) &&
+        strncmp(kind_str.str, MESSAGE_TICK_KEYFRAME_SYMBOL,
+                kind_str.length) == 0;
+
+    // a delta has its base tick before the players.
+    size_t n = 3;
+    if (!tick->keyframe) {
+        sexp *base_tick;
+        RESULT_UNWRAP(void, base_tick, sexp_nth(msg, n++));
+        RESULT_UNWRAP(void, tick->base_tick, sexp_int_val(base_tick));
+    }
+
+    sexp *players, *changes;
+    RESULT_UNWRAP(void, players, sexp_nth(msg, n++));
+    RESULT_UNWRAP(void, changes, sexp_nth(msg, n++));
+    RESULT_CALL(void, scenario_tick_read_players(players, tick->players));
+    RESULT_CALL(void, scenario_tick_read_changes(changes, tick->changes));
+
+    if (tick->keyframe)
+        return result_void_ok(0);
+
+    sexp *removals;
+    RESULT_UNWRAP(void, removals, sexp_nth(msg, n));
+    return scenario_tick_read_removals(removals, tick->removals);
+}
+
+struct result_scenario_tick unwrap_scenario_tick_message(const sexp *msg) {
+    return unwrap_scenario_tick_message_in(msg, &g_system_allocator);
+}
+
+struct result_scenario_tick
+unwrap_scenario_tick_message_in(const sexp *msg,
+                                const struct allocator *alloc) {
+    struct scenario_tick tick = {
+        .players = make_vector_in(alloc, sizeof(struct tick_player), 10),
+        .changes = make_vector_in(alloc, sizeof(struct tank_delta), 32),
+        .removals = make_vector_in(alloc, sizeof(struct tank_key), 8),
+    };
+
+    struct result_void r;
+    if (tick.players == NULL || tick.changes == NULL || tick.removals == NULL)
+        r = RESULT_MSG_ERROR(void, "failed to allocate scenario tick");
+    else
+        r = scenario_tick_read(msg, &tick);
+
+    if (r.status == RESULT_ERROR) {
+        free_scenario_tick(tick);
+        return result_scenario_tick_error(r.error);
     }
 
     return result_scenario_tick_ok(tick);
@@ -396,8 +1078,21 @@ struct result_sexp make_join_scenario_message(const char *scenario_name) {
 }
 
 struct result_sexp make_return_to_lobby_message() {
-    return message_make_header(MSG_REQUEST_RETURN_TO_LOBBY);
+    return sexp_list(message_make_header(MSG_REQUEST_RETURN_TO_LOBBY),
+                     sexp_nil());
 }
 struct result_sexp make_list_scenarios_message() {
-    return message_make_header(MSG_REQUEST_LIST_SCENARIOS);
+    return sexp_list(message_make_header(MSG_REQUEST_LIST_SCENARIOS),
+                     sexp_nil());
+}
+
+struct result_sexp make_create_scenario_message(const char *scenario_name) {
+    return sexp_list(message_make_header(MSG_REQUEST_CREATE_SCENARIO),
+                     make_string_sexp(scenario_name),
+                     sexp_nil());
+}
+
+struct result_str unwrap_scenario_name_message(const sexp *msg) {
+    // the name is laid out like a text message's body.
+    return unwrap_text_message(msg);
 }
@@ -1,4 +1,5 @@
 #include "sexp/sexp-base.h"
+#include "sexp/sexp-pool.h"
 #include "sexp/sexp-utils.h"
 #include "error.h"
 
@@ -67,7 +68,7 @@ char *describe_sexp_reader_error(void *self) {
         asprintf(&description, "%s", g_reflected_sexp_reader_error_code[err->code]);
     else {
         size_t arrow_len = err->location - err->input;
-        char arrow_body[arrow_len];
+        char arrow_body[arrow_len + 1];
         memset(arrow_body, '~', arrow_len);
         arrow_body[arrow_len] = 0;
 
@@ -81,25 +82,6 @@ char *describe_sexp_reader_error(void *self) {
     return description;
 }
 
-/** size of a linear S-Expression structure
-
-    If sexp is a `SEXP_CONS`, `SEXP_STRING`, or `SEXP_SYMBOL`, then the length
-    of the sexp passed in are added to the result.
-*/
-size_t sexp_linear_size(enum sexp_type type) {
-    switch (type) {
-    case SEXP_CONS:
-    case SEXP_SYMBOL:
-    case SEXP_STRING:
-    default:
-        return sizeof(struct sexp);
-    case SEXP_INTEGER:
-        return sizeof(struct sexp) + sizeof(s32);
-    case SEXP_TAG:
-        return sizeof(struct sexp);
-    }
-}
-
 ///////////////////////////////// Initializers /////////////////////////////////
 
 struct result_sexp make_string_sexp(const char *str) {
@@ -129,191 +111,473 @@ struct sexp *make_tag(void) {
     return NULL;
 }
 
-void free_sexp(struct sexp *sexp) {
+/** whether `sexp` is a cons of a tree sexp, which owns its car and cdr. */
+bool sexp_is_tree_cons(const struct sexp *sexp) {
+    return sexp != NULL && !sexp->is_linear && sexp->sexp_type == SEXP_CONS;
+}
+
+/** adds a leaf of a tree, or a linear sexp, to `batch`. */
+void free_sexp_leaf(struct sexp_pool_batch *batch, struct sexp *sexp) {
     if (sexp == NULL)
         return;
-    
-    // FIXME what if this is a linear sexp?
-    if (sexp_type(sexp) == SEXP_CONS) {
-        struct cons cons = *(struct cons *)sexp->data;
-
-        free(sexp);
 
-        if (cons.car != sexp)
-            free_sexp(cons.car);
+    if (sexp->is_linear) {
+        // everything inside of the block is owned by the handle.
+        if (sexp->sexp_type != SEXP_LINEAR_ROOT)
+            return;
 
-        if (cons.cdr != sexp)
-            free_sexp(cons.cdr);
-        return;
+        free(((union sexp_data *)sexp->data)->linear_block);
     }
 
-    free(sexp);
-    return;
+    sexp_pool_batch_add(batch, sexp);
 }
 
-/** Helper function to initialize a linear sexp element.
+void free_sexp(struct sexp *sexp) {
+    struct sexp_pool_batch batch = SEXP_POOL_BATCH_INIT;
+
+    // a cons whose car is a cons is rotated, so that its car's cdr becomes
+    // its car, and it becomes its car's cdr.  Once the car isn't a cons, the
+    // cons is freed and the walk goes on to the cdr.  That frees the whole
+    // tree without recursing, however deep or long it is.
+    while (sexp_is_tree_cons(sexp)) {
+        struct cons *cons = (struct cons *)sexp->data;
+
+        if (cons->car == sexp)
+            cons->car = NULL;
+        if (cons->cdr == sexp)
+            cons->cdr = NULL;
+
+        if (sexp_is_tree_cons(cons->car)) {
+            struct sexp *car = cons->car;
+            struct cons *car_cons = (struct cons *)car->data;
+
+            if (car_cons->cdr == car)
+                car_cons->cdr = NULL;
+
+            cons->car = car_cons->cdr;
+            car_cons->cdr = sexp;
+            sexp = car;
+            continue;
+        }
+
+        struct sexp *cdr = cons->cdr;
+        free_sexp_leaf(&batch, cons->car);
+        sexp_pool_batch_add(&batch, sexp);
+        sexp = cdr;
+    }
 
-    Copies data into sexp if it exists.  If more space is needed, it
-    automatically reallocates double the amount required, and updates the
-    pointers.
+    free_sexp_leaf(&batch, sexp);
+    sexp_pool_free_batch(&batch);
+}
 
-    @return pointer to where the next sexp can be initialized.
-*/
-struct result_sexp initialize_linear_sexp(struct sexp **root,
-                                          size_t *capacity,
-                                          struct sexp *dst,
-                                          enum sexp_type type,
-                                          void *data) {
+/******************************* LINEAR LAYOUT ********************************/
 
-    if (root == NULL || *root == NULL || dst == NULL || capacity == NULL) {
-        return RESULT_MSG_ERROR(sexp, "unexpected NULL value");
+struct sexp_linear_block *linear_block(const struct sexp *handle) {
+    return ((union sexp_data *)handle->data)->linear_block;
+}
+
+struct result_sexp make_linear_sexp_block(size_t capacity) {
+    struct sexp *handle = sexp_pool_alloc(sizeof(union sexp_data));
+    if (handle == NULL)
+        return RESULT_MSG_ERROR(sexp, "malloc returned NULL when creating linear handle");
+
+    struct sexp_linear_block *block =
+        malloc(sizeof(struct sexp_linear_block) + capacity);
+    if (block == NULL) {
+        handle->data_length = sizeof(union sexp_data);
+        sexp_pool_free(handle);
+        return RESULT_MSG_ERROR(sexp, "malloc returned NULL when creating linear block");
     }
 
-    // get length of the data that may be copied to dst.
-    size_t data_length = 0;
+    *handle = (struct sexp) {
+        .is_linear = true,
+        .is_root = true,
+        .sexp_type = SEXP_LINEAR_ROOT,
+        .data_length = sizeof(union sexp_data),
+    };
+    ((union sexp_data *)handle->data)->linear_block = block;
+
+    block->handle = handle;
+    block->capacity = capacity;
+    block->length = 0;
+
+    return result_sexp_ok(handle);
+}
+
+struct result_void sexp_linear_reserve(struct sexp *handle, size_t n) {
+    struct sexp_linear_block *block = linear_block(handle);
+    if (block->length + n <= block->capacity)
+        return result_void_ok(0);
+
+    size_t new_capacity = block->capacity * 2;
+    if (new_capacity < block->length + n)
+        new_capacity = block->length + n;
+
+    if (new_capacity > SEXP_MAX_LENGTH)
+        return RESULT_MSG_ERROR(void, "linear sexp length too large");
+
+    block = realloc(block, sizeof(struct sexp_linear_block) + new_capacity);
+    if (block == NULL)
+        return RESULT_MSG_ERROR(void, "realloc returned NULL");
+
+    block->capacity = new_capacity;
+    ((union sexp_data *)handle->data)->linear_block = block;
+    return result_void_ok(0);
+}
 
+struct sexp *sexp_linear_value(const struct sexp *s) {
+    if (s != NULL && s->is_linear && s->sexp_type == SEXP_LINEAR_ROOT)
+        return (struct sexp *)linear_block(s)->data;
+
+    return (struct sexp *)s;
+}
+
+struct sexp *sexp_linear_at(const struct sexp *handle, u32 offset) {
+    return (struct sexp *)(linear_block(handle)->data + offset);
+}
+
+u32 sexp_linear_tell(const struct sexp *handle) {
+    return linear_block(handle)->length;
+}
+
+/** length of the data stored in an atom, before padding is added. */
+size_t atom_data_length(enum sexp_type type, const void *data) {
     switch (type) {
     case SEXP_SYMBOL:
     case SEXP_STRING:
+        return data == NULL ? 1 : strlen(data) + 1;
+    case SEXP_INTEGER:
+        return sizeof(s32);
+    default:
+        return 0;
+    }
+}
+
+/** bytes stored after the header of a linear atom, including padding. */
+size_t linear_atom_data_size(const struct sexp *s) {
+    if (s->is_borrowed)
+        return sizeof(const char *);
+
+    return SEXP_LINEAR_ALIGN(s->data_length);
+}
+
+size_t sexp_linear_atom_size(enum sexp_type type, const void *data) {
+    return sizeof(struct sexp) + SEXP_LINEAR_ALIGN(atom_data_length(type, data));
+}
+
+/** follow the CDRs of a linear list until its terminator is reached. */
+struct sexp *linear_terminator(const struct sexp *list) {
+    while (list->sexp_type == SEXP_CONS)
+        list = (struct sexp *)(list->data + list->data_length);
+
+    return (struct sexp *)list;
+}
+
+size_t sexp_linear_size(const struct sexp *s) {
+    s = sexp_linear_value(s);
+
+    if (s == NULL)
+        return sizeof(struct sexp);
+
+    if (s->is_linear) {
+        switch (s->sexp_type) {
+        case SEXP_CONS:
+            return (u8 *)linear_terminator(s) + sizeof(struct sexp) - (u8 *)s;
+        case SEXP_TAG: {
+            const struct sexp *atom = (struct sexp *)(s->data + s->data_length);
+            return sizeof(struct sexp) + s->data_length + sexp_linear_size(atom);
+        }
+        case SEXP_SYMBOL:
+        case SEXP_STRING:
+        case SEXP_INTEGER:
+            return sizeof(struct sexp) + linear_atom_data_size(s);
+        default:
+            return sizeof(struct sexp);
+        }
+    }
+
+    switch (sexp_type(s)) {
+    case SEXP_CONS: {
+        size_t size = sizeof(struct sexp); // terminator
+        for (const struct sexp *i = s; !sexp_is_nil(i);
+             i = ((union sexp_data *)i->data)->cons.cdr) {
+            size += sizeof(struct sexp)
+                + sexp_linear_size(((union sexp_data *)i->data)->cons.car);
+        }
+        return size;
+    }
+    case SEXP_TAG: {
+        struct cons cons = ((union sexp_data *)s->data)->cons;
+        return sizeof(struct sexp)
+            + sexp_linear_size(cons.car) + sexp_linear_size(cons.cdr);
+    }
+    case SEXP_SYMBOL:
+    case SEXP_STRING:
+    case SEXP_INTEGER:
+        return sexp_linear_atom_size(s->sexp_type, s->data);
+    default:
+        return sizeof(struct sexp);
+    }
+}
+
+/** writes a single sexp header and its data (if it is an atom) to dst. */
+u8 *linear_write_node(u8 *dst, enum sexp_type type, const void *data,
+                             size_t data_length) {
+    struct sexp *node = (struct sexp *)dst;
+    *node = (struct sexp) {
+        .is_linear = true,
+        .is_root = false,
+        .sexp_type = type,
+        .data_length = 0,
+    };
+
+    switch (type) {
+    case SEXP_SYMBOL:
+    case SEXP_STRING: {
+        size_t padded = SEXP_LINEAR_ALIGN(data_length + 1);
         if (data != NULL)
-            data_length = strlen(data);
-        else
-            data_length = 0;
-        break;
+            memcpy(node->data, data, data_length);
+
+        memset(node->data + data_length, 0, padded - data_length);
+        node->data_length = data_length + 1;
+        return node->data + padded;
+    }
     case SEXP_INTEGER:
-        data_length = sizeof(s32);
-        break;
-    case SEXP_CONS:
-    case SEXP_NIL:
-    case SEXP_TAG:
-    case SEXP_LIST_TERMINATOR:
-        data_length = 0;
-        break;
-    case SEXP_LINEAR_ROOT:
-        data_length = sizeof(struct sexp *);
-        break;
+        memcpy(node->data, data, sizeof(s32));
+        node->data_length = sizeof(s32);
+        return node->data + sizeof(s32);
+    default:
+        return node->data;
     }
+}
+
+u8 *sexp_linear_write(u8 *dst, const struct sexp *s) {
+    s = sexp_linear_value(s);
+
+    // linear sexps are already in the correct format.
+    if (s != NULL && s->is_linear) {
+        size_t size = sexp_linear_size(s);
+        memcpy(dst, s, size);
+        ((struct sexp *)dst)->is_root = false;
 
-    if (data_length > SEXP_MAX_LENGTH) {
-        return RESULT_MSG_ERROR(sexp, "sexp length too large");
+        // a CONS in the middle of a list only copies the rest of the list,
+        // so the terminator must be fixed up.
+        if (s->sexp_type == SEXP_CONS) {
+            struct sexp *term = (struct sexp *)(dst + size) - 1;
+            term->data_length = size - sizeof(struct sexp);
+        }
+        return dst + size;
     }
 
-    // length of the root sexp in bytes
-    size_t current_length = (u8 *)dst - (u8 *)*root;
+    switch (sexp_type(s)) {
+    case SEXP_CONS: {
+        u8 *list_start = dst;
+        for (const struct sexp *i = s; !sexp_is_nil(i);
+             i = ((union sexp_data *)i->data)->cons.cdr) {
+            struct sexp *cons = (struct sexp *)dst;
+            u8 *car_start = linear_write_node(dst, SEXP_CONS, NULL, 0);
+
+            dst = sexp_linear_write(car_start,
+                                    ((union sexp_data *)i->data)->cons.car);
+            cons->data_length = dst - car_start;
+        }
 
-    // ensure there is enough space to copy the data.
-    if (current_length + data_length > *capacity) {
-        size_t new_capacity = (current_length + data_length) * 2;
-        sexp *tmp = realloc(*root, new_capacity);
+        struct sexp *term = (struct sexp *)dst;
+        dst = linear_write_node(dst, SEXP_LIST_TERMINATOR, NULL, 0);
+        term->data_length = (u8 *)term - list_start;
+        return dst;
+    }
+    case SEXP_TAG: {
+        struct cons cons = ((union sexp_data *)s->data)->cons;
+        struct sexp *tag = (struct sexp *)dst;
 
-        if (tmp == NULL)
-            return RESULT_MSG_ERROR(sexp, "realloc returned NULL");
+        u8 *tag_start = linear_write_node(dst, SEXP_TAG, NULL, 0);
+        dst = sexp_linear_write(tag_start, cons.car);
+        tag->data_length = dst - tag_start;
 
-        *root = tmp;
-        *capacity = new_capacity;
+        return sexp_linear_write(dst, cons.cdr);
+    }
+    case SEXP_SYMBOL:
+    case SEXP_STRING:
+        return linear_write_node(dst, s->sexp_type, s->data,
+                                 strlen((char *)s->data));
+    case SEXP_INTEGER:
+        return linear_write_node(dst, SEXP_INTEGER, s->data, sizeof(s32));
+    default: {
+        // nil is written as an empty list
+        struct sexp *term = (struct sexp *)dst;
+        dst = linear_write_node(dst, SEXP_LIST_TERMINATOR, NULL, 0);
+        term->data_length = 0;
+        return dst;
+    }
+    }
+}
 
-        // since root is updated, dst is invalid and needs updated.
-        dst = (sexp *)((u8 *)tmp + current_length);
+u8 *sexp_linear_write_atom(u8 *dst, enum sexp_type type, const void *data) {
+    switch (type) {
+    case SEXP_SYMBOL:
+    case SEXP_STRING:
+        return linear_write_node(dst, type, data, atom_data_length(type, data) - 1);
+    case SEXP_INTEGER:
+        return linear_write_node(dst, type, data, sizeof(s32));
+    default:
+        // empty list
+        return linear_write_node(dst, SEXP_LIST_TERMINATOR, NULL, 0);
     }
+}
 
-    // Initialize dst and copy data.
-    *dst = (struct sexp) {
-        .is_root = true,
+struct result_u32 sexp_linear_emit(struct sexp *handle, enum sexp_type type,
+                                   const void *data, size_t data_length) {
+    size_t size = sizeof(struct sexp);
+    if (type == SEXP_SYMBOL || type == SEXP_STRING)
+        size += SEXP_LINEAR_ALIGN(data_length + 1);
+    else if (type == SEXP_INTEGER)
+        size += sizeof(s32);
+
+    RESULT_CALL(u32, sexp_linear_reserve(handle, size));
+
+    struct sexp_linear_block *block = linear_block(handle);
+    u32 offset = block->length;
+
+    linear_write_node(block->data + offset, type, data, data_length);
+    block->length += size;
+
+    return result_u32_ok(offset);
+}
+
+struct result_u32 sexp_linear_emit_borrowed(struct sexp *handle,
+                                            enum sexp_type type,
+                                            const char *str, size_t length) {
+    if (type != SEXP_SYMBOL && type != SEXP_STRING)
+        return RESULT_MSG_ERROR(u32, "cannot borrow a %s",
+                                g_reflected_sexp_type[type]);
+
+    if (length > SEXP_MAX_LENGTH)
+        return RESULT_MSG_ERROR(u32, "borrowed atom is too long");
+
+    size_t size = sizeof(struct sexp) + sizeof(const char *);
+    RESULT_CALL(u32, sexp_linear_reserve(handle, size));
+
+    struct sexp_linear_block *block = linear_block(handle);
+    u32 offset = block->length;
+
+    struct sexp *node = (struct sexp *)(block->data + offset);
+    *node = (struct sexp) {
         .is_linear = true,
+        .is_borrowed = true,
         .sexp_type = type,
-        .data_length = data_length,
+        .data_length = length,
     };
 
-    if (data != NULL) {
-        memcpy(dst->data, data, data_length);
+    // the header is only four bytes, so the pointer may not be aligned.
+    memcpy(node->data, &str, sizeof(const char *));
+    block->length += size;
+
+    return result_u32_ok(offset);
+}
+
+/** walks from a linear list to the root of its block.  Returns the root. */
+struct sexp *linear_find_root(struct sexp *list) {
+    struct sexp *term = linear_terminator(list);
+    struct sexp *start = (struct sexp *)((u8 *)term - term->data_length);
+
+    while (start->is_root == false) {
+        // every list except the root is the CAR of the CONS just before it.
+        struct sexp *parent = start - 1;
+        term = linear_terminator(parent);
+        start = (struct sexp *)((u8 *)term - term->data_length);
     }
 
-    return result_sexp_ok((struct sexp *)(dst->data + data_length));
+    return start;
 }
 
-/** Sets the length of the terminator given a pointer to the parent (sexp with
-    type `SEXP_CONS`) and a pointer to the terminator.
+struct result_sexp sexp_linear_grow_list(struct sexp *list, size_t item_size) {
+    list = sexp_linear_value(list);
 
-    @return length that was written to the terminator, or an error.
-*/
-struct result_s32 set_terminator_size(const struct sexp *cons,
-                                      struct sexp *term) {
-    if (cons == NULL)
-        return RESULT_MSG_ERROR(s32, "List start sexp is NULL");
+    if (list == NULL || list->is_linear == false)
+        return RESULT_MSG_ERROR(sexp, "list is not a linear sexp");
 
-    if (term == NULL)
-        return RESULT_MSG_ERROR(s32, "List terminator sexp is NULL");
+    if (list->sexp_type != SEXP_CONS && list->sexp_type != SEXP_LIST_TERMINATOR)
+        return RESULT_MSG_ERROR(sexp, "list is %s, not a %s",
+                                g_reflected_sexp_type[list->sexp_type],
+                                g_reflected_sexp_type[SEXP_CONS]);
 
-    size_t data_len = ((u8 *)cons - (u8 *)term);
+    size_t n = sizeof(struct sexp) + item_size;
 
-    if (data_len > SEXP_MAX_LENGTH)
-        return RESULT_MSG_ERROR(s32, "List terminator size > 0x7FFFFFF!");
+    struct sexp *root = linear_find_root(list);
+    struct sexp_linear_block *block =
+        (struct sexp_linear_block *)((u8 *)root - offsetof(struct sexp_linear_block, data));
+    struct sexp *handle = block->handle;
 
-    term->data_length = data_len;
-    return result_s32_ok(data_len);
+    u32 insert_at = (u8 *)linear_terminator(list) - block->data;
+
+    RESULT_CALL(sexp, sexp_linear_reserve(handle, n));
+    block = linear_block(handle);
+
+    // move the terminator (and everything after it) out of the way.
+    u8 *gap = block->data + insert_at;
+    memmove(gap + n, gap, block->length - insert_at);
+    block->length += n;
+
+    struct sexp *term = (struct sexp *)(gap + n);
+    struct sexp *cons = (struct sexp *)gap;
+    *cons = (struct sexp) {
+        .is_linear = true,
+        // the root moves from the terminator if the list was empty.
+        .is_root = term->is_root,
+        .sexp_type = SEXP_CONS,
+        .data_length = item_size,
+    };
+    term->is_root = false;
+
+    // every list containing the new element grows by n bytes.
+    term->data_length += n;
+    struct sexp *start = (struct sexp *)((u8 *)term - term->data_length);
+    while (start->is_root == false) {
+        struct sexp *parent = start - 1;
+        parent->data_length += n;
+
+        term = linear_terminator(parent);
+        term->data_length += n;
+        start = (struct sexp *)((u8 *)term - term->data_length);
+    }
+
+    return result_sexp_ok(cons);
 }
 
 struct result_sexp make_sexp(enum sexp_type type,
                              enum sexp_memory_method method,
                              void *data) {
     struct sexp *root;
+
+    if (method == SEXP_MEMORY_BORROWED)
+        return RESULT_MSG_ERROR(sexp, "borrowed sexps can only be read");
     
     if (method == SEXP_MEMORY_LINEAR) {
-        return RESULT_MSG_ERROR(sexp, "Not Implemented");
-        // TODO finish linnear sexp implementation.
-        
-        // INITIALIZE HANDLE
-        root = malloc(sizeof(struct sexp) + sizeof(struct sexp *));
-
-        if (root == NULL) {
-            return RESULT_MSG_ERROR(sexp, "malloc returned NULL when creating linear root");
-        }
-
-        *root = (struct sexp) {
-            .is_linear = true,
-            .is_root = true,
-            .sexp_type = SEXP_LINEAR_ROOT,
-            .data_length = sizeof(struct sexp *),
-        };
-
-        // first node a linear sexp has the following metadata:
-        //     (ROOT_HANDLE CAPACITY VALUE)
-        size_t capacity =
-            sexp_linear_size(SEXP_CONS)
-            + sexp_linear_size(SEXP_LINEAR_ROOT)
-            + sexp_linear_size(SEXP_INTEGER)
-            + sexp_linear_size(type)
-            + sexp_linear_size(SEXP_LIST_TERMINATOR);
-
-        sexp *value = malloc(capacity);
-        if (value == NULL) {
-            return RESULT_MSG_ERROR(sexp, "malloc returned NULL when creating linear root value");
+        // lists start out empty, elements are added with the push functions.
+        if (type == SEXP_CONS || type == SEXP_NIL)
+            type = SEXP_LIST_TERMINATOR;
+
+        if (type == SEXP_TAG || type == SEXP_LINEAR_ROOT)
+            return RESULT_MSG_ERROR(sexp, "cannot make a linear %s",
+                                    g_reflected_sexp_type[type]);
+
+        size_t data_length = 0;
+        if (type == SEXP_SYMBOL || type == SEXP_STRING)
+            data_length = atom_data_length(type, data) - 1;
+        else if (type == SEXP_INTEGER)
+            data_length = sizeof(s32);
+
+        RESULT_UNWRAP(sexp, root,
+                      make_linear_sexp_block(sexp_linear_atom_size(type, data)));
+
+        struct result_u32 r = sexp_linear_emit(root, type, data, data_length);
+        if (r.status == RESULT_ERROR) {
+            free_sexp(root);
+            return result_sexp_error(r.error);
         }
 
-        // INITIALIZE ROOT SEXP
-        sexp *next = value;
-
-        struct result_sexp r;
-        r = initialize_linear_sexp(&value, &capacity, next, SEXP_CONS,  NULL);
-        if (r.status == RESULT_OK) next = r.ok; else return r;
-
-        r = initialize_linear_sexp(&value, &capacity, next, SEXP_LINEAR_ROOT,  &root);
-        if (r.status == RESULT_OK) next = r.ok; else return r;
-        
-        r = initialize_linear_sexp(&value, &capacity, next, SEXP_INTEGER,  NULL);
-        if (r.status == RESULT_OK) next = r.ok; else return r;
-
-        r = initialize_linear_sexp(&value, &capacity, next, type,  data);
-        if (r.status == RESULT_OK) next = r.ok; else return r;
-        
-        r = initialize_linear_sexp(&value, &capacity, next, SEXP_LIST_TERMINATOR,  NULL);
-        if (r.status == RESULT_OK) next = r.ok; else return r;
-
-        *(struct sexp **)root->data = value;
-
-        // sexp *capacity_field = sexp_nth(value, 1);
-        // sexp_set_integer(capacity_field, capacity);
-        
+        sexp_linear_value(root)->is_root = true;
         return result_sexp_ok(root);
     } else {
         /////////////////////////// CREATE TREE SEXP ///////////////////////////
@@ -330,12 +594,13 @@ struct result_sexp make_sexp(enum sexp_type type,
             data_len = sizeof(union sexp_data);
         }
 
-        root = malloc(sizeof(struct sexp) + data_len);
+        root = sexp_pool_alloc(data_len);
         if (root == NULL)
             return RESULT_MSG_ERROR(sexp, "malloc returned NULL");
 
         root->is_root = false;
         root->is_linear = false;
+        root->is_borrowed = false;
         root->data_length = data_len;
         root->sexp_type = type;
 
@@ -345,7 +610,11 @@ struct result_sexp make_sexp(enum sexp_type type,
         // by setting the first byte to zero as well.
         memset(root->data, 0, data_len);
         
-        if (data != NULL)
+        // integers are passed in as a pointer to an s32, which is smaller than
+        // the union.
+        if (data != NULL && type == SEXP_INTEGER)
+            memcpy(root->data, data, sizeof(s32));
+        else if (data != NULL)
             memcpy(root->data, data, data_len);
 
         return result_sexp_ok(root);
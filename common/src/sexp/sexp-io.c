@@ -5,70 +5,90 @@
 #include "vector.h"
 
 #include <ctype.h>
+#include <errno.h>
 #include <string.h>
 #include <stdlib.h>
 
 
 /*************************** SEXP READER FUNCITONS ****************************/
-/** reads an attom from the string and returns a pointer to the sexp. */
-struct result_sexp
-sexp_read_atom(const char **caller_cursor,
-               enum sexp_memory_method method) {
+/** An atom as it appears in the string being read.  `str` points into the
+    string, and is not null terminated. */
+struct sexp_atom {
+    enum sexp_type type;
+    const char *str;
+    size_t length;
+    s32 integer;
+
+    // unescaped symbols are converted to upper-case when they are stored.
+    bool is_escaped;
+};
+
+/** finds the extents of the next atom in the string, and moves the cursor past
+    it.  The string ends at `end`, which netstrings can't run past. */
+struct result_void
+sexp_scan_atom(const char **caller_cursor, const char *end,
+               struct sexp_atom *atom) {
     const char* cursor = *caller_cursor;
     while (isspace(*cursor) && *cursor != '\0') cursor++;
 
     if (memchr("\0])", *cursor, 3) != 0)
         // TODO get the right error here
-        return reader_err(0, *caller_cursor, cursor);
+        return result_void_error(sexp_reader_error(0, *caller_cursor, cursor));
 
     // test for netstring
     const char* digit_end = cursor;
-    u32 atom_number_value = strtoul((char*)cursor, (char**)&digit_end, 10);
+    errno = 0;
+    unsigned long atom_number_value =
+        strtoul((char*)cursor, (char**)&digit_end, 10);
+    bool number_overflowed = errno == ERANGE;
 
     enum sexp_reader_error_code error_code;
 
     char* delims;
     u32 num_delims;
 
-    enum sexp_type atom_type;
-    union {
-        const char *str;
-        s32 integer;
-    } atom_data;
-    size_t atom_length;
-
     bool should_skip_terminator = false;
-    bool symbol_is_escaped = false;
     bool is_netstring = false;
+    atom->is_escaped = false;
     
-    // Determine atom type and extract data.    
-    if (digit_end != cursor && *digit_end == ':') {
+    // Determine atom type and extract data.  A netstring's length is only
+    // digits, like `sexp_stream_scan()` expects, so +9:A is a symbol.
+    if (isdigit(*cursor) && *digit_end == ':') {
         // NETSTRING
-        atom_type = SEXP_SYMBOL;
-        atom_data.str = digit_end+1;
-        atom_length = atom_number_value;
+        if (number_overflowed ||
+            atom_number_value > SEXP_NETSTRING_MAX_LENGTH ||
+            atom_number_value > (size_t)(end - digit_end - 1))
+            return result_void_error(
+                sexp_reader_error(SEXP_RESULT_BAD_NETSTRING_LENGTH,
+                                  *caller_cursor, digit_end));
+
+        atom->type = SEXP_SYMBOL;
+        atom->str = digit_end+1;
+        atom->length = atom_number_value;
         is_netstring = true;
-        symbol_is_escaped = true;
+        atom->is_escaped = true;
         
         cursor = digit_end + atom_number_value + 1;
         
     }  else if (digit_end != cursor && (isspace(*digit_end) || *digit_end == ')')) {
         // NUMBER
-        atom_type = SEXP_INTEGER;
-        atom_data.integer = atom_number_value;
-        atom_length = sizeof(s32);
+        atom->type = SEXP_INTEGER;
+        atom->integer = atom_number_value;
+        atom->length = sizeof(s32);
         
         cursor = digit_end;
 
     } else if (digit_end != cursor && *digit_end != ':') {
         // ERROR CASE
-        return reader_err(SEXP_RESULT_NETSTRING_MISSING_COLON, *caller_cursor, digit_end);
+        return result_void_error(
+            sexp_reader_error(SEXP_RESULT_NETSTRING_MISSING_COLON,
+                              *caller_cursor, digit_end));
         
     } else if (*digit_end == '|') {
         // ESCAPED SYMBOL
-        atom_type = SEXP_SYMBOL;
-        atom_data.str = digit_end+1;
-        atom_length = 0; // filled in next subsequent block
+        atom->type = SEXP_SYMBOL;
+        atom->str = digit_end+1;
+        atom->length = 0; // filled in next subsequent block
         
         delims = "|";
         num_delims = 1;
@@ -76,13 +96,13 @@ sexp_read_atom(const char **caller_cursor,
         error_code = SEXP_RESULT_SYMBOL_ESCAPE_NOT_CLOSED;
         cursor = digit_end+1;
         should_skip_terminator = true;
-        symbol_is_escaped = true;
+        atom->is_escaped = true;
         
     } else if (*digit_end == '"') {
         // STRING
-        atom_type = SEXP_STRING;
-        atom_data.str = digit_end+1;
-        atom_length = 0; // filled in next subsequent block
+        atom->type = SEXP_STRING;
+        atom->str = digit_end+1;
+        atom->length = 0; // filled in next subsequent block
 
         delims = "\"";
         num_delims = 1;
@@ -93,24 +113,25 @@ sexp_read_atom(const char **caller_cursor,
         
     } else {
         // SYMBOL
-        atom_type = SEXP_SYMBOL;
-        atom_data.str = digit_end;
-        atom_length = 0; // filled in next subsequent block
+        atom->type = SEXP_SYMBOL;
+        atom->str = cursor;
+        atom->length = 0; // filled in next subsequent block
         
         delims = "\0 ()[]\"";
         num_delims = 7;
     }
 
     // Get lengths for stringy sexp types.
-    if ((atom_type == SEXP_SYMBOL || atom_type == SEXP_STRING) &&
+    if ((atom->type == SEXP_SYMBOL || atom->type == SEXP_STRING) &&
         is_netstring == false) {
-        for (atom_length = 0;
+        for (atom->length = 0;
              memchr(delims, *cursor, num_delims) == NULL && *cursor != '\0';
-             cursor++, atom_length++);
+             cursor++, atom->length++);
 
         // the string ended without finding a terminating delimeter.
         if (memchr(delims, *cursor, num_delims) == NULL) {
-            return reader_err(error_code, *caller_cursor, cursor);
+            return result_void_error(
+                sexp_reader_error(error_code, *caller_cursor, cursor));
         }
 
         // skip past the terminator, unless this is a regular symbol.
@@ -119,36 +140,46 @@ sexp_read_atom(const char **caller_cursor,
         }
     }
 
-    char null_terminated_str[atom_length + 1];
-    if (atom_type == SEXP_SYMBOL || atom_type == SEXP_STRING) {
-        // BUG: This currently doesn't work for netstrings that have null
-        // characters embedded in them!
+    *caller_cursor = cursor;
+    return result_void_ok(0);
+}
 
-        // copy atom data into temporary buffer (so that it is null terminated.)
-        memcpy(null_terminated_str, atom_data.str, atom_length);
-        null_terminated_str[atom_length] = '\0';
-    }
+/** reads an attom from the string and returns a pointer to the sexp. */
+struct result_sexp
+sexp_read_atom(const char **caller_cursor, const char *end,
+               enum sexp_memory_method method) {
+    struct sexp_atom atom;
+    struct result_void r = sexp_scan_atom(caller_cursor, end, &atom);
+    if (r.status == RESULT_ERROR)
+        return result_sexp_error(r.error);
+
+    if (atom.type == SEXP_INTEGER)
+        return make_sexp(atom.type, method, &atom.integer);
+
+    // BUG: tree atoms are null terminated, so netstrings that have null
+    // characters embedded in them are truncated.  The linear layouts don't
+    // have this problem.
+
+    // copy atom data into temporary buffer (so that it is null terminated.)
+    char null_terminated_str[atom.length + 1];
+    memcpy(null_terminated_str, atom.str, atom.length);
+    null_terminated_str[atom.length] = '\0';
 
     // make non-escaped symbols upper-case
-    if (atom_type == SEXP_SYMBOL && symbol_is_escaped == false) {
+    if (atom.type == SEXP_SYMBOL && atom.is_escaped == false) {
         for (char *c = null_terminated_str;
-             c < null_terminated_str + atom_length;
+             c < null_terminated_str + atom.length;
              c++) {
             *c = toupper(*c);
         }
     }
 
-    *caller_cursor = cursor;
-
-    if (atom_type == SEXP_INTEGER)
-        return make_sexp(atom_type, method, &atom_data.integer);
-    else
-        return make_sexp(atom_type, method, null_terminated_str);
+    return make_sexp(atom.type, method, null_terminated_str);
 }
 
 /** Reads a tag from the string and returns a pointer to that sexp.*/
 struct result_sexp
-sexp_read_tagged_atom(const char **caller_cursor,
+sexp_read_tagged_atom(const char **caller_cursor, const char *end,
                       enum sexp_memory_method method) {
     const char* cursor = *caller_cursor;
 
@@ -164,7 +195,7 @@ sexp_read_tagged_atom(const char **caller_cursor,
     // ([ 3:foo ]3:bar)  ->  ([ 3:foo ]3:bar)
     // ~~⬆~~~~~~~~~~~~~  ->  ~~~~~~~~⬆~~~~~~~
     struct result_sexp tag_type;
-    tag_type = sexp_read_atom(&cursor, method);
+    tag_type = sexp_read_atom(&cursor, end, method);
     if (tag_type.status == RESULT_ERROR) {
         free_error(tag_type.error);
         return reader_err(SEXP_RESULT_TAG_MISSING_TAG, *caller_cursor, cursor);
@@ -198,7 +229,7 @@ sexp_read_tagged_atom(const char **caller_cursor,
     // ([ 3:foo ]3:bar)  ->  ([ 3:foo ]3:bar)
     // ~~~~~~~~~~⬆~~~~~  ->  ~~~~~~~~~~~~~~~⬆
     struct result_sexp tag_value;
-    tag_value = sexp_read_atom(&cursor, method);
+    tag_value = sexp_read_atom(&cursor, end, method);
     if (tag_value.status == RESULT_ERROR) {
         free_error(tag_value.error);
         return reader_err(SEXP_RESULT_TAG_MISSING_SYMBOL, *caller_cursor, cursor);
@@ -216,19 +247,18 @@ sexp_read_tagged_atom(const char **caller_cursor,
 }
 
 struct result_sexp
-sexp_reader(const char **sexp_str,
+sexp_reader(const char **sexp_str, const char *end,
             enum sexp_memory_method method);
 
 // list points to the first item in the list
 struct result_sexp
-sexp_read_list(const char **caller_cursor,
+sexp_read_list(const char **caller_cursor, const char *end,
                enum sexp_memory_method method) {
     const char* cursor = *caller_cursor;
 
-    struct result_sexp list = sexp_nil();
-    struct result_sexp end = list;
+    struct sexp_list_builder builder;
+    RESULT_CALL(sexp, sexp_builder_init(&builder, SEXP_MEMORY_TREE));
 
-    bool first_element = true;
     while (true) {
         // skip leading whitespace
         while (isspace(*cursor) && *cursor != '\0') cursor++; 
@@ -237,25 +267,23 @@ sexp_read_list(const char **caller_cursor,
         if (*cursor == ')') {
             cursor++;
             *caller_cursor = cursor;
-            return list;
+            return result_sexp_ok(sexp_builder_finish(&builder));
         }
 
-        if (*cursor == '\0')
+        if (*cursor == '\0') {
+            free_sexp(sexp_builder_finish(&builder));
             return reader_err(SEXP_RESULT_LIST_NOT_CLOSED, *caller_cursor, cursor);
+        }
 
-        end = sexp_rpush(end, sexp_reader(&cursor, method));
+        struct result_sexp tail =
+            sexp_builder_push(&builder, sexp_reader(&cursor, end, method));
 
-        // list is initialized to nil, the first element will return a new list.
-        if (first_element == true) {
-            list = end;
-            first_element = false;
+        // the list isn't returned to the caller, so it must be freed here.
+        if (tail.status == RESULT_ERROR) {
+            free_sexp(sexp_builder_finish(&builder));
+            return tail;
         }
-
-        if (end.status == RESULT_ERROR)
-            break;
     }
-
-    return list;
 }
 
 /** Reads the next token in an S-Expression.
@@ -270,7 +298,7 @@ sexp_read_list(const char **caller_cursor,
     `sexp_read_tagged_atom()`, or `sexp_read_atom()`.
 */
 struct result_sexp
-sexp_reader(const char **caller_cursor,
+sexp_reader(const char **caller_cursor, const char *end,
             enum sexp_memory_method method) {
     const char* cursor = *caller_cursor;
     while (isspace(*cursor) && *cursor != '\0') cursor++;
@@ -304,13 +332,13 @@ sexp_reader(const char **caller_cursor,
 
     switch (token_type) {
     case LIST_OR_CONS:
-        r = sexp_read_list(&cursor, method);
+        r = sexp_read_list(&cursor, end, method);
         break;
     case TAGGED_ATOM:
-        r = sexp_read_tagged_atom(&cursor, method);
+        r = sexp_read_tagged_atom(&cursor, end, method);
         break;
     case ATOM:
-        r = sexp_read_atom(&cursor, method);
+        r = sexp_read_atom(&cursor, end, method);
         break;
     }
 
@@ -321,28 +349,359 @@ sexp_reader(const char **caller_cursor,
     return r;
 }
 
+struct result_void
+sexp_read_linear(const char **caller_cursor, const char *end,
+                 struct sexp *root);
+
+/** reads an atom onto the end of the linear sexp `root`. */
+struct result_void
+sexp_read_linear_atom(const char **caller_cursor, const char *end,
+                      struct sexp *root) {
+    struct sexp_atom atom;
+    RESULT_CALL(void, sexp_scan_atom(caller_cursor, end, &atom));
+
+    if (atom.type == SEXP_INTEGER) {
+        RESULT_CALL(void, sexp_linear_emit(root, SEXP_INTEGER,
+                                           &atom.integer, sizeof(s32)));
+        return result_void_ok(0);
+    }
+
+    // a borrowed atom is only copied if it needs to be converted to
+    // upper-case, since the string being read can't be modified.
+    bool needs_upcase = false;
+    if (atom.type == SEXP_SYMBOL && atom.is_escaped == false) {
+        for (const char *c = atom.str; c < atom.str + atom.length; c++) {
+            if (islower(*c)) {
+                needs_upcase = true;
+                break;
+            }
+        }
+    }
+
+    if (root->is_borrowed && needs_upcase == false) {
+        RESULT_CALL(void, sexp_linear_emit_borrowed(root, atom.type,
+                                                    atom.str, atom.length));
+        return result_void_ok(0);
+    }
+
+    u32 offset;
+    RESULT_UNWRAP(void, offset,
+                  sexp_linear_emit(root, atom.type, atom.str, atom.length));
+
+    // make non-escaped symbols upper-case.  They are already in the block, so
+    // there is no need for a temporary buffer.
+    if (needs_upcase) {
+        u8 *str = sexp_linear_at(root, offset)->data;
+        for (u8 *c = str; c < str + atom.length; c++) {
+            *c = toupper(*c);
+        }
+    }
+
+    return result_void_ok(0);
+}
+
+/** reads a tag onto the end of the linear sexp `root`. */
+struct result_void
+sexp_read_linear_tag(const char **caller_cursor, const char *end,
+                     struct sexp *root) {
+    const char* cursor = *caller_cursor;
+
+    u32 tag;
+    RESULT_UNWRAP(void, tag, sexp_linear_emit(root, SEXP_TAG, NULL, 0));
+
+    struct result_void r = sexp_read_linear_atom(&cursor, end, root);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        return result_void_error(
+            sexp_reader_error(SEXP_RESULT_TAG_MISSING_TAG, *caller_cursor, cursor));
+    }
+
+    // the CDR (atom) of the tag is right after the CAR (tag).
+    sexp_linear_at(root, tag)->data_length =
+        sexp_linear_tell(root) - tag - sizeof(struct sexp);
+
+    while(isspace(*cursor)) cursor++;
+
+    // make sure the tag is closed.  Error if not.
+    if (*cursor != ']')
+        return result_void_error(
+            sexp_reader_error(SEXP_RESULT_TAG_NOT_CLOSED, *caller_cursor, cursor));
+    cursor++;
+
+    r = sexp_read_linear_atom(&cursor, end, root);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        return result_void_error(
+            sexp_reader_error(SEXP_RESULT_TAG_MISSING_SYMBOL, *caller_cursor, cursor));
+    }
+
+    *caller_cursor = cursor;
+    return result_void_ok(0);
+}
+
+/** reads a list onto the end of the linear sexp `root`.  The cursor should be
+    just past the opening paren. */
+struct result_void
+sexp_read_linear_list(const char **caller_cursor, const char *end,
+                      struct sexp *root) {
+    const char* cursor = *caller_cursor;
+    u32 list_start = sexp_linear_tell(root);
+
+    while (true) {
+        // skip leading whitespace
+        while (isspace(*cursor) && *cursor != '\0') cursor++; 
+
+        if (*cursor == ')') {
+            u32 term;
+            RESULT_UNWRAP(void, term,
+                          sexp_linear_emit(root, SEXP_LIST_TERMINATOR, NULL, 0));
+            sexp_linear_at(root, term)->data_length = term - list_start;
+
+            *caller_cursor = cursor + 1;
+            return result_void_ok(0);
+        }
+
+        if (*cursor == '\0')
+            return result_void_error(
+                sexp_reader_error(SEXP_RESULT_LIST_NOT_CLOSED, *caller_cursor, cursor));
+
+        // every element is the CAR of a CONS.  The size of the CAR is only
+        // known after it has been read.
+        u32 cons;
+        RESULT_UNWRAP(void, cons, sexp_linear_emit(root, SEXP_CONS, NULL, 0));
+        RESULT_CALL(void, sexp_read_linear(&cursor, end, root));
+
+        sexp_linear_at(root, cons)->data_length =
+            sexp_linear_tell(root) - cons - sizeof(struct sexp);
+    }
+}
+
+/** Reads the next token in an S-Expression onto the end of the linear sexp
+    `root`.  This is the linear equivalent of `sexp_reader()`. */
+struct result_void
+sexp_read_linear(const char **caller_cursor, const char *end,
+                 struct sexp *root) {
+    const char* cursor = *caller_cursor;
+    while (isspace(*cursor) && *cursor != '\0') cursor++;
+
+    struct result_void r;
+    switch (*cursor) {
+    case '(':
+        cursor++;
+        r = sexp_read_linear_list(&cursor, end, root);
+        break;
+    case '[':
+        cursor++;
+        r = sexp_read_linear_tag(&cursor, end, root);
+        break;
+    case ']':
+        return result_void_error(
+            sexp_reader_error(SEXP_RESULT_INVALID_CHARACTER, *caller_cursor, cursor));
+    default:
+        r = sexp_read_linear_atom(&cursor, end, root);
+    }
+
+    if (r.status == RESULT_ERROR)
+        return r;
+
+    *caller_cursor = cursor;
+    return r;
+}
+
 struct result_sexp
 sexp_read(const char *sexp_str, enum sexp_memory_method method) {
+    return sexp_read_n(sexp_str, strlen(sexp_str), method);
+}
+
+struct result_sexp
+sexp_read_n(const char *sexp_str, size_t length,
+            enum sexp_memory_method method) {
     const char *cursor = sexp_str;
+    const char *end = sexp_str + length;
     struct result_sexp r;
     
     while (isspace(*sexp_str) && *sexp_str != '\0') sexp_str++;
     if (*cursor == ')')
         return reader_err(SEXP_RESULT_INVALID_CHARACTER, sexp_str, cursor);
 
-    r = sexp_reader(&cursor, method);
+    if (method == SEXP_MEMORY_LINEAR || method == SEXP_MEMORY_BORROWED) {
+        // a guess at the size of the block.  Small atoms take up more space in
+        // memory than they do as text (eg "1 " is 12 bytes), so this should
+        // almost always be large enough to avoid a realloc.
+        sexp *root;
+        RESULT_UNWRAP(sexp, root,
+                      make_linear_sexp_block(length * 6
+                                             + sizeof(struct sexp)));
+        root->is_borrowed = method == SEXP_MEMORY_BORROWED;
+
+        struct result_void lr = sexp_read_linear(&cursor, end, root);
+        if (lr.status == RESULT_ERROR) {
+            free_sexp(root);
+            return result_sexp_error(lr.error);
+        }
+
+        sexp_linear_value(root)->is_root = true;
+        r = result_sexp_ok(root);
+    } else {
+        r = sexp_reader(&cursor, end, method);
+    }
 
     if (r.status == RESULT_ERROR)
         return r;
     
     // fail if their is trailing garbage.
-    while (isspace(*cursor) && *cursor != '\0') cursor++;
-    if (*cursor != '\0')
+    while (cursor < end && isspace(*cursor)) cursor++;
+    if (cursor != end) {
+        free_sexp(r.ok);
         return reader_err(SEXP_RESULT_TRAILING_GARBAGE, sexp_str, cursor);
+    }
 
     return r;
 }
 
+/************************** SEXP STREAM FUNCTIONS *****************************/
+void sexp_stream_init(struct sexp_stream *stream) {
+    stream->state = SEXP_STREAM_BETWEEN;
+    stream->depth = 0;
+    stream->netstring_length = 0;
+    stream->in_tag = false;
+}
+
+/** called when an atom ends.  Returns true if it was a top-level sexp. */
+bool sexp_stream_end_atom(struct sexp_stream *stream) {
+    stream->state = SEXP_STREAM_BETWEEN;
+    return stream->depth == 0 && stream->in_tag == false;
+}
+
+size_t sexp_stream_scan(struct sexp_stream *stream, const char *data,
+                        size_t length, bool *complete) {
+    *complete = false;
+
+    size_t i = 0;
+    while (i < length && *complete == false) {
+        unsigned char c = data[i];
+
+        switch (stream->state) {
+        case SEXP_STREAM_NETSTRING: {
+            // skip the rest of the netstring's data at once.
+            size_t n = length - i;
+            if (n > stream->netstring_length)
+                n = stream->netstring_length;
+
+            i += n;
+            stream->netstring_length -= n;
+            if (stream->netstring_length == 0)
+                *complete = sexp_stream_end_atom(stream);
+            continue;
+        }
+        case SEXP_STREAM_STRING:
+        case SEXP_STREAM_ESCAPED: {
+            char terminator = stream->state == SEXP_STREAM_STRING ? '"' : '|';
+            const char *end = memchr(data + i, terminator, length - i);
+            if (end == NULL) {
+                i = length;
+                continue;
+            }
+
+            i = end - data + 1;
+            *complete = sexp_stream_end_atom(stream);
+            continue;
+        }
+        case SEXP_STREAM_DIGITS:
+            if (isdigit(c)) {
+                // a length over the limit sticks just past it, so it can't
+                // overflow.
+                u64 netstring_length = (u64)stream->netstring_length * 10
+                    + (c - '0');
+                stream->netstring_length =
+                    netstring_length > SEXP_NETSTRING_MAX_LENGTH
+                    ? SEXP_NETSTRING_MAX_LENGTH + 1
+                    : netstring_length;
+                i++;
+                continue;
+            }
+
+            if (c == ':') {
+                i++;
+                if (stream->netstring_length > SEXP_NETSTRING_MAX_LENGTH) {
+                    stream->state = SEXP_STREAM_TOO_LONG;
+                    *complete = true;
+                    continue;
+                }
+
+                stream->state = SEXP_STREAM_NETSTRING;
+                if (stream->netstring_length == 0)
+                    *complete = sexp_stream_end_atom(stream);
+                continue;
+            }
+
+            // a number ends like a symbol does.
+            stream->state = SEXP_STREAM_SYMBOL;
+            continue;
+        case SEXP_STREAM_SYMBOL:
+            if (memchr(" ()[]\"", c, 6) == NULL && !isspace(c)) {
+                i++;
+                continue;
+            }
+
+            // the delimiter is scanned again as part of whatever follows.
+            if (sexp_stream_end_atom(stream)) {
+                *complete = true;
+                continue;
+            }
+            break;
+        case SEXP_STREAM_TOO_LONG:
+            *complete = true;
+            continue;
+        case SEXP_STREAM_BETWEEN:
+            break;
+        }
+
+        // SEXP_STREAM_BETWEEN
+        i++;
+        switch (c) {
+        case '(':
+            stream->depth++;
+            break;
+        case ')':
+            // an unmatched paren is returned so that the reader reports it.
+            if (stream->depth <= 1) {
+                stream->depth = 0;
+                *complete = true;
+            } else {
+                stream->depth--;
+            }
+            break;
+        case '[':
+            stream->in_tag = true;
+            break;
+        case ']':
+            stream->in_tag = false;
+            break;
+        case '"':
+            stream->state = SEXP_STREAM_STRING;
+            break;
+        case '|':
+            stream->state = SEXP_STREAM_ESCAPED;
+            break;
+        default:
+            if (isspace(c)) {
+                break;
+            } else if (isdigit(c)) {
+                stream->state = SEXP_STREAM_DIGITS;
+                stream->netstring_length = c - '0';
+            } else {
+                stream->state = SEXP_STREAM_SYMBOL;
+            }
+        }
+    }
+
+    if (*complete && stream->state != SEXP_STREAM_TOO_LONG)
+        sexp_stream_init(stream);
+
+    return i;
+}
+
 /************************** SEXP SERIALIZE FUNCTIONS **************************/
 
 struct result_s32 sexp_serialize_list(const sexp *, vector *);
@@ -350,6 +709,9 @@ struct result_s32 sexp_serialize_symbol(const sexp *, vector *);
 struct result_s32 sexp_serialize_integer(const sexp *, vector *);
 struct result_s32 sexp_serialize_tag(const sexp *, vector *);
 struct result_s32 sexp_serialize_string(const sexp *, vector *);
+struct result_s32 sexp_serialize_symbol_view(struct sexp_view, vector *);
+struct result_s32 sexp_serialize_string_view(struct sexp_view, vector *);
+struct result_s32 sexp_serialize_integer_value(s32, vector *);
 
 /** takes a sexp and dynamic buffer. */
 struct result_s32
@@ -357,6 +719,8 @@ sexp_serialize_any(const sexp *s, vector *buffer) {
     if (buffer == NULL)
         return RESULT_MSG_ERROR(s32, "unexpected NULL buffer");
 
+    s = sexp_linear_value(s);
+
     struct result_s32 r;
     switch (sexp_type(s)) {
     case SEXP_NIL:
@@ -393,13 +757,22 @@ sexp_serialize_symbol(const sexp *sexp, vector *buffer) {
                                 g_reflected_sexp_type[sexp_type(sexp)]);
                                
 
+    struct sexp_view symbol;
+    RESULT_UNWRAP(s32, symbol, sexp_view_val(sexp));
+
+    return sexp_serialize_symbol_view(symbol, buffer);
+}
+
+struct result_s32
+sexp_serialize_symbol_view(struct sexp_view symbol, vector *buffer) {
     enum {NORMAL, ESCAPED, NETSTRING} representation = NORMAL; 
     
-    for (s32 c = 0; c < sexp->data_length && sexp->data[c] != '\0'; c++) {
-        if (islower(sexp->data[c]) && representation == NORMAL)
+    for (u32 c = 0; c < symbol.length; c++) {
+        if (islower(symbol.str[c]) && representation == NORMAL)
             representation = ESCAPED;
 
-        if (sexp->data[c] == '|') {
+        // null characters can only be sent as part of a netstring.
+        if (symbol.str[c] == '|' || symbol.str[c] == '\0') {
             representation = NETSTRING;
             break;
         }
@@ -409,20 +782,15 @@ sexp_serialize_symbol(const sexp *sexp, vector *buffer) {
     if (representation == ESCAPED)
         vec_push(buffer, "|");
 
-    // could use sexp->data-len here, but if the string is improperly formatted,
-    // it could screw up the formatting of the output.
-    s32 symbol_len = strlen((char*)sexp->data);
+    s32 symbol_len = symbol.length;
 
     if (representation == NETSTRING) {
-        // I am using malloc here because I am lazy.
-        char *netstring_header;
-        s32 header_len = asprintf(&netstring_header, "%d:", symbol_len);
-        vec_pushn(buffer, netstring_header, header_len);
-        free(netstring_header);
+        RESULT_CALL(s32, sexp_serialize_integer_value(symbol_len, buffer));
+        vec_push(buffer, ":");
     }
 
     // copy all string data to the buffer.  Return allocation errors.
-    s32 r = vec_pushn(buffer, sexp->data, symbol_len);
+    s32 r = vec_pushn(buffer, symbol.str, symbol_len);
     if (r < 0)
         return RESULT_MSG_ERROR(s32, "vector resize failed");
     
@@ -479,15 +847,22 @@ sexp_serialize_string(const sexp *sexp, vector *buffer) {
         return RESULT_MSG_ERROR(s32, "sexp type is %s, not SEXP_STRING",
                                 g_reflected_sexp_type[sexp_type(sexp)]);
 
+    struct sexp_view str;
+    RESULT_UNWRAP(s32, str, sexp_view_val(sexp));
+
+    return sexp_serialize_string_view(str, buffer);
+}
+
+struct result_s32
+sexp_serialize_string_view(struct sexp_view str, vector *buffer) {
     s32 size_start = vec_len(buffer);
-    s32 len = strlen((char *)sexp->data);
 
     s32 e;
     // BUG characters in the string may need to be escaped
     e = vec_push(buffer, "\"");
     if (e < 0) goto allocation_error;
 
-    e = vec_pushn(buffer, sexp->data, len);
+    e = vec_pushn(buffer, str.str, str.length);
     if (e < 0) goto allocation_error;
 
     e = vec_push(buffer, "\"");
@@ -509,25 +884,18 @@ sexp_serialize_integer(const sexp *sexp, vector *buffer) {
         return RESULT_MSG_ERROR(s32, "sexp type is %s, not SEXP_INTEGER",
                                 g_reflected_sexp_type[sexp_type(sexp)]);
 
-    s32 buffer_space = vec_cap(buffer) - vec_len(buffer);
-    s32 bytes_written = 0;
-
-    do {
-        bytes_written = snprintf((char *)vec_last(buffer) + 1,
-                                 buffer_space,
-                                 "%d", *(u32*)sexp->data);
-
-        if (bytes_written > buffer_space) {
-            s32 r = vec_reserve(buffer, vec_len(buffer) + bytes_written);
-            if (r == -1)
-                return RESULT_MSG_ERROR(s32, "vec reserve failed");
+    return sexp_serialize_integer_value(*(s32 *)sexp->data, buffer);
+}
 
-            continue;
-        }
+struct result_s32
+sexp_serialize_integer_value(s32 integer, vector *buffer) {
+    // "-2147483648", and the null terminator snprintf writes.
+    char *digits = vec_extend_uninit(buffer, 12);
+    if (digits == NULL)
+        return RESULT_MSG_ERROR(s32, "vec reserve failed");
 
-        vec_resize(buffer, vec_len(buffer) + bytes_written);
-        break;
-    } while (true);
+    s32 bytes_written = snprintf(digits, 12, "%d", integer);
+    vec_resize(buffer, vec_len(buffer) - 12 + bytes_written);
 
     return result_s32_ok(bytes_written);
 }
@@ -615,6 +983,370 @@ struct result_str sexp_serialize(const sexp *sexp) {
     return result_str_ok(s);
 }
 
+/**************************** BINARY ENCODING *********************************/
+u32 sexp_binary_put_varint(u8 *dst, u32 value) {
+    u32 n = 0;
+    while (value >= 0x80) {
+        dst[n++] = (value & 0x7f) | 0x80;
+        value >>= 7;
+    }
+    dst[n++] = value;
+    return n;
+}
+
+u32 sexp_binary_get_varint(const u8 *data, size_t length, u32 *value) {
+    u32 v = 0;
+    for (u32 n = 0; n < length && n < SEXP_BINARY_VARINT_MAX; n++) {
+        v |= (u32)(data[n] & 0x7f) << (7 * n);
+        if ((data[n] & 0x80) == 0) {
+            *value = v;
+            return n + 1;
+        }
+    }
+
+    return 0;
+}
+
+/** pushes a binary node header followed by a varint onto `buffer`. */
+struct result_s32
+sexp_binary_push_header(vector *buffer, enum sexp_binary_node node, u32 value) {
+    // written in place, then trimmed to the varint's length.
+    u8 *header = vec_extend_uninit(buffer, 1 + SEXP_BINARY_VARINT_MAX);
+    if (header == NULL)
+        return RESULT_MSG_ERROR(s32, "vector resize failed");
+
+    header[0] = node;
+    u32 length = 1 + sexp_binary_put_varint(header + 1, value);
+    vec_resize(buffer, vec_len(buffer) - (1 + SEXP_BINARY_VARINT_MAX) + length);
+
+    return result_s32_ok(length);
+}
+
+struct result_s32
+sexp_serialize_binary(const struct sexp *s, struct vector *buffer) {
+    if (buffer == NULL)
+        return RESULT_MSG_ERROR(s32, "unexpected NULL buffer");
+
+    s = sexp_linear_value(s);
+    size_t start_length = vec_len(buffer);
+
+    switch (sexp_type(s)) {
+    case SEXP_NIL:
+    case SEXP_CONS: {
+        u8 node = SEXP_BINARY_LIST;
+        vec_push(buffer, &node);
+
+        const sexp *element = s;
+        while (sexp_is_nil(element) == false) {
+            const sexp *item;
+            RESULT_UNWRAP(s32, item, sexp_car(element));
+            RESULT_CALL(s32, sexp_serialize_binary(item, buffer));
+            RESULT_UNWRAP(s32, element, sexp_cdr(element));
+        }
+
+        node = SEXP_BINARY_END;
+        if (vec_push(buffer, &node) < 0)
+            return RESULT_MSG_ERROR(s32, "vector resize failed");
+        break;
+    }
+    case SEXP_SYMBOL:
+    case SEXP_STRING: {
+        struct sexp_view atom;
+        RESULT_UNWRAP(s32, atom, sexp_view_val(s));
+
+        enum sexp_binary_node node = sexp_type(s) == SEXP_SYMBOL
+            ? SEXP_BINARY_SYMBOL
+            : SEXP_BINARY_STRING;
+        RESULT_CALL(s32, sexp_binary_push_header(buffer, node, atom.length));
+
+        if (vec_pushn(buffer, atom.str, atom.length) < 0)
+            return RESULT_MSG_ERROR(s32, "vector resize failed");
+        break;
+    }
+    case SEXP_INTEGER: {
+        s32 integer;
+        RESULT_UNWRAP(s32, integer, sexp_int_val(s));
+
+        // zigzag encoding keeps small negative numbers small.
+        u32 zigzag = ((u32)integer << 1) ^ (u32)(integer >> 31);
+        RESULT_CALL(s32, sexp_binary_push_header(buffer, SEXP_BINARY_INTEGER,
+                                                 zigzag));
+        break;
+    }
+    case SEXP_TAG: {
+        const struct sexp *tag;
+        const struct sexp *atom;
+        RESULT_UNWRAP(s32, tag, sexp_tag_get_tag(s));
+        RESULT_UNWRAP(s32, atom, sexp_tag_get_atom(s));
+
+        u8 node = SEXP_BINARY_TAG;
+        vec_push(buffer, &node);
+        RESULT_CALL(s32, sexp_serialize_binary(tag, buffer));
+        RESULT_CALL(s32, sexp_serialize_binary(atom, buffer));
+        break;
+    }
+    default:
+        return RESULT_MSG_ERROR(s32, "can't serialize a %s",
+                                g_reflected_sexp_type[sexp_type(s)]);
+    }
+
+    return result_s32_ok(vec_len(buffer) - start_length);
+}
+
+/** reads the binary sexp at `*cursor` onto the end of the linear sexp
+    `root`.  It is inside of `depth` lists and tags, counting the list
+    being read. */
+struct result_void
+sexp_read_binary_linear(const u8 **caller_cursor, const u8 *end,
+                        struct sexp *root, u32 depth) {
+    const u8 *cursor = *caller_cursor;
+    if (cursor >= end)
+        return RESULT_MSG_ERROR(void, "binary sexp is truncated");
+
+    enum sexp_binary_node node = *cursor++;
+
+    // each level is a stack frame.
+    if ((node == SEXP_BINARY_LIST || node == SEXP_BINARY_TAG) &&
+        depth >= SEXP_BINARY_MAX_DEPTH)
+        return RESULT_MSG_ERROR(void, "binary sexp is nested too deeply");
+    switch (node) {
+    case SEXP_BINARY_LIST: {
+        u32 list_start = sexp_linear_tell(root);
+        while (true) {
+            if (cursor >= end)
+                return RESULT_MSG_ERROR(void, "binary list is not closed");
+
+            if (*cursor == SEXP_BINARY_END) {
+                cursor++;
+                u32 term;
+                RESULT_UNWRAP(void, term, sexp_linear_emit(
+                                  root, SEXP_LIST_TERMINATOR, NULL, 0));
+                sexp_linear_at(root, term)->data_length = term - list_start;
+                break;
+            }
+
+            u32 cons;
+            RESULT_UNWRAP(void, cons, sexp_linear_emit(root, SEXP_CONS, NULL, 0));
+            RESULT_CALL(void, sexp_read_binary_linear(&cursor, end, root,
+                                                      depth + 1));
+
+            sexp_linear_at(root, cons)->data_length =
+                sexp_linear_tell(root) - cons - sizeof(struct sexp);
+        }
+        break;
+    }
+    case SEXP_BINARY_SYMBOL:
+    case SEXP_BINARY_STRING: {
+        enum sexp_type type = node == SEXP_BINARY_SYMBOL
+            ? SEXP_SYMBOL
+            : SEXP_STRING;
+
+        u32 length;
+        u32 n = sexp_binary_get_varint(cursor, end - cursor, &length);
+        if (n == 0 || length > (size_t)(end - cursor - n) || length >= SEXP_MAX_LENGTH)
+            return RESULT_MSG_ERROR(void, "binary atom is truncated");
+        cursor += n;
+
+        if (root->is_borrowed) {
+            RESULT_CALL(void, sexp_linear_emit_borrowed(
+                            root, type, (const char *)cursor, length));
+        } else {
+            RESULT_CALL(void, sexp_linear_emit(root, type, cursor, length));
+        }
+
+        cursor += length;
+        break;
+    }
+    case SEXP_BINARY_INTEGER: {
+        u32 zigzag;
+        u32 n = sexp_binary_get_varint(cursor, end - cursor, &zigzag);
+        if (n == 0)
+            return RESULT_MSG_ERROR(void, "binary integer is truncated");
+        cursor += n;
+
+        s32 integer = (s32)(zigzag >> 1) ^ -(s32)(zigzag & 1);
+        RESULT_CALL(void, sexp_linear_emit(root, SEXP_INTEGER,
+                                           &integer, sizeof(s32)));
+        break;
+    }
+    case SEXP_BINARY_TAG: {
+        u32 tag;
+        RESULT_UNWRAP(void, tag, sexp_linear_emit(root, SEXP_TAG, NULL, 0));
+        RESULT_CALL(void, sexp_read_binary_linear(&cursor, end, root,
+                                                  depth + 1));
+
+        sexp_linear_at(root, tag)->data_length =
+            sexp_linear_tell(root) - tag - sizeof(struct sexp);
+
+        RESULT_CALL(void, sexp_read_binary_linear(&cursor, end, root,
+                                                  depth + 1));
+        break;
+    }
+    default:
+        return RESULT_MSG_ERROR(void, "invalid binary node 0x%02x", node);
+    }
+
+    *caller_cursor = cursor;
+    return result_void_ok(0);
+}
+
+struct result_sexp
+sexp_read_binary_list(const char *head, const void *data, size_t length,
+                      enum sexp_memory_method method) {
+    if (method == SEXP_MEMORY_TREE)
+        return RESULT_MSG_ERROR(sexp, "binary sexps are only read as linear sexps");
+
+    const u8 *cursor = data;
+    const u8 *end = cursor + length;
+
+    // binary atoms are about as large as their linear counterparts, except for
+    // integers, which can be 6 times larger.
+    sexp *root;
+    RESULT_UNWRAP(sexp, root, make_linear_sexp_block(length * 6 + 64));
+    root->is_borrowed = method == SEXP_MEMORY_BORROWED;
+
+    struct result_void r = result_void_ok(0);
+    u32 list_start = sexp_linear_tell(root);
+
+    if (head != NULL) {
+        u32 cons;
+        RESULT_UNWRAP(sexp, cons, sexp_linear_emit(root, SEXP_CONS, NULL, 0));
+
+        // `head` is usually a string literal, so it can always be borrowed.
+        struct result_u32 e = root->is_borrowed
+            ? sexp_linear_emit_borrowed(root, SEXP_SYMBOL, head, strlen(head))
+            : sexp_linear_emit(root, SEXP_SYMBOL, head, strlen(head));
+        if (e.status == RESULT_ERROR) {
+            r = result_void_error(e.error);
+            goto error;
+        }
+
+        sexp_linear_at(root, cons)->data_length =
+            sexp_linear_tell(root) - cons - sizeof(struct sexp);
+    }
+
+    while (cursor < end) {
+        struct result_u32 e = sexp_linear_emit(root, SEXP_CONS, NULL, 0);
+        if (e.status == RESULT_ERROR) {
+            r = result_void_error(e.error);
+            goto error;
+        }
+
+        r = sexp_read_binary_linear(&cursor, end, root, 1);
+        if (r.status == RESULT_ERROR)
+            goto error;
+
+        sexp_linear_at(root, e.ok)->data_length =
+            sexp_linear_tell(root) - e.ok - sizeof(struct sexp);
+    }
+
+    struct result_u32 term = sexp_linear_emit(root, SEXP_LIST_TERMINATOR, NULL, 0);
+    if (term.status == RESULT_ERROR) {
+        r = result_void_error(term.error);
+        goto error;
+    }
+    sexp_linear_at(root, term.ok)->data_length = term.ok - list_start;
+
+    sexp_linear_value(root)->is_root = true;
+    return result_sexp_ok(root);
+
+ error:
+    free_sexp(root);
+    return result_sexp_error(r.error);
+}
+
+/******************************** SEXP WRITER *********************************/
+void sexp_writer_init(struct sexp_writer *writer, struct vector *buffer,
+                      enum sexp_encoding encoding) {
+    writer->buffer = buffer;
+    writer->encoding = encoding;
+    writer->needs_space = false;
+}
+
+/** separates text elements with a space. */
+struct result_void sexp_writer_separate(struct sexp_writer *writer) {
+    if (writer->encoding == SEXP_ENCODING_TEXT && writer->needs_space) {
+        if (vec_push(writer->buffer, " ") < 0)
+            return RESULT_MSG_ERROR(void, "vector resize failed");
+    }
+
+    writer->needs_space = true;
+    return result_void_ok(0);
+}
+
+struct result_void sexp_write_begin_list(struct sexp_writer *writer) {
+    RESULT_CALL(void, sexp_writer_separate(writer));
+    writer->needs_space = false;
+
+    u8 node = writer->encoding == SEXP_ENCODING_TEXT ? '(' : SEXP_BINARY_LIST;
+    if (vec_push(writer->buffer, &node) < 0)
+        return RESULT_MSG_ERROR(void, "vector resize failed");
+
+    return result_void_ok(0);
+}
+
+struct result_void sexp_write_end_list(struct sexp_writer *writer) {
+    writer->needs_space = true;
+
+    u8 node = writer->encoding == SEXP_ENCODING_TEXT ? ')' : SEXP_BINARY_END;
+    if (vec_push(writer->buffer, &node) < 0)
+        return RESULT_MSG_ERROR(void, "vector resize failed");
+
+    return result_void_ok(0);
+}
+
+struct result_void sexp_write_int(struct sexp_writer *writer, s32 integer) {
+    RESULT_CALL(void, sexp_writer_separate(writer));
+
+    if (writer->encoding == SEXP_ENCODING_TEXT) {
+        RESULT_CALL(void, sexp_serialize_integer_value(integer, writer->buffer));
+    } else {
+        u32 zigzag = ((u32)integer << 1) ^ (u32)(integer >> 31);
+        RESULT_CALL(void, sexp_binary_push_header(writer->buffer,
+                                                  SEXP_BINARY_INTEGER, zigzag));
+    }
+
+    return result_void_ok(0);
+}
+
+/** writes a symbol or string. */
+struct result_void sexp_write_atom(struct sexp_writer *writer,
+                                   enum sexp_type type,
+                                   const char *str, size_t length) {
+    RESULT_CALL(void, sexp_writer_separate(writer));
+
+    struct sexp_view view = { .str = str, .length = length };
+
+    if (writer->encoding == SEXP_ENCODING_TEXT) {
+        if (type == SEXP_SYMBOL) {
+            RESULT_CALL(void, sexp_serialize_symbol_view(view, writer->buffer));
+        } else {
+            RESULT_CALL(void, sexp_serialize_string_view(view, writer->buffer));
+        }
+        return result_void_ok(0);
+    }
+
+    enum sexp_binary_node node = type == SEXP_SYMBOL
+        ? SEXP_BINARY_SYMBOL
+        : SEXP_BINARY_STRING;
+    RESULT_CALL(void, sexp_binary_push_header(writer->buffer, node, length));
+
+    if (vec_pushn(writer->buffer, str, length) < 0)
+        return RESULT_MSG_ERROR(void, "vector resize failed");
+
+    return result_void_ok(0);
+}
+
+struct result_void sexp_write_sym(struct sexp_writer *writer,
+                                  const char *sym, size_t length) {
+    return sexp_write_atom(writer, SEXP_SYMBOL, sym, length);
+}
+
+struct result_void sexp_write_str(struct sexp_writer *writer,
+                                  const char *str, size_t length) {
+    return sexp_write_atom(writer, SEXP_STRING, str, length);
+}
+
 /************************ AUXILLIARY PRINTER FUNCTIONS ************************/
 struct result_s32 sexp_fprint(const struct sexp *s, FILE *file){
     struct result_vec r = sexp_serialize_vec(s);
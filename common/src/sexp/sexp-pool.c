@@ -0,0 +1,184 @@
+#include "sexp/sexp-pool.h"
+#include "sexp/sexp-base.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/** the size of each class's nodes, headers included.  Multiples of 8, so
+    every node in a slab is as aligned as malloc would make it. */
+const size_t g_sexp_pool_class_sizes[SEXP_POOL_CLASSES] = {24, 32, 64};
+
+/** each slab holds this many bytes of nodes. */
+#define SEXP_POOL_SLAB_SIZE (64 * 1024)
+
+/** A block of nodes, all of one size class.  A node on a free list holds the
+    next free node in place of its header. */
+struct sexp_slab {
+    struct sexp_slab *next;
+    _Alignas(16) u8 data[SEXP_POOL_SLAB_SIZE];
+};
+
+/** every slab allocated by any thread, so they stay reachable. */
+_Atomic(struct sexp_slab *) g_sexp_slabs = NULL;
+
+/** the calling thread's free nodes, and how many there are, by class. */
+_Thread_local void *g_sexp_pool_free[SEXP_POOL_CLASSES];
+_Thread_local size_t g_sexp_pool_free_count[SEXP_POOL_CLASSES];
+
+/** A thread keeps at most this many slabs' worth of free nodes of a class.
+    Past that, a slab's worth is moved to the shared pool, for whichever
+    thread next runs out. */
+#define SEXP_POOL_THREAD_SLABS 2
+
+/** A slab's worth of free nodes, chained through the nodes like a free list.
+    The first node also links the chunks in the shared pool together. */
+struct sexp_pool_chunk {
+    void *next_node;
+    struct sexp_pool_chunk *next_chunk;
+};
+
+/** the chunks that threads gave back, by class. */
+struct sexp_pool_chunk *g_sexp_pool_chunks[SEXP_POOL_CLASSES];
+pthread_mutex_t g_sexp_pool_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/** the number of class `c` nodes in a slab. */
+size_t sexp_pool_slab_nodes(int c) {
+    return SEXP_POOL_SLAB_SIZE / g_sexp_pool_class_sizes[c];
+}
+
+/** returns the class of a node with `data_length` bytes of data, or -1 if it's
+    too large for any class. */
+int sexp_pool_class(size_t data_length) {
+    size_t size = sizeof(struct sexp) + data_length;
+
+    for (int c = 0; c < SEXP_POOL_CLASSES; c++) {
+        if (size <= g_sexp_pool_class_sizes[c])
+            return c;
+    }
+
+    return -1;
+}
+
+/** moves a slab's worth of nodes from the front of the thread's class `c`
+    free list to the shared pool, while it holds too many. */
+void sexp_pool_give_back(int c) {
+    size_t count = sexp_pool_slab_nodes(c);
+
+    while (g_sexp_pool_free_count[c] > SEXP_POOL_THREAD_SLABS * count) {
+        struct sexp_pool_chunk *chunk = g_sexp_pool_free[c];
+
+        void **last = (void **)chunk;
+        for (size_t n = 1; n < count; n++)
+            last = *last;
+
+        g_sexp_pool_free[c] = *last;
+        g_sexp_pool_free_count[c] -= count;
+        *last = NULL;
+
+        pthread_mutex_lock(&g_sexp_pool_lock);
+        chunk->next_chunk = g_sexp_pool_chunks[c];
+        g_sexp_pool_chunks[c] = chunk;
+        pthread_mutex_unlock(&g_sexp_pool_lock);
+    }
+}
+
+/** fills the thread's empty class `c` free list, from the shared pool if it
+    has a chunk, or else by carving up a new slab.  Returns -1 if allocation
+    fails. */
+int sexp_pool_refill(int c) {
+    pthread_mutex_lock(&g_sexp_pool_lock);
+    struct sexp_pool_chunk *chunk = g_sexp_pool_chunks[c];
+    if (chunk != NULL)
+        g_sexp_pool_chunks[c] = chunk->next_chunk;
+    pthread_mutex_unlock(&g_sexp_pool_lock);
+
+    if (chunk != NULL) {
+        g_sexp_pool_free[c] = chunk;
+        g_sexp_pool_free_count[c] = sexp_pool_slab_nodes(c);
+        return 0;
+    }
+
+    struct sexp_slab *slab = malloc(sizeof(struct sexp_slab));
+    if (slab == NULL)
+        return -1;
+
+    slab->next = atomic_load_explicit(&g_sexp_slabs, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak_explicit(&g_sexp_slabs, &slab->next,
+                                                  slab, memory_order_release,
+                                                  memory_order_relaxed))
+        ;
+
+    size_t size = g_sexp_pool_class_sizes[c];
+    size_t count = sexp_pool_slab_nodes(c);
+
+    // linked back to front, so nodes are handed out in address order.
+    void *head = NULL;
+    for (size_t n = count; n-- > 0;) {
+        void **node = (void **)&slab->data[n * size];
+        *node = head;
+        head = node;
+    }
+
+    g_sexp_pool_free[c] = head;
+    g_sexp_pool_free_count[c] = count;
+    return 0;
+}
+
+struct sexp *sexp_pool_alloc(size_t data_length) {
+    int c = sexp_pool_class(data_length);
+    if (c < 0)
+        return malloc(sizeof(struct sexp) + data_length);
+
+    if (g_sexp_pool_free[c] == NULL && sexp_pool_refill(c) < 0)
+        return NULL;
+
+    void **node = g_sexp_pool_free[c];
+    g_sexp_pool_free[c] = *node;
+    g_sexp_pool_free_count[c]--;
+    return (struct sexp *)node;
+}
+
+void sexp_pool_free(struct sexp *node) {
+    int c = sexp_pool_class(node->data_length);
+    if (c < 0) {
+        free(node);
+        return;
+    }
+
+    *(void **)node = g_sexp_pool_free[c];
+    g_sexp_pool_free[c] = node;
+    if (++g_sexp_pool_free_count[c] > SEXP_POOL_THREAD_SLABS *
+        sexp_pool_slab_nodes(c))
+        sexp_pool_give_back(c);
+}
+
+void sexp_pool_batch_add(struct sexp_pool_batch *batch, struct sexp *node) {
+    int c = sexp_pool_class(node->data_length);
+    if (c < 0) {
+        free(node);
+        return;
+    }
+
+    *(void **)node = batch->heads[c];
+    batch->heads[c] = node;
+    batch->counts[c]++;
+    if (batch->tails[c] == NULL)
+        batch->tails[c] = node;
+}
+
+void sexp_pool_free_batch(struct sexp_pool_batch *batch) {
+    for (int c = 0; c < SEXP_POOL_CLASSES; c++) {
+        if (batch->heads[c] == NULL)
+            continue;
+
+        // the whole chain goes on the free list at once.
+        *(void **)batch->tails[c] = g_sexp_pool_free[c];
+        g_sexp_pool_free[c] = batch->heads[c];
+        g_sexp_pool_free_count[c] += batch->counts[c];
+        batch->heads[c] = batch->tails[c] = NULL;
+        batch->counts[c] = 0;
+
+        sexp_pool_give_back(c);
+    }
+}
@@ -8,8 +8,10 @@
 #include <stdlib.h>
 #include <stdbool.h>
 
+IMPL_RESULT_TYPE_CUSTOM(struct sexp_view, sexp_view)
+
 enum sexp_memory_method sexp_mem_meth(struct sexp *s) {
-    if (sexp_is_nil(s))
+    if (s == NULL)
         return SEXP_MEMORY_TREE;
 
     return s->is_linear ? SEXP_MEMORY_LINEAR : SEXP_MEMORY_TREE;
@@ -22,28 +24,34 @@ struct result_sexp sexp_list(struct result_sexp first, ...) {
     va_list args;
     va_start(args, first);
 
-    // an error either in first or list initialization will be handled in the
-    // first iteration of the loop.
-    struct result_sexp root = sexp_rsetcar(make_cons_sexp(), first);
-    struct result_sexp current_element = root;
+    // an error in first will be handled by the first push.
+    struct sexp_list_builder builder;
+    struct result_void init = sexp_builder_init(&builder, SEXP_MEMORY_TREE);
+    if (init.status == RESULT_ERROR) {
+        va_end(args);
+        return result_sexp_error(init.error);
+    }
+
+    struct result_sexp current_element = sexp_builder_push(&builder, first);
+    if (current_element.status == RESULT_ERROR)
+        goto error_occured;
 
     struct result_sexp item;
     while (item = va_arg(args, struct result_sexp),
            sexp_is_nil(item.ok) == false) {
 
-        current_element = sexp_rpush(current_element, item);
+        current_element = sexp_builder_push(&builder, item);
         if (current_element.status == RESULT_ERROR) 
             goto error_occured;
     }
 
     va_end(args);
-    return root;
+    return result_sexp_ok(sexp_builder_finish(&builder));
 
  error_occured:
     va_end(args);
 
-    if (root.status == RESULT_OK)
-        free_sexp(root.ok);
+    free_sexp(sexp_builder_finish(&builder));
     return current_element;
 }
 
@@ -113,15 +121,18 @@ struct result_sexp sexp_rsetcdr(struct result_sexp dst, struct result_sexp cdr)
 struct result_sexp sexp_car(const sexp *sexp) {
     if (sexp_is_nil(sexp))
         return sexp_nil();
-    
-    if (sexp->is_linear == true)
-        return RESULT_MSG_ERROR(sexp, "Not Implemented for linear sexp");
+
+    sexp = sexp_linear_value(sexp);
 
     if (sexp->sexp_type != SEXP_CONS)
         return RESULT_MSG_ERROR(sexp, "dst is %s, not a %s",
                                 g_reflected_sexp_type[sexp->sexp_type],
                                 g_reflected_sexp_type[SEXP_CONS]);
 
+    // the CAR of a linear cons is directly after it.
+    if (sexp->is_linear == true)
+        return result_sexp_ok((struct sexp *)sexp->data);
+
     return result_sexp_ok(((union sexp_data *)sexp->data)->cons.car);
 }
 
@@ -136,14 +147,17 @@ struct result_sexp sexp_cdr(const sexp *sexp) {
     if (sexp_is_nil(sexp))
         return sexp_nil();
 
-    if (sexp->is_linear == true)
-        return RESULT_MSG_ERROR(sexp, "Not Implemented for linear sexp");
+    sexp = sexp_linear_value(sexp);
 
     if (sexp->sexp_type != SEXP_CONS)
         return RESULT_MSG_ERROR(sexp, "dst is %s, not a %s",
                                 g_reflected_sexp_type[sexp->sexp_type],
                                 g_reflected_sexp_type[SEXP_CONS]);
 
+    // the CDR of a linear cons is directly after its CAR.
+    if (sexp->is_linear == true)
+        return result_sexp_ok((struct sexp *)(sexp->data + sexp->data_length));
+
     return result_sexp_ok(((union sexp_data *)sexp->data)->cons.cdr);
 }
 
@@ -155,6 +169,7 @@ struct result_sexp sexp_rcdr(struct result_sexp sexp) {
 }
 
 struct result_s32 sexp_int_val(const sexp *s) {
+    s = sexp_linear_value(s);
     if (sexp_is_nil(s) || s->sexp_type != SEXP_INTEGER)
         return RESULT_MSG_ERROR(s32, "dst is %s, not a %s",
                                 g_reflected_sexp_type[s->sexp_type],
@@ -163,33 +178,82 @@ struct result_s32 sexp_int_val(const sexp *s) {
     return result_s32_ok(((const union sexp_data *)(s->data))->integer);
 }
 struct result_str sexp_str_val(const sexp *s) {
+    s = sexp_linear_value(s);
     if (sexp_is_nil(s) || s->sexp_type != SEXP_STRING)
         return RESULT_MSG_ERROR(str, "dst is %s, not a %s",
                                 g_reflected_sexp_type[s->sexp_type],
                                 g_reflected_sexp_type[SEXP_STRING]);
 
+    if (s->is_borrowed)
+        return RESULT_MSG_ERROR(str, "borrowed string is not null terminated");
+
     return result_str_ok((char *)s->data);
 }
 struct result_str sexp_sym_val(const sexp *s) {
+    s = sexp_linear_value(s);
     if (sexp_is_nil(s) || s->sexp_type != SEXP_SYMBOL)
         return RESULT_MSG_ERROR(str, "dst is %s, not a %s",
                                 g_reflected_sexp_type[s->sexp_type],
                                 g_reflected_sexp_type[SEXP_SYMBOL]);
+
+    if (s->is_borrowed)
+        return RESULT_MSG_ERROR(str, "borrowed symbol is not null terminated");
     
     return result_str_ok((char *)s->data);
 }
 
+/** doesn't check the type of `s`, so it can be used by `sexp_is_nil()`. */
+struct sexp_view atom_view(const sexp *s) {
+    struct sexp_view view;
+
+    if (s->is_borrowed) {
+        memcpy(&view.str, s->data, sizeof(const char *));
+        view.length = s->data_length;
+    } else if (s->is_linear) {
+        // linear atoms know their length, so they may contain null characters.
+        view.str = (const char *)s->data;
+        view.length = s->data_length - 1;
+    } else {
+        view.str = (const char *)s->data;
+        view.length = strlen(view.str);
+    }
+
+    return view;
+}
+
+struct result_sexp_view sexp_view_val(const sexp *s) {
+    s = sexp_linear_value(s);
+    if (s == NULL ||
+        (s->sexp_type != SEXP_SYMBOL && s->sexp_type != SEXP_STRING))
+        return RESULT_MSG_ERROR(sexp_view, "dst is %s, not a %s or %s",
+                                g_reflected_sexp_type[sexp_type(s)],
+                                g_reflected_sexp_type[SEXP_SYMBOL],
+                                g_reflected_sexp_type[SEXP_STRING]);
+
+    return result_sexp_view_ok(atom_view(s));
+}
+
 bool sexp_is_nil(const sexp *s) {
-    // NULL pointer is considered NIL, as well as a NIL sexp_type.
-    if (s == NULL || s->sexp_type == SEXP_NIL)
+    s = sexp_linear_value(s);
+
+    // NULL pointer is considered NIL, as well as a NIL sexp_type.  In a linear
+    // sexp, an empty list is a lone terminator.
+    if (s == NULL || s->sexp_type == SEXP_NIL ||
+        s->sexp_type == SEXP_LIST_TERMINATOR)
         return true;
 
     // the symbol 'nil or 'NIL is also considered nil
-    if (s->sexp_type == SEXP_SYMBOL && (strcmp("nil", (char*)s->data) == 0 ||
-                                        strcmp("NIL", (char*)s->data) == 0)) {
-        return true;
+    if (s->sexp_type == SEXP_SYMBOL) {
+        struct sexp_view sym = atom_view(s);
+        if (sym.length == 3 && (strncmp("nil", sym.str, 3) == 0 ||
+                                strncmp("NIL", sym.str, 3) == 0))
+            return true;
     }
 
+    // linear sexps don't store pointers, and atoms don't have a cdr.
+    if (s->is_linear || s->sexp_type != SEXP_CONS)
+        return false;
+
     // can't use sexp_cdr here, because sexp_cdr uses this function.
     struct cons *cons_data = (struct cons *)s->data;
 
@@ -204,7 +268,9 @@ struct result_sexp
 sexp_nth(const sexp *s, size_t n) {
     if (sexp_is_nil(s))
         return sexp_nil();
-        
+
+    s = sexp_linear_value(s);
+
     if (s->sexp_type != SEXP_CONS)
         return RESULT_MSG_ERROR(sexp, "dst is %s, not a %s",
                                 g_reflected_sexp_type[s->sexp_type],
@@ -229,6 +295,8 @@ struct result_sexp sexp_last(sexp *s) {
     if (sexp_is_nil(s))
         return sexp_nil();
 
+    s = sexp_linear_value(s);
+
     if (s->sexp_type != SEXP_CONS)
         return RESULT_MSG_ERROR(sexp, "dst is %s, not a %s",
                                 g_reflected_sexp_type[s->sexp_type],
@@ -255,12 +323,12 @@ struct result_sexp sexp_rlast(struct result_sexp list) {
 
 struct result_sexp
 sexp_append(sexp *list1, sexp *list2) {
-    if ((!sexp_is_nil(list1) || !sexp_is_nil(list2)) &&
+    if ((!sexp_is_nil(list1) && !sexp_is_nil(list2)) &&
         list1->is_linear != list2->is_linear)
         return RESULT_MSG_ERROR(sexp, "list1 and list2 have different memory layouts");
 
-    enum sexp_type t1 = sexp_is_nil(list1) ? SEXP_CONS : list1->sexp_type;
-    enum sexp_type t2 = sexp_is_nil(list2) ? SEXP_CONS : list2->sexp_type;
+    enum sexp_type t1 = sexp_is_nil(list1) ? SEXP_CONS : sexp_type(list1);
+    enum sexp_type t2 = sexp_is_nil(list2) ? SEXP_CONS : sexp_type(list2);
     char *msg_part = NULL;
     if (t1 != SEXP_CONS && t2 != SEXP_CONS)
         msg_part = "list1 and list2 are";
@@ -276,7 +344,8 @@ sexp_append(sexp *list1, sexp *list2) {
     sexp *ret;
     struct result_sexp r;
 
-    bool is_linear = sexp_is_nil(list1) ? true : list1->is_linear;
+    bool is_linear = sexp_is_nil(list1) ? list2 != NULL && list2->is_linear
+                                        : list1->is_linear;
 
     r = make_sexp(SEXP_CONS,
                   is_linear ? SEXP_MEMORY_LINEAR : SEXP_MEMORY_TREE,
@@ -328,8 +397,32 @@ sexp_append(sexp *list1, sexp *list2) {
 
         return result_sexp_ok(ret);
     } else {
-        // optimized method for linear memory layout.
-        return RESULT_MSG_ERROR(sexp, "not implemented");
+        // the elements are copied directly into the new block.
+        struct result_void reserved =
+            sexp_linear_reserve(ret, sexp_linear_size(list1)
+                                     + sexp_linear_size(list2));
+        if (reserved.status == RESULT_ERROR) {
+            free_sexp(ret);
+            return result_sexp_error(reserved.error);
+        }
+
+        sexp *end = ret;
+        for (s32 x = 0; x <= 1; x++) {
+            sexp *lists[] = {list1, list2};
+
+            for (sexp *i = lists[x]; sexp_is_nil(i) == false; ) {
+                sexp *car;
+                RESULT_UNWRAP(sexp, car, sexp_car(i));
+
+                RESULT_UNWRAP(sexp, end,
+                              sexp_linear_grow_list(end, sexp_linear_size(car)));
+                sexp_linear_write(end->data, car);
+
+                RESULT_UNWRAP(sexp, i, sexp_cdr(i));
+            }
+        }
+
+        return result_sexp_ok(ret);
     }
 }
 
@@ -345,6 +438,8 @@ sexp_length(const sexp *s) {
     if (sexp_is_nil(s))
         return result_u32_ok(0);
 
+    s = sexp_linear_value(s);
+
     if (s->sexp_type != SEXP_CONS)
         return RESULT_MSG_ERROR(u32, "incorrect type");
 
@@ -364,31 +459,31 @@ sexp_length(const sexp *s) {
 // cons that was constructed to hold the data.  if list is NIL, but is not NULL,
 // then the existing cons will be repurposed for the list element.
 struct result_sexp _sexp_push_data(sexp *list, enum sexp_type type, void* data) {
-    sexp *end;
-    if (list == NULL) {
-        RESULT_UNWRAP(sexp, end, make_cons_sexp());
-    } else if (sexp_is_nil(list)) {
-        list->sexp_type = SEXP_CONS;
-        RESULT_CALL(sexp, sexp_rsetcar(result_sexp_ok(list), sexp_nil()));
-        RESULT_CALL(sexp, sexp_rsetcdr(result_sexp_ok(list), sexp_nil()));
-        end = list;
-    } else {
-        RESULT_UNWRAP(sexp, end, sexp_last(list));
+    if (list != NULL && list->is_linear) {
+        sexp *cons;
+        RESULT_UNWRAP(sexp, cons,
+                      sexp_linear_grow_list(list,
+                                            sexp_linear_atom_size(type, data)));
+
+        sexp_linear_write_atom(cons->data, type, data);
+        return result_sexp_ok(cons);
     }
 
-    enum sexp_memory_method mem_method = end->is_linear ?
-        SEXP_MEMORY_LINEAR : SEXP_MEMORY_TREE;
-
-    sexp *new_end;
-    RESULT_UNWRAP(sexp, new_end, make_sexp(SEXP_CONS, mem_method, NULL));
+    sexp *item;
+    RESULT_UNWRAP(sexp, item, make_sexp(type, SEXP_MEMORY_TREE, data));
 
-    RESULT_CALL(sexp, sexp_setcdr(end, new_end));
-
-    sexp *new_item;
-    RESULT_UNWRAP(sexp, new_item, make_sexp(type, mem_method, data));
+    // an empty list, or a list made by make_sexp(), which starts as a single
+    // empty cons, is filled by the first push.
+    if (list != NULL && (sexp_is_nil(list) ||
+                         (list->sexp_type == SEXP_CONS &&
+                          ((union sexp_data *)list->data)->cons.car == NULL &&
+                          ((union sexp_data *)list->data)->cons.cdr == NULL))) {
+        list->sexp_type = SEXP_CONS;
+        RESULT_CALL(sexp, sexp_setcdr(list, NULL));
+        return sexp_setcar(list, item);
+    }
 
-    RESULT_CALL(sexp, sexp_setcar(end, new_item));
-    return result_sexp_ok(end);
+    return sexp_push(list, item);
 }
 
 struct result_sexp sexp_push_integer(sexp *list, s32 num) {
@@ -403,6 +498,17 @@ struct result_sexp sexp_push_symbol(sexp *list, const char *sym) {
     return _sexp_push_data(list, SEXP_SYMBOL, (void*)sym);
 }
 
+struct result_sexp sexp_push_nil(sexp *list) {
+    return _sexp_push_data(list, SEXP_NIL, NULL);
+}
+
+struct result_sexp sexp_rpush_nil(struct result_sexp list) {
+    if (list.status == RESULT_ERROR)
+        return list;
+
+    return sexp_push_nil(list.ok);
+}
+
 struct result_sexp sexp_push_tag(sexp *list) {
     (void)list;
     return RESULT_MSG_ERROR(sexp, "Not Implemented");
@@ -412,9 +518,13 @@ struct result_sexp sexp_push_tag(sexp *list) {
 struct result_sexp sexp_tag_get_tag(const sexp *s) {
     if (sexp_type(s) != SEXP_TAG)
         return RESULT_MSG_ERROR(sexp, "dst is %s, not a %s",
-                                g_reflected_sexp_type[s->sexp_type],
+                                g_reflected_sexp_type[sexp_type(s)],
                                 g_reflected_sexp_type[SEXP_TAG]);
 
+    s = sexp_linear_value(s);
+    if (s->is_linear)
+        return result_sexp_ok((struct sexp *)s->data);
+
     struct cons cons = ((union sexp_data*)s->data)->cons;
     return result_sexp_ok(cons.car);
 }
@@ -422,15 +532,31 @@ struct result_sexp sexp_tag_get_tag(const sexp *s) {
 struct result_sexp sexp_tag_get_atom(const sexp *s) {
     if (sexp_type(s) != SEXP_TAG)
         return RESULT_MSG_ERROR(sexp, "dst is %s, not a %s",
-                                g_reflected_sexp_type[s->sexp_type],
+                                g_reflected_sexp_type[sexp_type(s)],
                                 g_reflected_sexp_type[SEXP_TAG]);
 
+    s = sexp_linear_value(s);
+    if (s->is_linear)
+        return result_sexp_ok((struct sexp *)(s->data + s->data_length));
+
     struct cons cons = ((union sexp_data*)s->data)->cons;
     return result_sexp_ok(cons.cdr);
 }
 
 
 struct result_sexp sexp_push(sexp *list, sexp *item) {
+    // the item is copied into the block, and then freed like it would be
+    // if it was linked into a tree list.
+    if (list != NULL && list->is_linear) {
+        sexp *cons;
+        RESULT_UNWRAP(sexp, cons,
+                      sexp_linear_grow_list(list, sexp_linear_size(item)));
+
+        sexp_linear_write(cons->data, item);
+        free_sexp(item);
+        return result_sexp_ok(cons);
+    }
+
     struct result_sexp old_end;
     if (list == NULL) {
         old_end = make_cons_sexp();
@@ -467,6 +593,77 @@ struct result_sexp sexp_rpush(struct result_sexp list, struct result_sexp item)
     return sexp_push(list.ok, item.ok);
 }
 
+/******************************** LIST BUILDER ********************************/
+struct result_void sexp_builder_init(struct sexp_list_builder *builder,
+                                     enum sexp_memory_method method) {
+    builder->tail = NULL;
+    builder->list = NULL;
+
+    // a tree list is NIL until its first cons is made.
+    if (method == SEXP_MEMORY_TREE)
+        return result_void_ok(0);
+
+    RESULT_UNWRAP(void, builder->list,
+                  make_sexp(SEXP_CONS, SEXP_MEMORY_LINEAR, NULL));
+
+    return result_void_ok(0);
+}
+
+struct result_sexp sexp_builder_push(struct sexp_list_builder *builder,
+                                     struct result_sexp item) {
+    if (item.status == RESULT_ERROR)
+        return item;
+
+    // the last cons of a linear list is next to its terminator, so pushing
+    // onto the tail doesn't walk the list.
+    if (builder->list != NULL && builder->list->is_linear) {
+        sexp *end = builder->tail != NULL ? builder->tail : builder->list;
+        RESULT_UNWRAP(sexp, builder->tail, sexp_push(end, item.ok));
+
+        return result_sexp_ok(builder->tail);
+    }
+
+    struct result_sexp r = make_cons_sexp();
+    if (r.status == RESULT_ERROR) {
+        free_sexp(item.ok);
+        return r;
+    }
+
+    sexp *cons = r.ok;
+    ((union sexp_data *)cons->data)->cons.car = item.ok;
+
+    if (builder->tail == NULL)
+        builder->list = cons;
+    else
+        ((union sexp_data *)builder->tail->data)->cons.cdr = cons;
+
+    builder->tail = cons;
+    return result_sexp_ok(cons);
+}
+
+struct result_sexp sexp_builder_push_integer(struct sexp_list_builder *builder,
+                                             s32 num) {
+    return sexp_builder_push(builder, make_integer_sexp(num));
+}
+
+struct result_sexp sexp_builder_push_string(struct sexp_list_builder *builder,
+                                            const char *str) {
+    return sexp_builder_push(builder, make_string_sexp(str));
+}
+
+struct result_sexp sexp_builder_push_symbol(struct sexp_list_builder *builder,
+                                            const char *sym) {
+    return sexp_builder_push(builder, make_symbol_sexp(sym));
+}
+
+sexp *sexp_builder_finish(struct sexp_list_builder *builder) {
+    sexp *list = builder->list;
+
+    builder->list = NULL;
+    builder->tail = NULL;
+    return list;
+}
+
 struct result_sexp sexp_nil() {
     return result_sexp_ok(NULL);
 }
@@ -475,5 +672,5 @@ enum sexp_type sexp_type(const struct sexp *s) {
     if (sexp_is_nil(s))
         return SEXP_NIL;
 
-    return s->sexp_type;
+    return sexp_linear_value(s)->sexp_type;
 }
@@ -0,0 +1,198 @@
+#include "spatial-grid.h"
+#include "error.h"
+#include "scenario.h"
+#include "vector.h"
+
+#include <stdint.h>
+#include <string.h>
+
+struct result_void make_spatial_grid(struct spatial_grid *grid, s32 cell_size) {
+    grid->cell_size = cell_size;
+    grid->bucket_mask = 0;
+    grid->buckets = make_vector(sizeof(u32), 64);
+    grid->positions = make_vector(sizeof(struct coord), 64);
+    grid->next = make_vector(sizeof(u32), 64);
+    grid->prev = make_vector(sizeof(u32), 64);
+
+    if (grid->buckets == NULL || grid->positions == NULL ||
+        grid->next == NULL || grid->prev == NULL) {
+        free_spatial_grid(grid);
+        return RESULT_MSG_ERROR(void, "failed to allocate spatial grid");
+    }
+
+    return result_void_ok(0);
+}
+
+void free_spatial_grid(struct spatial_grid *grid) {
+    free_vector(grid->buckets);
+    free_vector(grid->positions);
+    free_vector(grid->next);
+    free_vector(grid->prev);
+
+    grid->buckets = NULL;
+    grid->positions = NULL;
+    grid->next = NULL;
+    grid->prev = NULL;
+}
+
+/** rounds towards negative infinity, so that cells don't straddle 0. */
+s32 spatial_grid_cell(const struct spatial_grid *grid, s32 x) {
+    s32 cell = x / grid->cell_size;
+    if (x % grid->cell_size < 0)
+        cell--;
+
+    return cell;
+}
+
+u32 spatial_grid_bucket(const struct spatial_grid *grid, s32 cell_x, s32 cell_y) {
+    u32 hash = ((u32)cell_x * 73856093u) ^ ((u32)cell_y * 19349663u);
+    return hash & grid->bucket_mask;
+}
+
+u32 spatial_grid_bucket_of(const struct spatial_grid *grid, struct coord pos) {
+    return spatial_grid_bucket(grid,
+                               spatial_grid_cell(grid, pos.x),
+                               spatial_grid_cell(grid, pos.y));
+}
+
+struct result_void spatial_grid_reset(struct spatial_grid *grid, u32 len) {
+    // at least two buckets per item keeps the lists short.
+    u32 buckets = 64;
+    while (buckets < 2 * len)
+        buckets *= 2;
+
+    if (vec_resize(grid->buckets, buckets) < 0 ||
+        vec_resize(grid->positions, len) < 0 ||
+        vec_resize(grid->next, len) < 0 ||
+        vec_resize(grid->prev, len) < 0)
+        return RESULT_MSG_ERROR(void, "failed to grow spatial grid");
+
+    grid->bucket_mask = buckets - 1;
+    memset(vec_dat(grid->buckets), 0xff, buckets * sizeof(u32));
+
+    return result_void_ok(0);
+}
+
+void spatial_grid_link(struct spatial_grid *grid, u32 id) {
+    u32 *buckets = vec_dat(grid->buckets);
+    u32 *next = vec_dat(grid->next);
+    u32 *prev = vec_dat(grid->prev);
+    struct coord *positions = vec_dat(grid->positions);
+
+    u32 bucket = spatial_grid_bucket_of(grid, positions[id]);
+
+    next[id] = buckets[bucket];
+    prev[id] = SPATIAL_GRID_NONE;
+    if (buckets[bucket] != SPATIAL_GRID_NONE)
+        prev[buckets[bucket]] = id;
+
+    buckets[bucket] = id;
+}
+
+void spatial_grid_unlink(struct spatial_grid *grid, u32 id) {
+    u32 *buckets = vec_dat(grid->buckets);
+    u32 *next = vec_dat(grid->next);
+    u32 *prev = vec_dat(grid->prev);
+    struct coord *positions = vec_dat(grid->positions);
+
+    if (prev[id] != SPATIAL_GRID_NONE)
+        next[prev[id]] = next[id];
+    else
+        buckets[spatial_grid_bucket_of(grid, positions[id])] = next[id];
+
+    if (next[id] != SPATIAL_GRID_NONE)
+        prev[next[id]] = prev[id];
+}
+
+void spatial_grid_insert(struct spatial_grid *grid, u32 id, struct coord pos) {
+    struct coord *positions = vec_dat(grid->positions);
+    positions[id] = pos;
+    spatial_grid_link(grid, id);
+}
+
+void spatial_grid_move(struct spatial_grid *grid, u32 id, struct coord pos) {
+    struct coord *positions = vec_dat(grid->positions);
+
+    // most moves stay in the same cell.
+    if (spatial_grid_bucket_of(grid, positions[id]) ==
+        spatial_grid_bucket_of(grid, pos)) {
+        positions[id] = pos;
+        return;
+    }
+
+    spatial_grid_unlink(grid, id);
+    positions[id] = pos;
+    spatial_grid_link(grid, id);
+}
+
+u32 spatial_grid_find(const struct spatial_grid *grid, struct coord pos) {
+    const u32 *buckets = vec_dat(grid->buckets);
+    const u32 *next = vec_dat(grid->next);
+    const struct coord *positions = vec_dat(grid->positions);
+
+    // a bucket isn't ordered, so the whole list is searched for the lowest id.
+    u32 found = SPATIAL_GRID_NONE;
+    for (u32 id = buckets[spatial_grid_bucket_of(grid, pos)];
+         id != SPATIAL_GRID_NONE; id = next[id]) {
+        if (positions[id].x == pos.x && positions[id].y == pos.y && id < found)
+            found = id;
+    }
+
+    return found;
+}
+
+/** clamps a coordinate to the range of s32. */
+s32 spatial_grid_clamp(s64 x) {
+    if (x < INT32_MIN)
+        return INT32_MIN;
+    if (x > INT32_MAX)
+        return INT32_MAX;
+
+    return x;
+}
+
+struct result_void spatial_grid_query_radius(const struct spatial_grid *grid,
+                                             struct coord center, s32 radius,
+                                             struct vector *ids) {
+    const u32 *buckets = vec_dat(grid->buckets);
+    const u32 *next = vec_dat(grid->next);
+    const struct coord *positions = vec_dat(grid->positions);
+
+    // the bounds of a center near the edge of the map would overflow.
+    s32 left = spatial_grid_clamp((s64)center.x - radius),
+        right = spatial_grid_clamp((s64)center.x + radius),
+        bottom = spatial_grid_clamp((s64)center.y - radius),
+        top = spatial_grid_clamp((s64)center.y + radius);
+
+    s64 min_x = spatial_grid_cell(grid, left),
+        max_x = spatial_grid_cell(grid, right),
+        min_y = spatial_grid_cell(grid, bottom),
+        max_y = spatial_grid_cell(grid, top);
+    s64 radius_sq = (s64)radius * radius;
+
+    for (s64 cell_y = min_y; cell_y <= max_y; cell_y++) {
+        for (s64 cell_x = min_x; cell_x <= max_x; cell_x++) {
+            u32 bucket = spatial_grid_bucket(grid, cell_x, cell_y);
+
+            // other cells hash to the same bucket, so each item's own cell
+            // is checked too.  Otherwise it could be pushed twice.
+            for (u32 id = buckets[bucket]; id != SPATIAL_GRID_NONE;
+                 id = next[id]) {
+                struct coord pos = positions[id];
+                if (spatial_grid_cell(grid, pos.x) != cell_x ||
+                    spatial_grid_cell(grid, pos.y) != cell_y)
+                    continue;
+
+                s64 dx = (s64)pos.x - center.x,
+                    dy = (s64)pos.y - center.y;
+                if (dx * dx + dy * dy > radius_sq)
+                    continue;
+
+                if (vec_push(ids, &id) < 0)
+                    return RESULT_MSG_ERROR(void, "failed to push query result");
+            }
+        }
+    }
+
+    return result_void_ok(0);
+}
@@ -0,0 +1,372 @@
+#include "tank-table.h"
+#include "error.h"
+#include "scenario.h"
+#include "spatial-grid.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef TANK_KERNEL_X86
+#include <immintrin.h>
+#endif
+
+void make_tank_table(struct tank_table *table) {
+    *table = (struct tank_table) {0};
+}
+
+void free_tank_table(struct tank_table *table) {
+    free(table->health);
+    free(table->cmd);
+    free(table->pos_x);
+    free(table->pos_y);
+    free(table->target_x);
+    free(table->target_y);
+
+    make_tank_table(table);
+}
+
+/** reallocates one of the table's arrays.  The array is left alone if this
+    fails. */
+int tank_table_realloc(void **array, u32 capacity, size_t elem_size) {
+    void *tmp = realloc(*array, capacity * elem_size);
+    if (tmp == NULL)
+        return -1;
+
+    *array = tmp;
+    return 0;
+}
+
+int tank_table_reserve(struct tank_table *table, u32 capacity) {
+    if (table->capacity >= capacity)
+        return 0;
+
+    capacity = capacity < 64 ? 64 : capacity * 2;
+
+    struct { void **array; size_t elem_size; } arrays[] = {
+        {(void **)&table->health, sizeof(u32)},
+        {(void **)&table->cmd, sizeof(enum tank_command)},
+        {(void **)&table->pos_x, sizeof(s32)},
+        {(void **)&table->pos_y, sizeof(s32)},
+        {(void **)&table->target_x, sizeof(s32)},
+        {(void **)&table->target_y, sizeof(s32)},
+    };
+
+    // arrays that were already grown keep their new size if a later one
+    // fails, which is harmless, since the capacity isn't updated.
+    for (size_t i = 0; i < sizeof(arrays) / sizeof(arrays[0]); i++) {
+        if (tank_table_realloc(arrays[i].array, capacity,
+                               arrays[i].elem_size) < 0)
+            return -1;
+    }
+
+    table->capacity = capacity;
+    return 0;
+}
+
+struct result_void tank_table_push(struct tank_table *table,
+                                   const struct tank *tank) {
+    if (tank_table_reserve(table, table->len + 1) < 0)
+        return RESULT_MSG_ERROR(void, "failed to grow the tank table");
+
+    u32 id = table->len++;
+    table->health[id] = tank->health;
+    table->cmd[id] = tank->cmd;
+    table->pos_x[id] = tank->pos.x;
+    table->pos_y[id] = tank->pos.y;
+
+    struct coord target = tank->cmd == TANK_FIRE ? tank->aim_at : tank->move_to;
+    table->target_x[id] = target.x;
+    table->target_y[id] = target.y;
+
+    return result_void_ok(0);
+}
+
+void tank_table_remove(struct tank_table *table, u32 first, u32 count) {
+    if (first >= table->len)
+        return;
+
+    if (count > table->len - first)
+        count = table->len - first;
+
+    u32 after = table->len - first - count;
+
+#define TANK_TABLE_SHIFT(array) \
+    memmove(&table->array[first], &table->array[first + count], \
+            after * sizeof(table->array[0]))
+
+    TANK_TABLE_SHIFT(health);
+    TANK_TABLE_SHIFT(cmd);
+    TANK_TABLE_SHIFT(pos_x);
+    TANK_TABLE_SHIFT(pos_y);
+    TANK_TABLE_SHIFT(target_x);
+    TANK_TABLE_SHIFT(target_y);
+
+#undef TANK_TABLE_SHIFT
+
+    table->len -= count;
+}
+
+/******************************* HEALTH & FIRE ********************************/
+void tank_table_heal(struct tank_table *table, u32 first, u32 last) {
+    for (u32 id = first; id < last; id++) {
+        if (table->cmd[id] != TANK_HEAL)
+            continue;
+
+        table->health[id] += TANK_HEAL_RATE;
+
+        if (table->health[id] > 100)
+            table->health[id] = 100;
+    }
+}
+
+/// Friendly fire is on. tanks can also shoot themselves.
+u32 tank_table_fire(const struct tank_table *table,
+                    const struct spatial_grid *grid, u32 first, u32 last,
+                    u32 *damage) {
+    u32 hits = 0;
+
+    for (u32 id = first; id < last; id++) {
+        if (table->cmd[id] != TANK_FIRE)
+            continue;
+
+        // shells don't fly further than TANK_FIRE_DISTANCE.
+        s64 dx = (s64)table->target_x[id] - table->pos_x[id],
+            dy = (s64)table->target_y[id] - table->pos_y[id];
+        if (dx * dx + dy * dy > (s64)TANK_FIRE_DISTANCE * TANK_FIRE_DISTANCE)
+            continue;
+
+        // the first tank at the target, in player then tank order, is hit.
+        struct coord aim_at = { table->target_x[id], table->target_y[id] };
+        u32 target = spatial_grid_find(grid, aim_at);
+        if (target == SPATIAL_GRID_NONE)
+            continue;
+
+        damage[target] += TANK_SHELL_DAMAGE;
+        hits++;
+    }
+
+    return hits;
+}
+
+void tank_table_apply_damage(struct tank_table *table, u32 first, u32 last,
+                             u32 *const *damage, size_t len) {
+    for (size_t d = 0; d < len; d++) {
+        for (u32 id = first; id < last; id++) {
+            table->health[id] -= damage[d][id];
+            damage[d][id] = 0;
+        }
+    }
+}
+
+/********************************** MOVEMENT **********************************/
+/* Every path computes the same IEEE single precision operations, in the same
+   order, so they agree bit for bit:
+
+     dx = (float)(target_x - pos_x)
+     distance = sqrt(dx * dx + dy * dy)
+     pos_x = distance <= TANK_MAX_SPEED
+         ? target_x
+         : pos_x + roundf((dx / distance) * TANK_MAX_SPEED)
+
+   Coordinates are added and subtracted with wrapping 32 bit arithmetic, like
+   the vector instructions do, so huge coordinates can't overflow.  The
+   vector paths build roundf() out of a truncation, since their own rounding
+   breaks ties to even rather than away from zero. */
+
+// the vector kernels load commands as 32 bit lanes.
+_Static_assert(sizeof(enum tank_command) == sizeof(s32),
+               "tank commands must be 32 bits wide");
+
+/** wrapping s32 arithmetic. */
+s32 tank_wrapping_sub(s32 a, s32 b) { return (s32)((u32)a - (u32)b); }
+s32 tank_wrapping_add(s32 a, s32 b) { return (s32)((u32)a + (u32)b); }
+
+void tank_table_move_scalar(struct tank_table *table, u32 first, u32 last) {
+    for (u32 id = first; id < last; id++) {
+        if (table->cmd[id] != TANK_MOVE)
+            continue;
+
+        float dx = tank_wrapping_sub(table->target_x[id], table->pos_x[id]),
+              dy = tank_wrapping_sub(table->target_y[id], table->pos_y[id]);
+
+        float distance = sqrtf(dx * dx + dy * dy);
+        if (distance <= TANK_MAX_SPEED) {
+            table->pos_x[id] = table->target_x[id];
+            table->pos_y[id] = table->target_y[id];
+            continue;
+        }
+
+        // otherwise, we can only move the max distance. move the tank
+        // TANK_MAX_SPEED units towards the target.
+        s32 step_x = roundf((dx / distance) * TANK_MAX_SPEED),
+            step_y = roundf((dy / distance) * TANK_MAX_SPEED);
+        table->pos_x[id] = tank_wrapping_add(table->pos_x[id], step_x);
+        table->pos_y[id] = tank_wrapping_add(table->pos_y[id], step_y);
+    }
+}
+
+#ifdef TANK_KERNEL_X86
+/** roundf() of each lane, which are all small enough to fit an int. */
+__m128i tank_round_sse2(__m128 v) {
+    __m128i truncated = _mm_cvttps_epi32(v);
+    __m128 diff = _mm_sub_ps(v, _mm_cvtepi32_ps(truncated));
+
+    // comparisons are all ones (-1) where true.
+    __m128i up = _mm_castps_si128(_mm_cmpge_ps(diff, _mm_set1_ps(0.5f)));
+    __m128i down = _mm_castps_si128(_mm_cmple_ps(diff, _mm_set1_ps(-0.5f)));
+    return _mm_add_epi32(_mm_sub_epi32(truncated, up), down);
+}
+
+__m128i tank_select_sse2(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+void tank_table_move_sse2(struct tank_table *table, u32 first, u32 last) {
+    const __m128i move = _mm_set1_epi32(TANK_MOVE);
+    const __m128 max_speed = _mm_set1_ps(TANK_MAX_SPEED);
+
+    u32 id = first;
+    for (; id + 4 <= last; id += 4) {
+        __m128i cmd = _mm_loadu_si128((const __m128i *)&table->cmd[id]);
+        __m128i moving = _mm_cmpeq_epi32(cmd, move);
+        if (_mm_movemask_epi8(moving) == 0)
+            continue;
+
+        __m128i x = _mm_loadu_si128((const __m128i *)&table->pos_x[id]);
+        __m128i y = _mm_loadu_si128((const __m128i *)&table->pos_y[id]);
+        __m128i xx = _mm_loadu_si128((const __m128i *)&table->target_x[id]);
+        __m128i yy = _mm_loadu_si128((const __m128i *)&table->target_y[id]);
+
+        __m128 dx = _mm_cvtepi32_ps(_mm_sub_epi32(xx, x));
+        __m128 dy = _mm_cvtepi32_ps(_mm_sub_epi32(yy, y));
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(dx, dx),
+                                                 _mm_mul_ps(dy, dy)));
+
+        __m128i step_x = tank_round_sse2(
+            _mm_mul_ps(_mm_div_ps(dx, distance), max_speed));
+        __m128i step_y = tank_round_sse2(
+            _mm_mul_ps(_mm_div_ps(dy, distance), max_speed));
+
+        __m128i arrives = _mm_castps_si128(_mm_cmple_ps(distance, max_speed));
+        __m128i new_x = tank_select_sse2(arrives, xx, _mm_add_epi32(x, step_x));
+        __m128i new_y = tank_select_sse2(arrives, yy, _mm_add_epi32(y, step_y));
+
+        _mm_storeu_si128((__m128i *)&table->pos_x[id],
+                         tank_select_sse2(moving, new_x, x));
+        _mm_storeu_si128((__m128i *)&table->pos_y[id],
+                         tank_select_sse2(moving, new_y, y));
+    }
+
+    tank_table_move_scalar(table, id, last);
+}
+
+__attribute__((target("avx2")))
+__m256i tank_round_avx2(__m256 v) {
+    __m256i truncated = _mm256_cvttps_epi32(v);
+    __m256 diff = _mm256_sub_ps(v, _mm256_cvtepi32_ps(truncated));
+
+    __m256i up = _mm256_castps_si256(
+        _mm256_cmp_ps(diff, _mm256_set1_ps(0.5f), _CMP_GE_OQ));
+    __m256i down = _mm256_castps_si256(
+        _mm256_cmp_ps(diff, _mm256_set1_ps(-0.5f), _CMP_LE_OQ));
+    return _mm256_add_epi32(_mm256_sub_epi32(truncated, up), down);
+}
+
+__attribute__((target("avx2")))
+void tank_table_move_avx2(struct tank_table *table, u32 first, u32 last) {
+    const __m256i move = _mm256_set1_epi32(TANK_MOVE);
+    const __m256 max_speed = _mm256_set1_ps(TANK_MAX_SPEED);
+
+    u32 id = first;
+    for (; id + 8 <= last; id += 8) {
+        __m256i cmd = _mm256_loadu_si256((const __m256i *)&table->cmd[id]);
+        __m256i moving = _mm256_cmpeq_epi32(cmd, move);
+        if (_mm256_testz_si256(moving, moving))
+            continue;
+
+        __m256i x = _mm256_loadu_si256((const __m256i *)&table->pos_x[id]);
+        __m256i y = _mm256_loadu_si256((const __m256i *)&table->pos_y[id]);
+        __m256i xx = _mm256_loadu_si256((const __m256i *)&table->target_x[id]);
+        __m256i yy = _mm256_loadu_si256((const __m256i *)&table->target_y[id]);
+
+        __m256 dx = _mm256_cvtepi32_ps(_mm256_sub_epi32(xx, x));
+        __m256 dy = _mm256_cvtepi32_ps(_mm256_sub_epi32(yy, y));
+        __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx),
+                                                       _mm256_mul_ps(dy, dy)));
+
+        __m256i step_x = tank_round_avx2(
+            _mm256_mul_ps(_mm256_div_ps(dx, distance), max_speed));
+        __m256i step_y = tank_round_avx2(
+            _mm256_mul_ps(_mm256_div_ps(dy, distance), max_speed));
+
+        __m256i arrives = _mm256_castps_si256(
+            _mm256_cmp_ps(distance, max_speed, _CMP_LE_OQ));
+        __m256i new_x = _mm256_blendv_epi8(_mm256_add_epi32(x, step_x),
+                                           xx, arrives);
+        __m256i new_y = _mm256_blendv_epi8(_mm256_add_epi32(y, step_y),
+                                           yy, arrives);
+
+        _mm256_storeu_si256((__m256i *)&table->pos_x[id],
+                            _mm256_blendv_epi8(x, new_x, moving));
+        _mm256_storeu_si256((__m256i *)&table->pos_y[id],
+                            _mm256_blendv_epi8(y, new_y, moving));
+    }
+
+    tank_table_move_scalar(table, id, last);
+}
+#endif
+
+bool tank_kernel_supported(enum tank_kernel kernel) {
+    switch (kernel) {
+    case TANK_KERNEL_SCALAR:
+        return true;
+#ifdef TANK_KERNEL_X86
+    case TANK_KERNEL_SSE2:
+        return true;
+    case TANK_KERNEL_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+enum tank_kernel tank_kernel_best(void) {
+    if (tank_kernel_supported(TANK_KERNEL_AVX2))
+        return TANK_KERNEL_AVX2;
+    if (tank_kernel_supported(TANK_KERNEL_SSE2))
+        return TANK_KERNEL_SSE2;
+
+    return TANK_KERNEL_SCALAR;
+}
+
+void tank_table_move_range_with(struct tank_table *table,
+                                enum tank_kernel kernel, u32 first, u32 last) {
+    switch (kernel) {
+#ifdef TANK_KERNEL_X86
+    case TANK_KERNEL_SSE2:
+        tank_table_move_sse2(table, first, last);
+        break;
+    case TANK_KERNEL_AVX2:
+        tank_table_move_avx2(table, first, last);
+        break;
+#endif
+    default:
+        tank_table_move_scalar(table, first, last);
+        break;
+    }
+}
+
+void tank_table_move_with(struct tank_table *table, enum tank_kernel kernel) {
+    tank_table_move_range_with(table, kernel, 0, table->len);
+}
+
+void tank_table_move(struct tank_table *table) {
+    tank_table_move_with(table, tank_kernel_best());
+}
+
+void tank_table_move_range(struct tank_table *table, u32 first, u32 last) {
+    tank_table_move_range_with(table, tank_kernel_best(), first, last);
+}
@@ -0,0 +1,126 @@
+#include "tank-view.h"
+#include "error.h"
+#include "scenario.h"
+#include "spatial-grid.h"
+#include "vector.h"
+
+#include <stdlib.h>
+
+int tank_view_compare_ids(const void *a, const void *b) {
+    u32 x = *(const u32 *)a, y = *(const u32 *)b;
+    return (x > y) - (x < y);
+}
+
+struct result_void tank_view_collect(const struct tank_view_source *src,
+                                     u32 player, struct vector *scratch,
+                                     struct vector *view) {
+    const struct coord *positions = vec_dat(src->grid->positions);
+    u32 first = player * src->tanks_per_player;
+
+    vec_resize(scratch, 0);
+    vec_resize(view, 0);
+
+    // each tank is within range of itself, so a player always sees its own.
+    for (u32 id = first; id < first + src->tanks_per_player; id++) {
+        RESULT_CALL(void, spatial_grid_query_radius(src->grid, positions[id],
+                                                    TANK_SENSOR_RANGE,
+                                                    scratch));
+    }
+
+    // tanks near several of the player's tanks were found once for each.
+    // Sorting by id sorts them by player id then tank, too.
+    u32 *ids = vec_dat(scratch);
+    size_t len = vec_len(scratch);
+    qsort(ids, len, sizeof(u32), tank_view_compare_ids);
+
+    for (size_t i = 0; i < len; i++) {
+        if (i > 0 && ids[i] == ids[i - 1])
+            continue;
+
+        u32 id = ids[i];
+        struct tank_delta tank = {
+            .player_id = src->player_ids[id / src->tanks_per_player],
+            .tank = id % src->tanks_per_player,
+            .pos = positions[id],
+            .health = src->health[id],
+        };
+        if (vec_push(view, &tank) < 0)
+            return RESULT_MSG_ERROR(void, "failed to push visible tank");
+    }
+
+    return result_void_ok(0);
+}
+
+/** orders tanks by player id, then tank. */
+int tank_view_order(const struct tank_delta *a, const struct tank_delta *b) {
+    if (a->player_id != b->player_id)
+        return a->player_id < b->player_id ? -1 : 1;
+    if (a->tank != b->tank)
+        return a->tank < b->tank ? -1 : 1;
+    return 0;
+}
+
+int tank_view_diff(const struct vector *was, const struct vector *now,
+                   struct vector *changes, struct vector *removals,
+                   struct vector *new_players) {
+    const struct tank_delta *old = vec_ref(was, 0), *cur = vec_ref(now, 0);
+    size_t num_old = vec_len(was), num_cur = vec_len(now);
+    size_t o = 0, c = 0;
+
+    while (o < num_old || c < num_cur) {
+        int order = o == num_old ? 1
+                  : c == num_cur ? -1
+                  : tank_view_order(&old[o], &cur[c]);
+
+        if (order < 0) {
+            struct tank_key gone = {old[o].player_id, old[o].tank};
+            if (vec_push(removals, &gone) < 0)
+                return -1;
+            o++;
+            continue;
+        }
+
+        if (order == 0 && old[o].pos.x == cur[c].pos.x &&
+            old[o].pos.y == cur[c].pos.y && old[o].health == cur[c].health) {
+            o++, c++;
+            continue;
+        }
+
+        if (vec_push(changes, &cur[c]) < 0)
+            return -1;
+        if (order == 0)
+            o++;
+        c++;
+    }
+
+    // both views are sorted by player id, so their players are too.
+    o = 0;
+    for (c = 0; c < num_cur; c++) {
+        u32 id = cur[c].player_id;
+        if (c > 0 && cur[c - 1].player_id == id)
+            continue;
+
+        while (o < num_old && old[o].player_id < id)
+            o++;
+        if (o < num_old && old[o].player_id == id)
+            continue;
+
+        if (vec_push(new_players, &id) < 0)
+            return -1;
+    }
+
+    return 0;
+}
+
+int tank_view_players(const struct vector *view, struct vector *players) {
+    const struct tank_delta *tanks = vec_ref(view, 0);
+
+    for (size_t t = 0; t < vec_len(view); t++) {
+        if (t > 0 && tanks[t - 1].player_id == tanks[t].player_id)
+            continue;
+        if (vec_push(players, &tanks[t].player_id) < 0)
+            return -1;
+    }
+
+    return 0;
+}
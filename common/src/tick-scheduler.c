@@ -0,0 +1,105 @@
+#include "tick-scheduler.h"
+
+#include <string.h>
+#include <time.h>
+
+u64 tick_clock_now(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (u64)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+void make_tick_scheduler(struct tick_scheduler *sched,
+                         struct tick_config config, u64 now_ns) {
+    sched->config = config;
+    sched->deadline_ns = now_ns + config.period_ns;
+    sched->catch_up = 0;
+    tick_scheduler_take_stats(sched);
+}
+
+void tick_scheduler_begin(struct tick_scheduler *sched, u64 now_ns) {
+    // a timer never fires early, but a tick can be run by hand.
+    u64 jitter = now_ns > sched->deadline_ns ? now_ns - sched->deadline_ns : 0;
+
+    struct tick_stats *stats = &sched->stats;
+    if (stats->ticks == 0 || jitter < stats->jitter_min_ns)
+        stats->jitter_min_ns = jitter;
+    if (jitter > stats->jitter_max_ns)
+        stats->jitter_max_ns = jitter;
+
+    stats->jitter_total_ns += jitter;
+    stats->ticks++;
+}
+
+bool tick_scheduler_end(struct tick_scheduler *sched, u64 now_ns) {
+    u64 period = sched->config.period_ns;
+    sched->deadline_ns += period;
+
+    if (now_ns < sched->deadline_ns) {
+        sched->catch_up = 0;
+        return false;
+    }
+
+    // the tick ran past at least one deadline.
+    sched->stats.overruns++;
+    u64 missed = (now_ns - sched->deadline_ns) / period + 1;
+
+    switch (sched->config.policy) {
+    case TICK_OVERRUN_CATCH_UP:
+        // a scenario that can never keep up would otherwise hog its worker.
+        if (sched->catch_up < TICK_MAX_CATCH_UP) {
+            sched->catch_up++;
+
+            // only the most recent deadlines are caught up on.
+            if (missed > TICK_MAX_CATCH_UP) {
+                sched->deadline_ns += (missed - TICK_MAX_CATCH_UP) * period;
+                sched->stats.skipped += missed - TICK_MAX_CATCH_UP;
+            }
+
+            return true;
+        }
+
+        sched->catch_up = 0;
+        sched->deadline_ns += missed * period;
+        sched->stats.skipped += missed;
+        return false;
+
+    case TICK_OVERRUN_SLOW:
+        sched->deadline_ns = now_ns + period;
+        return false;
+
+    case TICK_OVERRUN_SKIP:
+    default:
+        sched->deadline_ns += missed * period;
+        sched->stats.skipped += missed;
+        return false;
+    }
+}
+
+struct tick_stats tick_scheduler_take_stats(struct tick_scheduler *sched) {
+    struct tick_stats stats = sched->stats;
+    sched->stats = (struct tick_stats) {0};
+    return stats;
+}
+
+const char *g_tick_overrun_policy_names[] = {
+    [TICK_OVERRUN_SKIP] = "skip",
+    [TICK_OVERRUN_CATCH_UP] = "catch-up",
+    [TICK_OVERRUN_SLOW] = "slow",
+};
+
+const char *tick_overrun_policy_name(enum tick_overrun_policy policy) {
+    return g_tick_overrun_policy_names[policy];
+}
+
+int tick_overrun_policy_parse(const char *name,
+                              enum tick_overrun_policy *policy) {
+    for (int p = TICK_OVERRUN_SKIP; p <= TICK_OVERRUN_SLOW; p++) {
+        if (strcmp(name, g_tick_overrun_policy_names[p]) == 0) {
+            *policy = p;
+            return 0;
+        }
+    }
+
+    return -1;
+}
@@ -2,10 +2,18 @@
 #include <stdlib.h>
 #include <string.h>
 #include <vector.h>
+#include <allocator.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 struct vector {
     void* data; 
+
+    /**
+     * where the vector and its data were allocated from.
+     */
+    struct allocator alloc;
+
     /**
      * the size of individual elements in the vector.
      */
@@ -23,33 +31,37 @@ struct vector {
      * The number of elements currently stored in the vector.
      */
     size_t len;
+
+    /**
+     * whether `vec_resize` zeroes the elements it adds.
+     */
+    bool zeroing;
 };
 
 IMPL_RESULT_TYPE_CUSTOM(vector *, vec)
 
 struct vector* make_vector(size_t elem_len, size_t size_hint) {
-    struct vector* vec = malloc(sizeof(struct vector));
+    return make_vector_in(&g_system_allocator, elem_len, size_hint);
+}
+
+struct vector* make_vector_in(const struct allocator *alloc, size_t elem_len,
+                              size_t size_hint) {
+    struct vector* vec = allocator_alloc(alloc, sizeof(struct vector));
     if (vec == NULL)
         return NULL;
 
-    if (size_hint > 0) {
-        vec->data = malloc(elem_len * size_hint);
-        vec->capacity = size_hint;
-    } else {
-        vec->data = malloc(elem_len * 10);
-        vec->capacity = 10;
-    }
+    vec->alloc = *alloc;
+    vec->capacity = size_hint > 0 ? size_hint : 10;
+    vec->data = allocator_alloc(alloc, elem_len * vec->capacity);
 
     if (vec->data == NULL) {
-        free(vec);
+        allocator_release(alloc, vec, sizeof(struct vector));
         return NULL;
     }
 
     vec->element_len = elem_len;
     vec->len = 0;
-
-    // initialize newly allocated memory
-    memset(vec->data, 0, vec->element_len * vec->capacity);
+    vec->zeroing = false;
 
     return vec;
 }
@@ -58,9 +70,11 @@ void free_vector(struct vector* vec) {
     if (vec == NULL)
         return;
 
-    free(vec->data);
+    // released last allocated first, so an arena can take both back.
+    struct allocator alloc = vec->alloc;
+    allocator_release(&alloc, vec->data, vec->element_len * vec->capacity);
     vec->data = NULL;
-    free(vec);
+    allocator_release(&alloc, vec, sizeof(struct vector));
 }
 
 void* vec_dat(struct vector* vec) {
@@ -92,21 +106,28 @@ size_t vec_element_len(const struct vector* vec) {
 }
 
 int vec_reserve(struct vector* vec, size_t n) {
-    if (vec->capacity > n)
+    if (vec->capacity >= n)
         return 0;
 
-    // reserve twice as much as requested, to reduce reallocs.
-    void *tmp = realloc(vec->data, vec->element_len * n*2);
+    if (n > SIZE_MAX / vec->element_len)
+        return -1;
+
+    // grow geometrically from the current capacity, so that pushing one
+    // element at a time reallocs O(log n) times.
+    size_t capacity = n;
+    if (vec->capacity <= SIZE_MAX / vec->element_len / 2 &&
+        vec->capacity * 2 > n)
+        capacity = vec->capacity * 2;
+
+    void *tmp = allocator_resize(&vec->alloc, vec->data,
+                                 vec->element_len * vec->capacity,
+                                 vec->element_len * capacity);
     if (tmp == NULL) {
         return -1;
     }
 
     vec->data = tmp;
-    vec->capacity = n*2;
-
-    // inialize newly allocated memory
-    void *data_start = vec_ref(vec, vec->len);
-    memset(data_start, 0, vec->element_len * (vec->capacity - vec->len));
+    vec->capacity = capacity;
 
     return 0;
 }
@@ -144,11 +165,31 @@ int vec_resize(struct vector* vec, size_t n) {
     int status = vec_reserve(vec, n);
     if (status != 0)
         return status;
+
+    if (vec->zeroing && n > vec->len)
+        memset(vec_ref(vec, vec->len), 0, (n - vec->len) * vec->element_len);
     
     vec->len = n;
     return 0;
 }
 
+void vec_set_zeroing(struct vector* vec, bool zeroing) {
+    vec->zeroing = zeroing;
+}
+
+void* vec_extend_uninit(struct vector* vec, size_t n) {
+    if (n > SIZE_MAX - vec->len || vec_reserve(vec, vec->len + n) != 0)
+        return NULL;
+
+    void *start = (uint8_t*)vec->data + vec->len * vec->element_len;
+    vec->len += n;
+    return start;
+}
+
+void* vec_push_uninit(struct vector* vec) {
+    return vec_extend_uninit(vec, 1);
+}
+
 int vec_pop(struct vector* vec, void* dst) {
     if (vec->len == 0)
         return -1;
@@ -0,0 +1,38 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+/* A lock-free queue with any number of producers, and a single consumer.
+
+   The queue is intrusive: each element embeds a `struct mpsc_node`, as its
+   first member, and the queue links the nodes together without allocating.
+   Pushing never blocks.  A pop can briefly see the queue as empty while a
+   push is halfway done, the element is popped by the next call.
+*/
+
+struct mpsc_node {
+    _Atomic(struct mpsc_node *) next;
+};
+
+struct mpsc_queue {
+    // producers push here.
+    _Atomic(struct mpsc_node *) head;
+
+    // the consumer pops from here.
+    struct mpsc_node *tail;
+
+    // always in the queue, so that it is never actually empty.
+    struct mpsc_node stub;
+};
+
+void mpsc_init(struct mpsc_queue *q);
+
+/** Safe to call from any thread. */
+void mpsc_push(struct mpsc_queue *q, struct mpsc_node *node);
+
+/** Returns NULL if the queue is empty.  Only the consumer may call this. */
+struct mpsc_node *mpsc_pop(struct mpsc_queue *q);
+
+#endif
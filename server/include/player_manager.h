@@ -2,9 +2,11 @@
 #define PLAYER_MANAGER_H
 
 #include <message.h>
+#include <server-connections.h>
 #include <stdbool.h>
 #include <sys/socket.h>
 
+/** A queue of fixed size elements, which grows when it is full. */
 struct ringbuffer {
     void* data;
     size_t elem_size;
@@ -13,12 +15,51 @@ struct ringbuffer {
     int write_head;
 };
 
-int make_ringbuffer(int len, size_t elem_size);
+int make_ringbuffer(struct ringbuffer *rb, int len, size_t elem_size);
 int free_ringbuffer(struct ringbuffer *rb);
 
 int ringbuffer_push(struct ringbuffer *rb, const void *item);
 int ringbuffer_pop(struct ringbuffer *rb, void *item);
 
+/** number of elements in the ringbuffer. */
+int ringbuffer_len(const struct ringbuffer *rb);
+
+/** returns the `n`th element from the read head, or NULL. */
+void *ringbuffer_ref(const struct ringbuffer *rb, int n);
+
+/** Outbound bytes queued above this are dropped, if they are only stale
+    scenario ticks. */
+#define PLAYER_OUTBOUND_HIGH_WATER_MARK (64 * 1024)
+
+/** A message waiting to be sent to a player. */
+struct outbound_message {
+    // NULL once the message has been dropped.
+    struct message_buffer *buffer;
+
+    // a newer message makes this one useless, so it can be dropped when the
+    // player falls behind.
+    bool droppable;
+};
+
+/** Messages waiting for a player's socket to become writable.  A slow client
+    can't accept a whole message at once, so the messages are kept until they
+    are completely sent, without blocking the server.
+*/
+struct outbound_queue {
+    struct ringbuffer messages; // struct outbound_message
+
+    // bytes of the oldest message that were already sent.
+    size_t sent;
+
+    // bytes in the queue that haven't been sent.
+    size_t queued_bytes;
+
+    size_t high_water_mark;
+
+    // droppable messages dropped so far.
+    u64 dropped;
+};
+
 enum player_state {
     STATE_DISCONNECTED,
     STATE_IDLE,
@@ -26,7 +67,12 @@ enum player_state {
     STATE_SCENARIO
 };
 
+struct scenario;
+struct scenario_delivery;
+struct scenario_recipient;
+
 struct player_manager {
+    struct connection_handle handle;
     int socket;
     socklen_t size;
     struct sockaddr address;
@@ -34,10 +80,53 @@ struct player_manager {
     enum player_state state;
     char username[50];
 
-    struct ringbuffer to_scenario;
+    // the scenario the player joined, while in STATE_SCENARIO, and the id
+    // its events are addressed by there.
+    struct scenario *scenario;
+    u32 member_id;
+
+    // negotiated while authenticating.  Text until then.
+    enum message_encoding encoding;
+
+    // the last tick queued for the player.  The player can only use a delta
+    // against it if every tick before it was queued too.
+    u32 last_tick;
+    bool tick_synced;
+    bool keyframe_requested;
+
+    struct outbound_queue outbound;
 };
 
 struct result_void make_player_manager(struct player_manager *p);
+void free_player_manager(struct player_manager *p);
+
+/** Queue a message for the player, and try to send it right away.  The queue
+    takes its own reference to `buffer`.
+
+    If the queue is over its high water mark, queued messages that are
+    `droppable` and haven't started sending are dropped.  If that isn't
+    enough, a `droppable` message is dropped instead of being queued.
+*/
+struct result_void player_queue_message(struct player_manager *p,
+                                        struct message_buffer *buffer,
+                                        bool droppable);
+
+/** Queue a tick from the player's scenario.  A delta the player can't apply,
+    because it missed the tick the delta is against, isn't queued, and the
+    scenario is asked for a keyframe instead. */
+struct result_void
+player_queue_tick(struct player_manager *p,
+                  const struct scenario_delivery *delivery,
+                  const struct scenario_recipient *recipient);
+
+/** Queue a status message for the player. */
+struct result_void player_queue_status(struct player_manager *p,
+                                       enum message_status status,
+                                       const char *brief);
+
+/** Send as much of the player's queue as the socket will accept without
+    blocking.  An error means the connection is unusable. */
+struct result_void player_flush(struct player_manager *p);
 void print_player(struct player_manager *p);
 
 // recieves player messages from the network, sends them to the
@@ -47,4 +136,8 @@ struct result_void player_idle_handler(struct player_manager *p, sexp *msg);
 struct result_void player_lobby_handler(struct player_manager *p, sexp *msg);
 struct result_void player_scenario_handler(struct player_manager *p, sexp *msg);
 
+/** Posts the player's departure to its scenario, and returns it to the
+    lobby. */
+struct result_void player_leave_scenario(struct player_manager *p);
+
 #endif
@@ -0,0 +1,74 @@
+#ifndef SERVER_CONNECTIONS_H
+#define SERVER_CONNECTIONS_H
+
+#include "error.h"
+#include "message.h"
+#include "nonstdint.h"
+#include "vector.h"
+
+/* Every client connected to the server is kept in a registry.  Slots of
+   clients that disconnected are reused, so a handle carries the generation
+   of its slot.  A handle to a client that has since disconnected no longer
+   matches its slot, and is rejected, even if the slot holds a new client.
+
+   The registry belongs to the reactor's thread, and isn't synchronized.
+*/
+
+struct player_manager;
+
+struct connection_handle {
+    u32 index;
+    u32 generation;
+};
+
+DECLARE_RESULT_TYPE_CUSTOM(struct connection_handle, connection_handle)
+
+struct connection {
+    // NULL while the slot is free.
+    struct player_manager *client;
+    struct message_reader *reader;
+
+    // incremented every time the slot is freed.
+    u32 generation;
+};
+
+struct connection_registry {
+    struct vector *slots;      // struct connection
+    struct vector *free_slots; // u32 index of each free slot
+
+    size_t len; // number of connected clients
+};
+
+struct result_void make_connection_registry(struct connection_registry *reg);
+
+/** Disconnects and frees every client. */
+void free_connection_registry(struct connection_registry *reg);
+
+/** Takes ownership of `client` and `reader`, reusing a free slot if there is
+    one. */
+struct result_connection_handle
+connection_registry_add(struct connection_registry *reg,
+                        struct player_manager *client,
+                        struct message_reader *reader);
+
+/** Returns NULL if the client behind `handle` has disconnected. */
+struct connection *connection_registry_get(const struct connection_registry *reg,
+                                           struct connection_handle handle);
+
+/** Frees the client and its reader, and frees the slot.  The socket is not
+    closed.  Does nothing if the handle is stale. */
+void connection_registry_remove(struct connection_registry *reg,
+                                struct connection_handle handle);
+
+/** Returns the handle of the `index`th slot, which may be free. */
+struct connection_handle
+connection_registry_handle(const struct connection_registry *reg, u32 index);
+
+/** Number of slots, free or not, for iterating over the connections. */
+size_t connection_registry_slots(const struct connection_registry *reg);
+
+/** A handle packed into 64 bits, like an epoll event's data. */
+u64 connection_handle_pack(struct connection_handle handle);
+struct connection_handle connection_handle_unpack(u64 packed);
+
+#endif
@@ -2,12 +2,26 @@
 #define SERVER_SCENARIO_H
 
 #include "scenario.h"
+#include "arena.h"
+#include "id-map.h"
+#include "message.h"
+#include "mpsc-queue.h"
+#include "server-connections.h"
+#include "spatial-grid.h"
+#include "tank-table.h"
+#include "tank-view.h"
+#include "thread-pool.h"
+#include "tick-scheduler.h"
 
 #include <player_manager.h>
 #include <vector.h>
 
-// the global scenario
-extern struct scenario g_scenario;
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+// every scenario hosted by the server.
+extern struct scenario_registry g_scenarios;
 
 enum SCENARIO_OBJECTIVES {
     DEFEND_POSITION,
@@ -20,47 +34,272 @@ struct scenario_map {
     int size_x, size_y;
 };
 
-#define TANKS_IN_SCENARIO 36
 /* struct actor { */
 /*     struct player_manager *player; */
 /*     enum SCENARIO_OBJECTIVES objective; */
 /*     struct tank tanks[TANKS_IN_SCENARIO]; */
 /* }; */
 
+#define SCENARIO_NAME_LEN 50
+
+/** A player in a scenario.  The player manager belongs to the reactor's
+    thread, so the scenario only keeps what it needs to address the player's
+    messages. */
+struct scenario_member {
+    struct connection_handle handle;
+    enum message_encoding encoding;
+    char username[50];
+
+    // unique within the scenario, and kept while the player is in it.  Events
+    // and ticks key the player by it, and later members have higher ids.
+    u32 id;
+
+    // set by a KEYFRAME event, until the player's next tick is sent.
+    bool wants_keyframe;
+};
+
+enum scenario_event_type {
+    SCENARIO_EVENT_JOIN,
+    SCENARIO_EVENT_LEAVE,
+    SCENARIO_EVENT_UPDATE,
+
+    // a player missed a tick, so its next tick is sent whole.
+    SCENARIO_EVENT_KEYFRAME,
+};
+
+/** A change to a scenario, posted by the reactor to the scenario's inbox.
+    Events are applied in order, at the start of the next tick. */
+struct scenario_event {
+    struct mpsc_node node;
+
+    enum scenario_event_type type;
+    u32 member_id; // handed out by the reactor, see `next_member_id`
+
+    // JOIN only.
+    struct connection_handle handle;
+    char username[50];
+    enum message_encoding encoding;
+
+    // UPDATE only.  Freed once the event is applied.
+    struct player_update update;
+};
+
+/** One member's message of a tick. */
+struct scenario_recipient {
+    struct scenario_member member;
+    struct message_buffer *msg; // NULL if it couldn't be written
+
+    // a delta is only any use to a player who was sent `base_tick`.
+    bool keyframe;
+    u32 base_tick;
+};
+
+/** A tick's messages, posted by a scenario to the reactor, which queues them
+    for each recipient that is still connected. */
+struct scenario_delivery {
+    struct mpsc_node node;
+
+    struct scenario *scene;
+    u32 tick_number;
+    struct vector *recipients; // struct scenario_recipient
+};
+
+/** Deliveries from every scenario.  `eventfd` becomes readable when there are
+    new deliveries. */
+struct scenario_outbox {
+    struct mpsc_queue deliveries;
+    int eventfd;
+};
+
+/** What the players see of a tick.  A snapshot isn't touched by the
+    simulation once it's written, so it can be sent while the next tick
+    runs. */
+struct scenario_snapshot {
+    int tick_number;
+    struct vector *members;   // struct scenario_member
+    struct vector *positions; // struct coord, indexed by tank id
+    struct vector *health;    // u32, indexed by tank id
+};
+
+/** What a member was last sent, which its next delta is made against. */
+struct scenario_view {
+    u32 member_id;
+    bool sent; // false until the member's first tick, and after a lost one
+    u32 tick_number;
+    u32 since_keyframe;
+
+    struct vector *tanks; // struct tank_delta, see tank_view_collect()
+};
+
+/** The scratch space of a broadcast.  The vectors are kept from one broadcast
+    to the next, and emptied for each member, so they only grow while the
+    scenario does. */
+struct scenario_broadcast_buffers {
+    struct tank_view_source src;
+    struct vector *scratch; // u32
+    struct vector *visible; // struct tank_delta
+    struct vector *named;   // u32, the ids of the players a tick names
+    struct scenario_tick tick;
+};
+
+/** every member is sent a keyframe at least this often, counted in ticks
+    that were broadcast. */
+#define SCENARIO_KEYFRAME_INTERVAL 32
+
 /* Scenario manager structure for now, objectives will be fixed and
    maps will be plain, (ie nonexistant)
 
+   A scenario is only ever ticked by one worker at a time.  Other threads don't
+   touch its players, they post events to its inbox instead.
  */
 struct scenario {
+    char name[SCENARIO_NAME_LEN];
+
     struct scenario_map map;
-    struct vector* players;
-    struct vector* player_managers;
-    float tick_rate;
+    struct vector* members; // struct scenario_member
+    struct id_map member_slots; // member id -> index in `members`
+
+    // the id of the next player to join.  Only touched by the reactor's
+    // thread, which posts the joins in order.
+    u32 next_member_id;
+
+    // the `p`th member's tanks have the ids p * TANKS_IN_SCENARIO up to
+    // (p + 1) * TANKS_IN_SCENARIO - 1.
+    struct tank_table tanks;
     int tick_number;
+
+    // when each tick is due.  Only touched by the thread running the tick.
+    struct tick_scheduler schedule;
+
+    // the tanks' positions, rebuilt every tick.
+    struct spatial_grid grid;
+
+    // runs the passes of a tick in parallel.
+    struct thread_pool *workers;
+
+    // the damage dealt in a tick, gathered into one array per thread slot of
+    // `workers`, and zeroed once it's applied.  Each array is indexed by
+    // tank id, and has room for `damage_capacity` tanks.
+    u32 **damage;
+    bool *damage_dealt; // whether each slot's array has any damage in it
+    u32 damage_capacity;
+
+    // readable once the next tick is due.
+    int timer;
+
+    // set while a tick is queued or running on a worker.
+    atomic_bool ticking;
+
+    struct mpsc_queue inbox; // struct scenario_event
+    struct scenario_outbox *outbox;
+
+    // a tick writes one snapshot while the other is broadcast on a worker.
+    // If a broadcast is still running when the next tick is done, that tick
+    // waits in `ready`, and a newer tick replaces it.  Guarded by
+    // `snapshot_lock`.
+    struct scenario_snapshot snapshots[2];
+    int sending; // index of the snapshot being broadcast, or -1
+    int ready;   // index of the snapshot to broadcast next, or -1
+    pthread_mutex_t snapshot_lock;
+
+    // each member is only sent the tanks it can see.  Only touched by the
+    // broadcast job.
+    struct vector *views;          // struct scenario_view, sorted by member id
+    struct spatial_grid view_grid; // the positions in the snapshot being sent
+    struct scenario_broadcast_buffers broadcast;
+
+    // what a broadcast needs only until it's done.  Reset at the start of
+    // each broadcast.
+    struct arena tick_arena;
 };
 
-int make_scenario(struct scenario *scene);
-int free_scenario(const struct scenario *scene);
+/** the tick arena's first block.  It grows to fit the largest broadcast. */
+#define SCENARIO_TICK_ARENA_SIZE 4096
+
+int make_scenario(struct scenario *scene, const char *name,
+                  struct tick_config tick_config,
+                  struct scenario_outbox *outbox,
+                  struct thread_pool *workers);
+int free_scenario(struct scenario *scene);
 
 /* Adds a new player to the scenario. The player will must choose
    an objective before it may begin the scenario.
 */
-int scenario_add_player(struct scenario *scene, struct player_manager *player);
-int scenario_rem_player(struct scenario *scene, struct player_manager *player);
+int scenario_add_player(struct scenario *scene,
+                        const struct scenario_member *member);
+int scenario_rem_player(struct scenario *scene, u32 member_id);
 
-struct player_data* scenario_find_player(struct scenario *scene,
-                                         struct player_manager *player);
+/** returns the index of the member with `member_id`, or -1. */
+ssize_t scenario_find_player(struct scenario *scene, u32 member_id);
+
+/** Copies `event` into the scenario's inbox.  Safe to call while the scenario
+    is ticking.  The inbox takes ownership of an UPDATE's vectors, even if
+    this fails. */
+struct result_void scenario_post_event(struct scenario *scene,
+                                       const struct scenario_event *event);
 
 /// Runs updates on everything in the scenario:
 ///  tank health
 ///  tank shooting
 ///  tank movement
+/// Large scenarios are split into chunks of SCENARIO_TICK_GRAIN tanks, which
+/// run on the scenario's workers.  The results don't depend on how many
+/// workers there are.
 int scenario_tick(struct scenario *scene);
 
-/// responsible for the timing and communication with players.
-/// returns 1 if nothing is done (not time for a scene update).
+#define SCENARIO_TICK_GRAIN 4096
+
+/// applies the events in the inbox, runs one tick, and snapshots it for the
+/// players.  The snapshot is serialized and posted to the outbox by another
+/// job, so the next tick doesn't wait on it.  The server calls this once per
+/// tick period.
 /// returns 0 if a scene update is done.
 /// returns -1 in the case of an error.
 int scenario_handler(struct scenario *scene);
 
+/********************************** REGISTRY **********************************/
+#define MAX_SCENARIOS 64
+
+/** 0.75 ticks a second. */
+#define SCENARIO_DEFAULT_TICK_PERIOD_NS 1333333333
+
+/** every scenario prints its tick jitter this often. */
+#define SCENARIO_TICK_STATS_INTERVAL 100
+
+/** Every scenario hosted by the server, and the workers that tick them.
+    Scenarios are created by the reactor's thread, and live until the server
+    stops. */
+struct scenario_registry {
+    struct vector *scenarios; // struct scenario *
+    struct tick_config tick_config; // for new scenarios
+    struct scenario_outbox outbox;
+    struct thread_pool workers;
+};
+
+struct result_void make_scenario_registry(struct scenario_registry *reg,
+                                          struct tick_config tick_config);
+
+/** Stops the workers, and frees every scenario and undelivered tick. */
+void free_scenario_registry(struct scenario_registry *reg);
+
+struct result_void scenario_registry_create(struct scenario_registry *reg,
+                                            const char *name);
+
+/** Returns NULL if there is no scenario named `name`. */
+struct scenario *scenario_registry_find(const struct scenario_registry *reg,
+                                        const char *name);
+
+size_t scenario_registry_len(const struct scenario_registry *reg);
+struct scenario *scenario_registry_at(const struct scenario_registry *reg,
+                                      size_t index);
+
+/** Queues a tick of the `index`th scenario on a worker, once its timer
+    fires.  If the last tick is still running, the scenario's overrun policy
+    handles the missed deadline instead. */
+void scenario_registry_tick(struct scenario_registry *reg, size_t index);
+
+/** Pops the next delivery, or returns NULL. */
+struct scenario_delivery *scenario_outbox_pop(struct scenario_outbox *outbox);
+void free_scenario_delivery(struct scenario_delivery *delivery);
+
 #endif
@@ -0,0 +1,58 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include "error.h"
+#include "vector.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+
+typedef void (thread_pool_fn)(void *arg);
+
+/** Runs over the items from `first` up to, but not including, `last`.  `slot`
+    is unique to the thread running it, and less than the pool's length plus
+    one, so it can index per thread state. */
+typedef void (thread_pool_range_fn)(void *arg, size_t first, size_t last,
+                                    size_t slot);
+
+struct thread_pool_job {
+    thread_pool_fn *fn;
+    void *arg;
+};
+
+/** A fixed number of worker threads, which run jobs in the order they were
+    submitted. */
+struct thread_pool {
+    pthread_t *threads;
+    size_t len;
+
+    pthread_mutex_t lock;
+    pthread_cond_t job_ready;
+    struct vector *jobs; // struct thread_pool_job, oldest first
+
+    bool stopping;
+};
+
+/** Starts `len` workers, or one per online CPU if `len` is 0. */
+struct result_void make_thread_pool(struct thread_pool *pool, size_t len);
+
+/** Runs the jobs that were already submitted, then joins the workers. */
+void free_thread_pool(struct thread_pool *pool);
+
+/** Queues `fn(arg)` to run on a worker.  Safe to call from any thread. */
+struct result_void thread_pool_submit(struct thread_pool *pool,
+                                      thread_pool_fn *fn, void *arg);
+
+/**
+ * Runs `fn` over the items from 0 up to `len`, split into chunks of `grain`
+ * items, and returns once every chunk has run.
+ *
+ * The calling thread runs chunks too, with slot 0, and workers join in once
+ * they are free.  So it is safe to call from a job: if every worker is busy,
+ * the caller runs every chunk itself.
+ */
+void thread_pool_parallel_for(struct thread_pool *pool, size_t len,
+                              size_t grain, thread_pool_range_fn *fn,
+                              void *arg);
+
+#endif
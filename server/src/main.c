@@ -1,10 +1,17 @@
+// for accept4.
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "error.h"
 #include "player_manager.h"
 #include "command-line.h"
 #include "server-commands.h"
+#include "server-connections.h"
 
 #include "scenario.h"
 #include "server-scenario.h"
+#include "tick-scheduler.h"
 #include "message.h"
 #include "sexp/sexp-base.h"
 
@@ -18,24 +25,40 @@
 #include <sys/socket.h>
 
 #include <pthread.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <unistd.h>
 
 bool g_run_server;
-extern struct scenario g_scenario;
 
-struct {
-    struct player_manager* client;
-    struct vector* msg_buf;
-} g_connections[50];
+struct connection_registry g_connections;
+struct scenario_registry g_scenarios;
+
+/*********************************** REACTOR **********************************/
+/* Every socket, every scenario's tick timer, and the scenarios' outbox are
+   watched by one epoll instance, so the server sleeps until there is something
+   to do.  An epoll event's data is the packed handle of its connection, or one
+   of these, which no connection slot can match.  A scenario's timer is packed
+   like a handle, with REACTOR_SCENARIO_TIMER as its index and the scenario's
+   index as its generation. */
+#define REACTOR_LISTENER UINT64_MAX
+#define REACTOR_OUTBOX (UINT64_MAX - 1)
+#define REACTOR_SCENARIO_TIMER (UINT32_MAX - 2)
 
-int g_connections_len;
+int g_epoll_fd;
 
-// TODO: should eventually support multiple scenarios
-struct scenario g_scenario;
+/** how long the listener is left alone after accepting fails. */
+#define REACTOR_ACCEPT_BACKOFF_NS 1000000000ull
 
-void *accept_connections_thread(void* port_num) {
+/** while accepting is backed off, when to start watching the listener again.
+    0 while it's watched. */
+u64 g_listener_paused_until;
+
+int make_listener(int port_num) {
     // create a socket
-    int sock = socket(PF_INET, SOCK_STREAM, 0);
+    int sock = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
     if (sock < 0) {
         perror("ERROR: failed to open network socket");
         exit(EXIT_FAILURE);
@@ -45,7 +68,7 @@ void *accept_connections_thread(void* port_num) {
     struct sockaddr_in name =
         { .sin_family = AF_INET,
           .sin_addr = {inet_addr("127.0.0.1")},
-          .sin_port = *(int*)port_num};
+          .sin_port = port_num};
 
     int status = bind(sock, (struct sockaddr*) &name, sizeof(name));
     if (status < 0) {
@@ -54,54 +77,136 @@ void *accept_connections_thread(void* port_num) {
     }
  
     // enable listening
-    listen(sock, 1);
-
-    // We don't want the accept function blocking us from checking
-    // `g_run_server`
-    fcntl(sock, F_SETFL, O_NONBLOCK);
-
-    g_connections_len = 0;
+    listen(sock, SOMAXCONN);
 
     printf("] server started on %s port %d\n",
            inet_ntoa(name.sin_addr), name.sin_port);
-    
-    while (g_run_server) {
+
+    return sock;
+}
+
+void reactor_watch(int fd, u32 events, u64 id, int op) {
+    struct epoll_event event = { .events = events, .data.u64 = id };
+    if (epoll_ctl(g_epoll_fd, op, fd, &event) < 0)
+        perror("ERROR: epoll_ctl failed");
+}
+
+/** only wait for a connection to become writable while it has queued bytes,
+    otherwise epoll would wake up for it constantly. */
+void reactor_update_interest(struct connection_handle handle) {
+    struct connection *c = connection_registry_get(&g_connections, handle);
+    if (c == NULL)
+        return;
+
+    u32 events = EPOLLIN;
+    if (ringbuffer_len(&c->client->outbound.messages) > 0)
+        events |= EPOLLOUT;
+
+    reactor_watch(c->client->socket, events, connection_handle_pack(handle),
+                  EPOLL_CTL_MOD);
+}
+
+void accept_connections(int listener) {
+    while (true) {
         struct sockaddr client_addr;
-        socklen_t client_size;
+        socklen_t client_size = sizeof(client_addr);
 
-        int client_fd = accept(sock, &client_addr, &client_size);
+        int client_fd = accept4(listener, &client_addr, &client_size,
+                                SOCK_NONBLOCK);
 
-        // check for errors
         if (client_fd == -1) {
-            continue;
+            // no more pending connections.
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return;
+
+            // the connection went away before it was accepted.
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+
+            // eg. out of file descriptors.  The connection is still pending,
+            // so the listener would be reported again straight away.  It isn't
+            // watched for a while, so the reactor doesn't spin.
+            perror("ERROR: failed to accept a connection");
+            reactor_watch(listener, 0, REACTOR_LISTENER, EPOLL_CTL_MOD);
+            g_listener_paused_until = tick_clock_now()
+                + REACTOR_ACCEPT_BACKOFF_NS;
+            return;
         }
 
-        // set the connection to nonblocking
-        fcntl(client_fd, F_SETFL, O_NONBLOCK);
-
         struct player_manager *new_player;
         new_player = malloc(sizeof(struct player_manager));
         if (new_player == NULL) {
             perror("ERROR! COULDN'T MALLOC FOR NEW CLIENT");
+            close(client_fd);
+            continue;
+        }
+
+        struct result_void r = make_player_manager(new_player);
+        if (r.status == RESULT_ERROR) {
+            char *err_msg = describe_error(r.error);
+            puts(err_msg);
+            free(err_msg);
+            free_error(r.error);
+            free(new_player);
+            close(client_fd);
             continue;
         }
 
         new_player->size = client_size;
         new_player->address = client_addr;
         new_player->socket = client_fd;
-        new_player->state = STATE_IDLE;
 
-        // FIXME: allocated memory never freed!
+        struct message_reader *reader = make_message_reader();
+        struct result_connection_handle handle = reader != NULL
+            ? connection_registry_add(&g_connections, new_player, reader)
+            : RESULT_MSG_ERROR(connection_handle, "failed to allocate reader");
+
+        if (handle.status == RESULT_ERROR) {
+            char *err_msg = describe_error(handle.error);
+            puts(err_msg);
+            free(err_msg);
+            free_error(handle.error);
+            free_message_reader(reader);
+            free_player_manager(new_player);
+            free(new_player);
+            close(client_fd);
+            continue;
+        }
+
+        new_player->handle = handle.ok;
+
         printf("recieved a new connection!\n");
-        g_connections[g_connections_len].client = new_player;
-        g_connections[g_connections_len].msg_buf = make_vector(sizeof(char), 10);
-        g_connections_len += 1;
+        reactor_watch(client_fd, EPOLLIN, connection_handle_pack(handle.ok),
+                      EPOLL_CTL_ADD);
     }
+}
 
-    shutdown(sock, SHUT_RDWR);
-    return NULL;
+void print_flush_error(struct result_void r) {
+    if (r.status == RESULT_ERROR) {
+        char *err_msg = describe_error(r.error);
+        puts(err_msg);
+        free(err_msg);
+        free_error(r.error);
+    }
 }
 
+/** stops watching a connection that hung up, takes it out of the scenario,
+    and frees it. */
+void disconnect_client(struct connection_handle handle) {
+    struct connection *c = connection_registry_get(&g_connections, handle);
+    if (c == NULL)
+        return;
+
+    struct player_manager *p = c->client;
+    printf("%s: disconnected\n", p->username);
+
+    if (p->state == STATE_SCENARIO)
+        print_flush_error(player_leave_scenario(p));
+
+    epoll_ctl(g_epoll_fd, EPOLL_CTL_DEL, p->socket, NULL);
+    close(p->socket);
+    connection_registry_remove(&g_connections, handle);
+}
 
 // BUG: there is a potential race condition here. If a client with the same
 // credentials attempts to enter the game while the old client is being handled,
@@ -109,21 +214,21 @@ void *accept_connections_thread(void* port_num) {
 
 /// top level client handling function that recieves all messages from the
 /// clients, and passes them to the appropriate handler (depends on the state of
-/// the client)
-void handle_client(struct player_manager* p, struct vector* msg_buf) {
-    struct result_sexp r = message_recv(p->socket, msg_buf);
+/// the client).  Returns false once there are no more messages to handle.
+bool handle_client(struct player_manager* p, struct message_reader* reader) {
+    struct result_sexp r = message_recv(p->socket, reader);
     if (r.status == RESULT_ERROR) {
         char *err_msg = describe_error(r.error);
         puts(err_msg);
         free(err_msg);
         free_error(r.error);
-        return;
+        return false;
     }         
     sexp *msg = r.ok;
 
     if (sexp_is_nil(msg)) {
         free_sexp(msg);
-        return;
+        return false;
     }
     
     print_player(p);
@@ -157,43 +262,160 @@ void handle_client(struct player_manager* p, struct vector* msg_buf) {
             puts(err_msg);
             free(err_msg);
             free_error(r.error);
-            return;
+            free_sexp(msg);
+            return true;
         }
         
         if (strcmp(r.ok, "kill-serv") == 0) {
             g_run_server = false;
         }
+
+        free(r.ok);
     }
 
     free_sexp(msg);
-    return;
+    return true;
 }
 
-// this function handles all requests from clients.
-void* client_request_thread(void *arg) {
-    (void)arg; // arg is unused.
-    
-    while (g_run_server) {     
-        // you will handle stuff here, like printing debug messages!
-        for (int i = 0; i < g_connections_len; i++) {
-            handle_client(g_connections[i].client,
-                          g_connections[i].msg_buf);
+/** number of scenarios whose timers are watched. */
+size_t g_watched_scenarios;
+
+/** watches the timers of the scenarios created since the last call. */
+void reactor_watch_scenarios(void) {
+    for (; g_watched_scenarios < scenario_registry_len(&g_scenarios);
+         g_watched_scenarios++) {
+        struct scenario *scene =
+            scenario_registry_at(&g_scenarios, g_watched_scenarios);
+        struct connection_handle id = {
+            .index = REACTOR_SCENARIO_TIMER,
+            .generation = g_watched_scenarios,
+        };
+
+        reactor_watch(scene->timer, EPOLLIN, connection_handle_pack(id),
+                      EPOLL_CTL_ADD);
+    }
+}
+
+/** handles a connection's events. */
+void reactor_handle_client(struct connection_handle handle, u32 events) {
+    struct connection *c = connection_registry_get(&g_connections, handle);
+
+    // the event is for a client that already disconnected.
+    if (c == NULL)
+        return;
+
+    if (events & EPOLLIN) {
+        // a read can bring in several messages.
+        while (handle_client(c->client, c->reader));
+
+        // the client may have created a scenario.
+        reactor_watch_scenarios();
+
+        if (c->reader->closed || (events & (EPOLLHUP | EPOLLERR))) {
+            disconnect_client(handle);
+            return;
+        }
+    }
+
+    print_flush_error(player_flush(c->client));
+    reactor_update_interest(handle);
+}
+
+/** queues the ticks the scenarios finished, for every recipient that is still
+    connected. */
+void reactor_handle_outbox(void) {
+    u64 count;
+    if (read(g_scenarios.outbox.eventfd, &count, sizeof(count)) < 0)
+        return;
+
+    struct scenario_delivery *delivery;
+    while ((delivery = scenario_outbox_pop(&g_scenarios.outbox)) != NULL) {
+        for (size_t i = 0; i < vec_len(delivery->recipients); i++) {
+            struct scenario_recipient *recipient =
+                vec_ref(delivery->recipients, i);
+            struct connection_handle handle = recipient->member.handle;
+
+            struct connection *c = connection_registry_get(&g_connections,
+                                                           handle);
+            if (c == NULL || recipient->msg == NULL)
+                continue;
+
+            print_flush_error(player_queue_tick(c->client, delivery,
+                                                recipient));
+            reactor_update_interest(handle);
+        }
+
+        free_scenario_delivery(delivery);
+    }
+}
+
+#define REACTOR_MAX_EVENTS 64
+
+/** handles every connection, and the scenario, until the server stops. */
+void run_reactor(int port_num) {
+    g_epoll_fd = epoll_create1(0);
+    if (g_epoll_fd < 0) {
+        perror("ERROR: failed to create epoll instance");
+        exit(EXIT_FAILURE);
+    }
+
+    struct result_void r = make_connection_registry(&g_connections);
+    if (r.status == RESULT_ERROR) {
+        char *err_msg = describe_error(r.error);
+        puts(err_msg);
+        exit(EXIT_FAILURE);
+    }
+
+    int listener = make_listener(port_num);
+
+    reactor_watch(listener, EPOLLIN, REACTOR_LISTENER, EPOLL_CTL_ADD);
+    reactor_watch(g_scenarios.outbox.eventfd, EPOLLIN, REACTOR_OUTBOX,
+                  EPOLL_CTL_ADD);
+    reactor_watch_scenarios();
+
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    while (g_run_server) {
+        // the timeout lets a "quit" from the command line stop the server
+        // between ticks.
+        int n = epoll_wait(g_epoll_fd, events, REACTOR_MAX_EVENTS, 250);
+
+        for (int i = 0; i < n; i++) {
+            u64 id = events[i].data.u64;
+
+            struct connection_handle handle = connection_handle_unpack(id);
+
+            if (id == REACTOR_LISTENER)
+                accept_connections(listener);
+            else if (id == REACTOR_OUTBOX)
+                reactor_handle_outbox();
+            else if (handle.index == REACTOR_SCENARIO_TIMER)
+                scenario_registry_tick(&g_scenarios, handle.generation);
+            else
+                reactor_handle_client(handle, events[i].events);
         }
 
-        /* TEMPORARY (probably) SCENE HANDLING */
-        scenario_handler(&g_scenario);
+        if (g_listener_paused_until != 0 &&
+            tick_clock_now() >= g_listener_paused_until) {
+            g_listener_paused_until = 0;
+            reactor_watch(listener, EPOLLIN, REACTOR_LISTENER, EPOLL_CTL_MOD);
+        }
     }
 
-    return NULL;
+    for (u32 i = 0; i < connection_registry_slots(&g_connections); i++)
+        disconnect_client(connection_registry_handle(&g_connections, i));
+    free_connection_registry(&g_connections);
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    close(g_epoll_fd);
 }
 
 char g_welcome_message[] = "\
 --Welcome to the Programable Tanks 2 server!--\n\
 \n\
 This server is a work in progress and currently manages multiple connected\n\
-clients, as well as a single scenario. Clients that implement this messaging\n\
-protocol may connect to the server, authenticate themselves, and then join the\n\
-scenario.\n\
+clients, and the scenarios they create. Clients that implement this messaging\n\
+protocol may connect to the server, authenticate themselves, and then create or\n\
+join a scenario.\n\
 \n\
 For debugging purposes, this program prints out all messages it receives from\n\
 connected clients, along with other miscellaneous information.\n\
@@ -204,38 +426,47 @@ This simulation is written and maintained by Ethan Smith.\n";
 
 int main(int argc, char** argv) {
     int port_num = 4444;
-    if (argc == 2)
+    if (argc >= 2)
         port_num = atoi(argv[1]);
+
+    // server-app [port] [tick period in ms] [skip | catch-up | slow]
+    struct tick_config tick_config = {
+        .period_ns = SCENARIO_DEFAULT_TICK_PERIOD_NS,
+        .policy = TICK_OVERRUN_SKIP,
+    };
+
+    if (argc >= 3 && atol(argv[2]) > 0)
+        tick_config.period_ns = atol(argv[2]) * 1000000ul;
+
+    if (argc >= 4 &&
+        tick_overrun_policy_parse(argv[3], &tick_config.policy) < 0) {
+        printf("unknown overrun policy %s, use skip, catch-up or slow\n",
+               argv[3]);
+        exit(EXIT_FAILURE);
+    }
     
-    make_scenario(&g_scenario);
+    struct result_void r = make_scenario_registry(&g_scenarios, tick_config);
+    if (r.status == RESULT_OK)
+        r = scenario_registry_create(&g_scenarios, "default");
+    if (r.status == RESULT_ERROR) {
+        char *err_msg = describe_error(r.error);
+        puts(err_msg);
+        exit(EXIT_FAILURE);
+    }
     
     puts(g_welcome_message);
 
-    // start networking thread
     g_run_server = true;
 
-    pthread_t network_thread_pid;
-    pthread_create(&network_thread_pid,
-                   NULL,
-                   &accept_connections_thread,
-                   &port_num);
-    
-    pthread_t client_thread_pid;
-    pthread_create(&client_thread_pid,
-                   NULL,
-                   &client_request_thread,
-                   NULL);
-
     pthread_t cmd_line_thread_pid;
     pthread_create(&cmd_line_thread_pid,
                    NULL,
                    &command_line_thread,
                    &server_command_line_args);
 
-    while (g_run_server);
+    run_reactor(port_num);
     pthread_join(cmd_line_thread_pid, NULL);
-    pthread_join(client_thread_pid, NULL);
-    pthread_join(network_thread_pid, NULL);
+    free_scenario_registry(&g_scenarios);
 
     printf("server exited successfully\n");
     return 0;
@@ -0,0 +1,56 @@
+#include "mpsc-queue.h"
+
+#include <stddef.h>
+
+void mpsc_init(struct mpsc_queue *q) {
+    atomic_store_explicit(&q->stub.next, NULL, memory_order_relaxed);
+    atomic_store_explicit(&q->head, &q->stub, memory_order_relaxed);
+    q->tail = &q->stub;
+}
+
+void mpsc_push(struct mpsc_queue *q, struct mpsc_node *node) {
+    atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+
+    // claim the head, then link the old head to the node.  Until the link is
+    // made, the consumer can't see this node, or any pushed after it.
+    struct mpsc_node *prev =
+        atomic_exchange_explicit(&q->head, node, memory_order_acq_rel);
+    atomic_store_explicit(&prev->next, node, memory_order_release);
+}
+
+struct mpsc_node *mpsc_pop(struct mpsc_queue *q) {
+    struct mpsc_node *tail = q->tail;
+    struct mpsc_node *next =
+        atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    // skip over the stub.
+    if (tail == &q->stub) {
+        if (next == NULL)
+            return NULL;
+
+        q->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    // a push is in progress, wait for it to link its node.
+    if (tail != atomic_load_explicit(&q->head, memory_order_acquire))
+        return NULL;
+
+    // tail is the last node.  Put the stub back behind it, so that it can be
+    // popped without leaving the queue without a node.
+    mpsc_push(q, &q->stub);
+
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != NULL) {
+        q->tail = next;
+        return tail;
+    }
+
+    return NULL;
+}
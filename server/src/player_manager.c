@@ -7,17 +7,312 @@
 #include "sexp/sexp-base.h"
 
 #include <player_manager.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/uio.h>
 
 
-extern struct scenario g_scenario;
+/********************************* RINGBUFFER *********************************/
+int make_ringbuffer(struct ringbuffer *rb, int len, size_t elem_size) {
+    // one slot is always empty, so that a full buffer isn't mistaken for an
+    // empty one.
+    rb->data = malloc((len + 1) * elem_size);
+    if (rb->data == NULL)
+        return -1;
+
+    rb->elem_size = elem_size;
+    rb->capacity = len + 1;
+    rb->read_head = 0;
+    rb->write_head = 0;
+
+    return 0;
+}
+
+int free_ringbuffer(struct ringbuffer *rb) {
+    free(rb->data);
+    rb->data = NULL;
+    rb->capacity = 0;
+    rb->read_head = 0;
+    rb->write_head = 0;
+
+    return 0;
+}
+
+int ringbuffer_len(const struct ringbuffer *rb) {
+    return (rb->write_head - rb->read_head + rb->capacity) % rb->capacity;
+}
+
+void *ringbuffer_ref(const struct ringbuffer *rb, int n) {
+    if (n < 0 || n >= ringbuffer_len(rb))
+        return NULL;
+
+    int index = (rb->read_head + n) % rb->capacity;
+    return (u8 *)rb->data + index * rb->elem_size;
+}
+
+/** doubles the capacity, moving the elements to the start of the buffer. */
+int ringbuffer_grow(struct ringbuffer *rb) {
+    int len = ringbuffer_len(rb);
+    int capacity = rb->capacity * 2;
+
+    u8 *data = malloc(capacity * rb->elem_size);
+    if (data == NULL)
+        return -1;
+
+    for (int i = 0; i < len; i++)
+        memcpy(data + i * rb->elem_size, ringbuffer_ref(rb, i), rb->elem_size);
+
+    free(rb->data);
+    rb->data = data;
+    rb->capacity = capacity;
+    rb->read_head = 0;
+    rb->write_head = len;
 
-int make_player(struct player_manager *p) {
-    (void)p; // we don't need to allocate anything currently.
     return 0;
 }
 
+int ringbuffer_push(struct ringbuffer *rb, const void *item) {
+    if (ringbuffer_len(rb) == rb->capacity - 1 && ringbuffer_grow(rb) < 0)
+        return -1;
+
+    memcpy((u8 *)rb->data + rb->write_head * rb->elem_size, item, rb->elem_size);
+    rb->write_head = (rb->write_head + 1) % rb->capacity;
+
+    return 0;
+}
+
+int ringbuffer_pop(struct ringbuffer *rb, void *item) {
+    if (ringbuffer_len(rb) == 0)
+        return -1;
+
+    if (item != NULL)
+        memcpy(item, ringbuffer_ref(rb, 0), rb->elem_size);
+
+    rb->read_head = (rb->read_head + 1) % rb->capacity;
+    return 0;
+}
+
+/******************************* PLAYER MANAGER *******************************/
+struct result_void make_player_manager(struct player_manager *p) {
+    p->state = STATE_IDLE;
+    p->encoding = MESSAGE_ENCODING_TEXT;
+    p->username[0] = '\0';
+    p->scenario = NULL;
+    p->member_id = 0;
+    p->last_tick = 0;
+    p->tick_synced = false;
+    p->keyframe_requested = false;
+
+    p->outbound.sent = 0;
+    p->outbound.dropped = 0;
+    p->outbound.queued_bytes = 0;
+    p->outbound.high_water_mark = PLAYER_OUTBOUND_HIGH_WATER_MARK;
+
+    if (make_ringbuffer(&p->outbound.messages, 16,
+                        sizeof(struct outbound_message)) < 0)
+        return RESULT_MSG_ERROR(void, "failed to allocate the outbound queue");
+
+    return result_void_ok(0);
+}
+
+void free_player_manager(struct player_manager *p) {
+    struct outbound_message msg;
+    while (ringbuffer_pop(&p->outbound.messages, &msg) == 0)
+        message_buffer_release(msg.buffer);
+
+    free_ringbuffer(&p->outbound.messages);
+}
+
+/** drops queued messages that are droppable and haven't started sending,
+    oldest first, until the queue is under its high water mark. */
+void outbound_drop_stale(struct outbound_queue *q) {
+    int len = ringbuffer_len(&q->messages);
+
+    // the oldest message may be partially sent already.
+    for (int i = q->sent > 0 ? 1 : 0;
+         i < len && q->queued_bytes > q->high_water_mark; i++) {
+        struct outbound_message *msg = ringbuffer_ref(&q->messages, i);
+        if (msg->buffer == NULL || msg->droppable == false)
+            continue;
+
+        q->queued_bytes -= vec_len(msg->buffer->bytes);
+        message_buffer_release(msg->buffer);
+        msg->buffer = NULL;
+        q->dropped++;
+    }
+}
+
+struct result_void player_queue_message(struct player_manager *p,
+                                        struct message_buffer *buffer,
+                                        bool droppable) {
+    struct outbound_queue *q = &p->outbound;
+    size_t length = vec_len(buffer->bytes);
+
+    if (droppable && q->queued_bytes + length > q->high_water_mark) {
+        q->queued_bytes += length;
+        outbound_drop_stale(q);
+        q->queued_bytes -= length;
+
+        // the player is too far behind, even without the old ticks.
+        if (q->queued_bytes + length > q->high_water_mark) {
+            q->dropped++;
+            return player_flush(p);
+        }
+    }
+
+    struct outbound_message msg = {
+        .buffer = message_buffer_retain(buffer),
+        .droppable = droppable,
+    };
+
+    if (ringbuffer_push(&q->messages, &msg) < 0) {
+        message_buffer_release(buffer);
+        return RESULT_MSG_ERROR(void, "failed to queue message");
+    }
+
+    q->queued_bytes += length;
+    return player_flush(p);
+}
+
+/** asks the player's scenario to send its next tick whole, unless that was
+    already asked for. */
+struct result_void player_request_keyframe(struct player_manager *p) {
+    if (p->keyframe_requested || p->scenario == NULL)
+        return result_void_ok(0);
+
+    struct scenario_event keyframe = {
+        .type = SCENARIO_EVENT_KEYFRAME,
+        .member_id = p->member_id,
+    };
+    RESULT_CALL(void, scenario_post_event(p->scenario, &keyframe));
+
+    p->keyframe_requested = true;
+    return result_void_ok(0);
+}
+
+struct result_void
+player_queue_tick(struct player_manager *p,
+                  const struct scenario_delivery *delivery,
+                  const struct scenario_recipient *recipient) {
+    // the player left the scenario since the tick.
+    if (p->scenario != delivery->scene)
+        return result_void_ok(0);
+
+    if (!recipient->keyframe &&
+        !(p->tick_synced && p->last_tick == recipient->base_tick))
+        return player_request_keyframe(p);
+
+    // a newer tick replaces this one, so it is dropped if the player falls
+    // behind.
+    u64 dropped = p->outbound.dropped;
+    struct result_void r = player_queue_message(p, recipient->msg, true);
+
+    // any dropped tick breaks the chain of deltas.
+    p->last_tick = delivery->tick_number;
+    p->tick_synced = p->outbound.dropped == dropped;
+    if (recipient->keyframe)
+        p->keyframe_requested = false;
+
+    if (!p->tick_synced) {
+        struct result_void request = player_request_keyframe(p);
+        if (r.status == RESULT_OK)
+            return request;
+        if (request.status == RESULT_ERROR)
+            free_error(request.error);
+    }
+
+    return r;
+}
+
+struct result_void player_queue_status(struct player_manager *p,
+                                       enum message_status status,
+                                       const char *brief) {
+    vector *bytes;
+    RESULT_UNWRAP(void, bytes, message_status_encode(status, brief, p->encoding));
+
+    struct message_buffer *buffer;
+    RESULT_UNWRAP(void, buffer, make_message_buffer(bytes));
+
+    struct result_void r = player_queue_message(p, buffer, false);
+    message_buffer_release(buffer);
+    return r;
+}
+
+/** at most this many messages are gathered into one sendmsg() call. */
+#define PLAYER_FLUSH_IOV_MAX 64
+
+struct result_void player_flush(struct player_manager *p) {
+    struct outbound_queue *q = &p->outbound;
+
+    while (ringbuffer_len(&q->messages) > 0) {
+        // gather the queued messages, skipping the dropped ones.
+        struct iovec iov[PLAYER_FLUSH_IOV_MAX];
+        int iov_len = 0;
+        size_t offset = q->sent;
+
+        for (int i = 0; i < ringbuffer_len(&q->messages) &&
+                 iov_len < PLAYER_FLUSH_IOV_MAX; i++) {
+            struct outbound_message *msg = ringbuffer_ref(&q->messages, i);
+            if (msg->buffer == NULL)
+                continue;
+
+            vector *bytes = msg->buffer->bytes;
+            iov[iov_len++] = (struct iovec) {
+                .iov_base = vec_byte_ref(bytes, offset),
+                .iov_len = vec_len(bytes) - offset,
+            };
+            offset = 0;
+        }
+
+        size_t gathered = 0;
+        for (int i = 0; i < iov_len; i++)
+            gathered += iov[i].iov_len;
+
+        ssize_t sent = 0;
+        if (iov_len > 0) {
+            struct msghdr header = { .msg_iov = iov, .msg_iovlen = iov_len };
+            sent = sendmsg(p->socket, &header, MSG_NOSIGNAL | MSG_DONTWAIT);
+        }
+
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+                return result_void_ok(0);
+
+            return RESULT_MSG_ERROR(void, "failed to send to %s: %s",
+                                    p->username, strerror(errno));
+        }
+
+        q->queued_bytes -= sent;
+        bool socket_full = (size_t)sent < gathered;
+
+        // pop every message that was completely sent.
+        struct outbound_message *msg;
+        while ((msg = ringbuffer_ref(&q->messages, 0)) != NULL) {
+            size_t left = msg->buffer != NULL
+                ? vec_len(msg->buffer->bytes) - q->sent
+                : 0;
+
+            if ((size_t)sent < left) {
+                q->sent += sent;
+                break;
+            }
+
+            sent -= left;
+            q->sent = 0;
+            message_buffer_release(msg->buffer);
+            ringbuffer_pop(&q->messages, NULL);
+        }
+
+        if (socket_full)
+            return result_void_ok(0);
+    }
+
+    return result_void_ok(0);
+}
+
+
 struct result_void player_idle_handler(struct player_manager *p, sexp *msg) {
     switch (message_get_type(msg)) {
     case MSG_REQUEST_AUTHENTICATE: {
@@ -27,6 +322,7 @@ struct result_void player_idle_handler(struct player_manager *p, sexp *msg) {
         
         strcpy(p->username, vec_dat(user_credentials.username));
         p->state = STATE_LOBBY; // FIXME: no authentication done here!
+        p->encoding = user_credentials.encoding;
         printf("%s: authenticated\n", p->username);
         printf("%s: authenticated (msg data)\n",
                (char*)vec_dat(user_credentials.username));
@@ -38,15 +334,15 @@ struct result_void player_idle_handler(struct player_manager *p, sexp *msg) {
             if (ret < 0)
                 return RESULT_MSG_ERROR(void, "Name was too large for the buffer");
 
-            struct result_s32 r =
-                message_status_send(p->socket, MESSAGE_STATUS_SUCCESS, NULL);
+            struct result_void r =
+                player_queue_status(p, MESSAGE_STATUS_SUCCESS, NULL);
             if (r.status == RESULT_ERROR) return result_void_error(r.error);
         }
 
         break;
     }
     default: {
-        struct result_s32 r = message_status_send(p->socket, MESSAGE_STATUS_FAIL,
+        struct result_void r = player_queue_status(p, MESSAGE_STATUS_FAIL,
                             "you must be authenticated first");
         if (r.status == RESULT_ERROR) return result_void_error(r.error);
         break;
@@ -56,27 +352,99 @@ struct result_void player_idle_handler(struct player_manager *p, sexp *msg) {
     return result_void_ok(0);
 }
 
+/** replies with the name of every scenario. */
+struct result_void player_list_scenarios(struct player_manager *p) {
+    struct vector *names = make_vector(sizeof(char), 64);
+    if (names == NULL)
+        return RESULT_MSG_ERROR(void, "failed to allocate scenario list");
+
+    const char header[] = "scenarios:";
+    vec_pushn(names, header, strlen(header));
+
+    for (size_t i = 0; i < scenario_registry_len(&g_scenarios); i++) {
+        const char *name = scenario_registry_at(&g_scenarios, i)->name;
+        vec_push(names, " ");
+        vec_pushn(names, name, strlen(name));
+    }
+    vec_push(names, "");
+
+    struct result_void r = player_queue_status(p, MESSAGE_STATUS_SUCCESS,
+                                               vec_dat(names));
+    free_vector(names);
+    return r;
+}
+
+struct result_void player_create_scenario(struct player_manager *p, sexp *msg) {
+    char *name;
+    RESULT_UNWRAP(void, name, unwrap_scenario_name_message(msg));
+
+    struct result_void created = scenario_registry_create(&g_scenarios, name);
+    free(name);
+
+    if (created.status == RESULT_ERROR) {
+        char *description = describe_error(created.error);
+        free_error(created.error);
+
+        struct result_void r =
+            player_queue_status(p, MESSAGE_STATUS_FAIL, description);
+        free(description);
+        return r;
+    }
+
+    return player_queue_status(p, MESSAGE_STATUS_SUCCESS, "scenario created");
+}
+
+struct result_void player_join_scenario(struct player_manager *p, sexp *msg) {
+    char *name;
+    RESULT_UNWRAP(void, name, unwrap_scenario_name_message(msg));
+
+    struct scenario *scene = scenario_registry_find(&g_scenarios, name);
+    free(name);
+
+    if (scene == NULL)
+        return player_queue_status(p, MESSAGE_STATUS_FAIL,
+                                   "no scenario by that name");
+
+    // the reactor hands out the ids, so later events can be addressed
+    // before the join is applied.
+    struct scenario_event join = {
+        .type = SCENARIO_EVENT_JOIN,
+        .member_id = scene->next_member_id++,
+        .handle = p->handle,
+        .encoding = p->encoding,
+    };
+    strcpy(join.username, p->username);
+
+    RESULT_CALL(void, scenario_post_event(scene, &join));
+
+    p->state = STATE_SCENARIO;
+    p->scenario = scene;
+    p->member_id = join.member_id;
+
+    // the first tick from the scenario is a keyframe.
+    p->tick_synced = false;
+    p->keyframe_requested = false;
+
+    return player_queue_status(p, MESSAGE_STATUS_SUCCESS,
+                               "entering scenario...");
+}
+
 struct result_void player_lobby_handler(struct player_manager *p, sexp *msg) {
-    struct result_s32 r;
+    struct result_void r = result_void_ok(0);
     
     switch (message_get_type(msg)) {
     case MSG_REQUEST_LIST_SCENARIOS:
-        r = message_status_send(p->socket, MESSAGE_STATUS_SUCCESS,
-                                "There is only one scenario (0)");
+        r = player_list_scenarios(p);
         break;
     case MSG_REQUEST_CREATE_SCENARIO:
+        r = player_create_scenario(p, msg);
         break;
         
     case MSG_REQUEST_JOIN_SCENARIO:
-        p->state = STATE_SCENARIO;
-
-        scenario_add_player(&g_scenario, p);
-
-        r = message_status_send(p->socket, MESSAGE_STATUS_SUCCESS,
-                                "entering scenario...");
+        r = player_join_scenario(p, msg);
         break;
     default:
-        r = message_status_send(p->socket, MESSAGE_STATUS_INVALID_MESSAGE,
+        r = player_queue_status(p, MESSAGE_STATUS_INVALID_MESSAGE,
                           "not supported in lobby.");
         break;
     }
@@ -87,8 +455,21 @@ struct result_void player_lobby_handler(struct player_manager *p, sexp *msg) {
         return result_void_ok(0);
 }
 
+struct result_void player_leave_scenario(struct player_manager *p) {
+    struct scenario_event leave = {
+        .type = SCENARIO_EVENT_LEAVE,
+        .member_id = p->member_id,
+    };
+
+    struct result_void r = scenario_post_event(p->scenario, &leave);
+
+    p->state = STATE_LOBBY;
+    p->scenario = NULL;
+    return r;
+}
+
 struct result_void player_scenario_handler(struct player_manager *p, sexp *msg) {
-    struct result_s32 r;
+    struct result_void r = result_void_ok(0);
     switch (message_get_type(msg)) {
     case MSG_REQUEST_RETURN_TO_LOBBY:
         // FIXME: there should be some limitations on when a player can exit a
@@ -96,60 +477,33 @@ struct result_void player_scenario_handler(struct player_manager *p, sexp *msg)
         // battle. At the very least, some logging should be done to track bad
         // behavior.
         
-        p->state = STATE_LOBBY;
-        scenario_rem_player(&g_scenario, p);
-
-        // TODO: remove player from global scenario.
+        RESULT_CALL(void, player_leave_scenario(p));
         
-        r = message_status_send(p->socket, MESSAGE_STATUS_SUCCESS,
+        r = player_queue_status(p, MESSAGE_STATUS_SUCCESS,
                                 "returning to lobby...");
         break;
         
     case MSG_REQUEST_PLAYER_UPDATE: {
-        // FIXME: probably should handle validation code in the scenario module,
-        // but this will have to do for now.
-
-        // ensure the client doesn't try to update more tanks than actually
-        // exist.
-        struct player_update body;
-        RESULT_UNWRAP(void, body, unwrap_player_update_message(msg));
-        
-        int num_tanks = vec_len(body.tank_instructions);
-        if (TANKS_IN_SCENARIO < num_tanks)
-            num_tanks = TANKS_IN_SCENARIO;
-
-        for (int t = 0; t < num_tanks; t++) {
-            struct player_data* player = scenario_find_player(&g_scenario, p);
-
-            struct coord target;
-            enum tank_command command;
-            
-            vec_at(body.tank_target_coords, t, &target);
-            vec_at(body.tank_instructions, t, &command);           
-
-            struct tank* tank = vec_ref(player->tanks, t);
-
-            if (command == TANK_MOVE)
-                tank->move_to = target;
-            else if (command == TANK_FIRE)
-                tank->aim_at = target;
-
-            tank->cmd = command;
-        }
-        
+        // the scenario validates and applies the update on its next tick.
+        struct scenario_event update = {
+            .type = SCENARIO_EVENT_UPDATE,
+            .member_id = p->member_id,
+        };
+        RESULT_UNWRAP(void, update.update, unwrap_player_update_message(msg));
+        RESULT_CALL(void, scenario_post_event(p->scenario, &update));
         
-        r = message_status_send(p->socket, MESSAGE_STATUS_SUCCESS,
+        r = player_queue_status(p, MESSAGE_STATUS_SUCCESS,
                                 "updated successfully");
         break;
     }
     case MSG_REQUEST_DEBUG:
-        r = message_status_send(p->socket, MESSAGE_STATUS_FAIL,
+        r = player_queue_status(p, MESSAGE_STATUS_FAIL,
                                 "not implemented");
         break;
 
         
     default:
-        r = message_status_send(p->socket, MESSAGE_STATUS_INVALID_MESSAGE,
+        r = player_queue_status(p, MESSAGE_STATUS_INVALID_MESSAGE,
                                 "command not supported in scenario.");
         break;
 
@@ -0,0 +1,112 @@
+#include "server-connections.h"
+#include "error.h"
+#include "message.h"
+#include "player_manager.h"
+#include "vector.h"
+
+#include <stdlib.h>
+
+IMPL_RESULT_TYPE_CUSTOM(struct connection_handle, connection_handle)
+
+struct result_void make_connection_registry(struct connection_registry *reg) {
+    reg->slots = make_vector(sizeof(struct connection), 64);
+    reg->free_slots = make_vector(sizeof(u32), 64);
+    reg->len = 0;
+
+    if (reg->slots == NULL || reg->free_slots == NULL) {
+        free_vector(reg->slots);
+        free_vector(reg->free_slots);
+        return RESULT_MSG_ERROR(void, "failed to allocate connection registry");
+    }
+
+    return result_void_ok(0);
+}
+
+void free_connection_registry(struct connection_registry *reg) {
+    for (u32 i = 0; i < vec_len(reg->slots); i++)
+        connection_registry_remove(reg, connection_registry_handle(reg, i));
+
+    free_vector(reg->slots);
+    free_vector(reg->free_slots);
+}
+
+struct result_connection_handle
+connection_registry_add(struct connection_registry *reg,
+                        struct player_manager *client,
+                        struct message_reader *reader) {
+    u32 index;
+    if (vec_pop(reg->free_slots, &index) < 0) {
+        struct connection empty = { .client = NULL, .generation = 0 };
+        if (vec_push(reg->slots, &empty) < 0)
+            return RESULT_MSG_ERROR(connection_handle,
+                                    "failed to grow connection registry");
+
+        index = vec_len(reg->slots) - 1;
+    }
+
+    struct connection *slot = vec_ref(reg->slots, index);
+    slot->client = client;
+    slot->reader = reader;
+    reg->len++;
+
+    return result_connection_handle_ok((struct connection_handle) {
+            .index = index,
+            .generation = slot->generation,
+        });
+}
+
+struct connection *connection_registry_get(const struct connection_registry *reg,
+                                           struct connection_handle handle) {
+    if (handle.index >= vec_len(reg->slots))
+        return NULL;
+
+    struct connection *slot = vec_ref(reg->slots, handle.index);
+    if (slot->client == NULL || slot->generation != handle.generation)
+        return NULL;
+
+    return slot;
+}
+
+void connection_registry_remove(struct connection_registry *reg,
+                                struct connection_handle handle) {
+    struct connection *slot = connection_registry_get(reg, handle);
+    if (slot == NULL)
+        return;
+
+    free_player_manager(slot->client);
+    free(slot->client);
+    free_message_reader(slot->reader);
+
+    slot->client = NULL;
+    slot->reader = NULL;
+    slot->generation++;
+    reg->len--;
+
+    // if the free list can't grow, the slot is simply never reused.
+    vec_push(reg->free_slots, &handle.index);
+}
+
+struct connection_handle
+connection_registry_handle(const struct connection_registry *reg, u32 index) {
+    const struct connection *slot = vec_ref(reg->slots, index);
+
+    return (struct connection_handle) {
+        .index = index,
+        .generation = slot->generation,
+    };
+}
+
+size_t connection_registry_slots(const struct connection_registry *reg) {
+    return vec_len(reg->slots);
+}
+
+u64 connection_handle_pack(struct connection_handle handle) {
+    return ((u64)handle.generation << 32) | handle.index;
+}
+
+struct connection_handle connection_handle_unpack(u64 packed) {
+    return (struct connection_handle) {
+        .index = packed & 0xffffffff,
+        .generation = packed >> 32,
+    };
+}
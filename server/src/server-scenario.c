@@ -1,163 +1,457 @@
 #include "scenario.h"
 #include "server-scenario.h"
+#include "id-map.h"
 #include "message.h"
+#include "spatial-grid.h"
+#include "tank-table.h"
+#include "tank-view.h"
+#include "tick-scheduler.h"
 #include "vector.h"
 
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <stddef.h>
+#include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <stdio.h>
 #include <time.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
 
-int make_scenario(struct scenario *scene) {
-    scene->players = make_vector(sizeof(struct player_data), 10);
-    
-    if (scene->players == NULL) {
+/** sets the timer to fire once, at the scheduler's deadline. */
+void scenario_arm_timer(int timer, u64 deadline_ns) {
+    struct itimerspec spec = {
+        .it_value = {
+            .tv_sec = deadline_ns / 1000000000,
+            .tv_nsec = deadline_ns % 1000000000,
+        },
+    };
+
+    if (timerfd_settime(timer, TFD_TIMER_ABSTIME, &spec, NULL) < 0)
+        perror("ERROR: failed to arm the tick timer");
+}
+
+void free_scenario_snapshot(struct scenario_snapshot *snap) {
+    free_vector(snap->members);
+    free_vector(snap->positions);
+    free_vector(snap->health);
+}
+
+int make_scenario_snapshot(struct scenario_snapshot *snap) {
+    snap->tick_number = 0;
+    snap->members = make_vector(sizeof(struct scenario_member), 10);
+    snap->positions = make_vector(sizeof(struct coord),
+                                  10 * TANKS_IN_SCENARIO);
+    snap->health = make_vector(sizeof(u32), 10 * TANKS_IN_SCENARIO);
+
+    if (snap->members == NULL || snap->positions == NULL ||
+        snap->health == NULL) {
+        free_scenario_snapshot(snap);
         return -1;
     }
 
-    scene->player_managers = make_vector(sizeof(struct player_manager), 10);
-    if  (scene->player_managers == NULL) {
+    return 0;
+}
+
+void free_scenario_broadcast_buffers(struct scenario_broadcast_buffers *buf) {
+    free_vector(buf->scratch);
+    free_vector(buf->visible);
+    free_vector(buf->named);
+    free_vector(buf->tick.players);
+    free_vector(buf->tick.changes);
+    free_vector(buf->tick.removals);
+}
+
+int make_scenario_broadcast_buffers(struct scenario_broadcast_buffers *buf) {
+    *buf = (struct scenario_broadcast_buffers) {
+        .scratch = make_vector(sizeof(u32), TANKS_IN_SCENARIO * 4),
+        .visible = make_vector(sizeof(struct tank_delta), TANKS_IN_SCENARIO),
+        .named = make_vector(sizeof(u32), 10),
+        .tick = {
+            .players = make_vector(sizeof(struct tick_player), 10),
+            .changes = make_vector(sizeof(struct tank_delta),
+                                   TANKS_IN_SCENARIO),
+            .removals = make_vector(sizeof(struct tank_key), 10),
+        },
+    };
+
+    if (buf->scratch == NULL || buf->visible == NULL || buf->named == NULL ||
+        buf->tick.players == NULL || buf->tick.changes == NULL ||
+        buf->tick.removals == NULL) {
+        free_scenario_broadcast_buffers(buf);
         return -1;
     }
 
-    scene->tick_rate = 0.75;
+    return 0;
+}
+
+int make_scenario(struct scenario *scene, const char *name,
+                  struct tick_config tick_config,
+                  struct scenario_outbox *outbox,
+                  struct thread_pool *workers) {
+    snprintf(scene->name, SCENARIO_NAME_LEN, "%s", name);
+
+    scene->members = make_vector(sizeof(struct scenario_member), 10);
+    if  (scene->members == NULL) {
+        return -1;
+    }
+
+    struct result_void r = make_id_map(&scene->member_slots);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        free_vector(scene->members);
+        return -1;
+    }
+
+    scene->next_member_id = 0;
     scene->tick_number = 0;
+
+    scene->timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+    if (scene->timer < 0)
+        goto free_member_slots;
+
+    make_tick_scheduler(&scene->schedule, tick_config, tick_clock_now());
+    scenario_arm_timer(scene->timer, scene->schedule.deadline_ns);
+
+    r = make_spatial_grid(&scene->grid, TANK_FIRE_DISTANCE);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        goto close_timer;
+    }
+
+    // slot 0 is the thread running the tick.
+    size_t slots = workers->len + 1;
+    scene->workers = workers;
+    scene->damage = calloc(slots, sizeof(u32 *));
+    scene->damage_dealt = calloc(slots, sizeof(bool));
+    scene->damage_capacity = 0;
+    if (scene->damage == NULL || scene->damage_dealt == NULL)
+        goto free_damage;
+
+    scene->views = make_vector(sizeof(struct scenario_view), 10);
+    if (scene->views == NULL)
+        goto free_damage;
+
+    r = make_spatial_grid(&scene->view_grid, TANK_SENSOR_RANGE);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        goto free_views;
+    }
+
+    if (make_scenario_broadcast_buffers(&scene->broadcast) < 0)
+        goto free_view_grid;
+
+    r = make_arena(&scene->tick_arena, SCENARIO_TICK_ARENA_SIZE);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        goto free_broadcast_buffers;
+    }
+
+    if (make_scenario_snapshot(&scene->snapshots[0]) < 0) {
+        goto free_tick_arena;
+    } else if (make_scenario_snapshot(&scene->snapshots[1]) < 0) {
+        free_scenario_snapshot(&scene->snapshots[0]);
+        goto free_tick_arena;
+    }
+
+    scene->sending = -1;
+    scene->ready = -1;
+    pthread_mutex_init(&scene->snapshot_lock, NULL);
+
+    make_tank_table(&scene->tanks);
+    atomic_init(&scene->ticking, false);
+    mpsc_init(&scene->inbox);
+    scene->outbox = outbox;
     
     return 0;
+
+ free_tick_arena:
+    free_arena(&scene->tick_arena);
+ free_broadcast_buffers:
+    free_scenario_broadcast_buffers(&scene->broadcast);
+ free_view_grid:
+    free_spatial_grid(&scene->view_grid);
+ free_views:
+    free_vector(scene->views);
+ free_damage:
+    free(scene->damage);
+    free(scene->damage_dealt);
+    free_spatial_grid(&scene->grid);
+ close_timer:
+    close(scene->timer);
+ free_member_slots:
+    free_id_map(&scene->member_slots);
+    free_vector(scene->members);
+    return -1;
+}
+
+void free_scenario_event(struct scenario_event *event) {
+    if (event->type == SCENARIO_EVENT_UPDATE) {
+        free_vector(event->update.tank_target_coords);
+        free_vector(event->update.tank_instructions);
+    }
+
+    free(event);
 }
 
-int scenario_add_player(struct scenario* scene, struct player_manager* player) {
-    struct player_data player_data = make_player_data();
-    vec_pushn(player_data.username, player->username, strlen(player->username));
+int free_scenario(struct scenario *scene) {
+    close(scene->timer);
+
+    struct mpsc_node *node;
+    while ((node = mpsc_pop(&scene->inbox)) != NULL)
+        free_scenario_event((struct scenario_event *)node);
+
+    free_vector(scene->members);
+    free_id_map(&scene->member_slots);
+    free_tank_table(&scene->tanks);
+    free_spatial_grid(&scene->grid);
+
+    for (size_t slot = 0; slot <= scene->workers->len; slot++)
+        free(scene->damage[slot]);
+    free(scene->damage);
+    free(scene->damage_dealt);
 
+    free_scenario_snapshot(&scene->snapshots[0]);
+    free_scenario_snapshot(&scene->snapshots[1]);
+    pthread_mutex_destroy(&scene->snapshot_lock);
+
+    for (size_t v = 0; v < vec_len(scene->views); v++)
+        free_vector(((struct scenario_view *)vec_ref(scene->views, v))->tanks);
+    free_vector(scene->views);
+    free_spatial_grid(&scene->view_grid);
+    free_scenario_broadcast_buffers(&scene->broadcast);
+    free_arena(&scene->tick_arena);
+    return 0;
+}
+
+int scenario_add_player(struct scenario* scene,
+                        const struct scenario_member *member) {
     struct tank default_tank = {0};
     
     for (int i = 0; i < TANKS_IN_SCENARIO; i++) {
-        vec_push(player_data.tanks, &default_tank);
+        struct result_void r = tank_table_push(&scene->tanks, &default_tank);
+        if (r.status == RESULT_ERROR) {
+            free_error(r.error);
+            tank_table_remove(&scene->tanks, scene->tanks.len - i, i);
+            return -1;
+        }
+
         default_tank.pos.x += 2;
     }
  
-    vec_push(scene->players, &player_data);
-    vec_push(scene->player_managers, &player);
+    struct result_void r = id_map_set(&scene->member_slots, member->id,
+                                      vec_len(scene->members));
+    if (r.status == RESULT_ERROR || vec_push(scene->members, member) < 0) {
+        if (r.status == RESULT_ERROR)
+            free_error(r.error);
+        else
+            id_map_remove(&scene->member_slots, member->id);
+
+        tank_table_remove(&scene->tanks,
+                          scene->tanks.len - TANKS_IN_SCENARIO,
+                          TANKS_IN_SCENARIO);
+        return -1;
+    }
     
     return 0;
 }
 
-int scenario_rem_player(struct scenario *scene, struct player_manager *player) {
-    size_t player_idx;
-
-    // find the actor corresponding to player.
-    for (player_idx = 0; player_idx < vec_len(scene->players); player_idx++) {
-        struct player_data* pd = vec_ref(scene->players, player_idx);
-        
-        if (strcmp(player->username, vec_dat(pd->username)) != 0)
-            continue; // this isn't the player, keep looking.
+ssize_t scenario_find_player(struct scenario *scene, u32 member_id) {
+    u32 slot = id_map_get(&scene->member_slots, member_id);
+    return slot == ID_MAP_NONE ? -1 : (ssize_t)slot;
+}
 
-        // found the player!
-        vec_rem(scene->players, player_idx);
-        vec_rem(scene->player_managers, player_idx);
-        return 0;
-    }
+int scenario_rem_player(struct scenario *scene, u32 member_id) {
+    ssize_t player_idx = scenario_find_player(scene, member_id);
 
     // the player wasn't in this scene...
-    return -1;
-}
+    if (player_idx < 0)
+        return -1;
 
-struct player_data* scenario_find_player(struct scenario *scene,
-                                   struct player_manager *player) {
-    // find the actor corresponding to player.
-    for (size_t player_idx = 0; player_idx < vec_len(scene->players); player_idx++) {
-        struct player_data* pd = vec_ref(scene->players, player_idx);
+    tank_table_remove(&scene->tanks, player_idx * TANKS_IN_SCENARIO,
+                      TANKS_IN_SCENARIO);
+    vec_rem(scene->members, player_idx);
+    id_map_remove(&scene->member_slots, member_id);
 
-        if (strcmp(player->username, vec_dat(pd->username)) != 0)
-            continue; // this isn't the player, keep looking.
+    // the members after it moved down a slot.  Leaving is rare next to
+    // updates, which only look the slot up.
+    for (size_t m = player_idx; m < vec_len(scene->members); m++) {
+        struct scenario_member *member = vec_ref(scene->members, m);
 
-        return vec_ref(scene->players, player_idx);
+        // the id is already in the map, so this doesn't allocate.
+        struct result_void r = id_map_set(&scene->member_slots, member->id, m);
+        if (r.status == RESULT_ERROR)
+            free_error(r.error);
     }
 
-    return NULL;
+    return 0;
 }
 
-/// returns a reference to the tank in the scenario. Actor and Tank IDs are
-/// simply their index in their respective arrays.
-struct tank* scenario_get_tank(struct scenario *scene,
-                               size_t player_idx,
-                               size_t tank_id) {
-    if (tank_id >= TANKS_IN_SCENARIO || player_idx >= vec_len(scene->players))
-        return NULL;
+struct result_void scenario_post_event(struct scenario *scene,
+                                       const struct scenario_event *event) {
+    struct scenario_event *copy = malloc(sizeof(struct scenario_event));
+    if (copy == NULL) {
+        if (event->type == SCENARIO_EVENT_UPDATE) {
+            free_vector(event->update.tank_target_coords);
+            free_vector(event->update.tank_instructions);
+        }
 
-    struct player_data* pd = vec_ref(scene->players, player_idx);
-    return vec_ref(pd->tanks, tank_id);
+        return RESULT_MSG_ERROR(void, "failed to allocate scenario event");
+    }
+
+    *copy = *event;
+    mpsc_push(&scene->inbox, &copy->node);
+    return result_void_ok(0);
+}
+
+/** sets the commands of the player's tanks. */
+/** clamps a client's coordinate onto the map. */
+s32 scenario_clamp_coord(s32 x) {
+    if (x < -TANK_MAP_EXTENT)
+        return -TANK_MAP_EXTENT;
+    if (x > TANK_MAP_EXTENT)
+        return TANK_MAP_EXTENT;
+    return x;
 }
 
-void scenario_heal_tank(struct tank *tank) {
-    if (tank->cmd != TANK_HEAL)
+void scenario_update_player(struct scenario *scene,
+                            const struct scenario_event *event) {
+    ssize_t player_idx = scenario_find_player(scene, event->member_id);
+
+    // the player left before the update was applied.
+    if (player_idx < 0)
         return;
 
-    tank->health += TANK_HEAL_RATE;
-    
-    if (tank->health > 100)
-        tank->health = 100;
+    // ensure the client doesn't try to update more tanks than actually
+    // exist, or than it sent both a target and a command for.
+    size_t num_tanks = vec_len(event->update.tank_instructions);
+    if (vec_len(event->update.tank_target_coords) < num_tanks)
+        num_tanks = vec_len(event->update.tank_target_coords);
+    if (TANKS_IN_SCENARIO < num_tanks)
+        num_tanks = TANKS_IN_SCENARIO;
+
+    const struct coord *targets = vec_dat(event->update.tank_target_coords);
+    const enum tank_command *commands =
+        vec_dat(event->update.tank_instructions);
+
+    // the whole update is refused if any command is invalid.
+    for (size_t t = 0; t < num_tanks; t++) {
+        if (commands[t] != TANK_MOVE && commands[t] != TANK_FIRE &&
+            commands[t] != TANK_HEAL)
+            return;
+    }
 
-    return;
+    struct tank_table *tanks = &scene->tanks;
+    for (size_t t = 0; t < num_tanks; t++) {
+        enum tank_command command = commands[t];
+        u32 id = player_idx * TANKS_IN_SCENARIO + t;
+
+        // a heal has no target, the old one is kept.
+        if (command == TANK_MOVE || command == TANK_FIRE) {
+            tanks->target_x[id] = scenario_clamp_coord(targets[t].x);
+            tanks->target_y[id] = scenario_clamp_coord(targets[t].y);
+        }
+
+        tanks->cmd[id] = command;
+    }
 }
 
-/// Friendly fire is on. tanks can also shoot themselves.
-void scenario_fire_tank(struct scenario *scene, struct tank* tank) {
-    if (tank->cmd != TANK_FIRE)
-        return;
+/** applies every event posted since the last tick. */
+void scenario_drain_inbox(struct scenario *scene) {
+    struct mpsc_node *node;
+    while ((node = mpsc_pop(&scene->inbox)) != NULL) {
+        struct scenario_event *event = (struct scenario_event *)node;
 
-    struct tank* target = NULL;
-    for (size_t p = 0; p < vec_len(scene->players); p++) {
-        for (int t = 0; t < TANKS_IN_SCENARIO; t++) {
-            struct tank* other = scenario_get_tank(scene, p, t);
+        switch (event->type) {
+        case SCENARIO_EVENT_JOIN: {
+            struct scenario_member member = {
+                .handle = event->handle,
+                .encoding = event->encoding,
+                .id = event->member_id,
+            };
+            strcpy(member.username, event->username);
 
-            if (other->pos.x == tank->aim_at.x &&
-                other->pos.y == tank->aim_at.y) {
-                target = other;
-                goto end_search; // I just want to break out of both
-                // loops lol
+            if (scenario_add_player(scene, &member) < 0)
+                printf("%s: failed to add %s\n", scene->name, member.username);
+            break;
+        }
+        case SCENARIO_EVENT_LEAVE:
+            scenario_rem_player(scene, event->member_id);
+            break;
+        case SCENARIO_EVENT_UPDATE:
+            scenario_update_player(scene, event);
+            break;
+        case SCENARIO_EVENT_KEYFRAME: {
+            ssize_t player_idx = scenario_find_player(scene, event->member_id);
+            if (player_idx >= 0) {
+                struct scenario_member *member =
+                    vec_ref(scene->members, player_idx);
+                member->wants_keyframe = true;
             }
+            break;
+        }
         }
-    }
- end_search:
-    if (target == NULL)
-        return;
 
-    target->health -= TANK_SHELL_DAMAGE;
-    return;
+        free_scenario_event(event);
+    }
 }
 
-void scenario_move_tank(struct tank *tank) {
-    if (tank->cmd != TANK_MOVE)
-        return;
+/** makes room in every slot's damage array for each tank. */
+int scenario_reserve_damage(struct scenario *scene) {
+    u32 capacity = scene->tanks.capacity;
+    if (scene->damage_capacity >= capacity)
+        return 0;
 
-    int x = tank->pos.x,
-        y = tank->pos.y,
-        xx = tank->move_to.x,
-        yy = tank->move_to.y;
-    
-    float move_distance =
-        sqrtf((powf(xx - x, 2) + powf(yy - y, 2)));
+    for (size_t slot = 0; slot <= scene->workers->len; slot++) {
+        u32 *tmp = realloc(scene->damage[slot], capacity * sizeof(u32));
+        if (tmp == NULL)
+            return -1;
 
-    if (move_distance <= TANK_MAX_SPEED) {
-        tank->pos.x = xx;
-        tank->pos.y = yy;
-        return;
+        // the old part is already zero, since damage is zeroed once applied.
+        memset(&tmp[scene->damage_capacity], 0,
+               (capacity - scene->damage_capacity) * sizeof(u32));
+        scene->damage[slot] = tmp;
     }
 
-    printf("tank moving too far (%f), doing a partial move.\n", move_distance);
+    scene->damage_capacity = capacity;
+    return 0;
+}
+
+/** The state shared by the chunks of a tick's passes. */
+struct scenario_tick_pass {
+    struct scenario *scene;
+
+    // the damage arrays with anything in them.
+    u32 **damage;
+    size_t num_damage;
+};
 
-    // otherwise, we can only move the max distance. move the tank
-    // TANK_MAX_SPEED units in the direction of xx and yy.
-    tank->pos.x += roundf(((xx - x) / move_distance) * TANK_MAX_SPEED);
-    tank->pos.y += roundf(((yy - y) / move_distance) * TANK_MAX_SPEED);
-    printf("move_to x/y: %d, %d\nnew x/y: %d, %d\n",
-           xx, yy, tank->pos.x, tank->pos.y);
-    return;
+/** heals tanks, and gathers the damage of their shots. */
+void scenario_heal_and_fire(void *arg, size_t first, size_t last,
+                            size_t slot) {
+    struct scenario *scene = ((struct scenario_tick_pass *)arg)->scene;
+
+    tank_table_heal(&scene->tanks, first, last);
+    if (tank_table_fire(&scene->tanks, &scene->grid, first, last,
+                        scene->damage[slot]) > 0)
+        scene->damage_dealt[slot] = true;
+}
+
+/** applies the gathered damage, then moves tanks.  Every shot was fired in
+    the first pass, so shots land on the positions at the start of the
+    tick. */
+void scenario_damage_and_move(void *arg, size_t first, size_t last,
+                              size_t slot) {
+    (void)slot;
+    struct scenario_tick_pass *pass = arg;
+    struct tank_table *tanks = &pass->scene->tanks;
+
+    tank_table_apply_damage(tanks, first, last, pass->damage,
+                            pass->num_damage);
+    tank_table_move_range(tanks, first, last);
 }
 
 int scenario_tick(struct scenario *scene) {
@@ -170,71 +464,589 @@ int scenario_tick(struct scenario *scene) {
      5. return
      */
 
-    for (int t = 0; t < TANKS_IN_SCENARIO; t++) {
-        for (size_t a = 0; a < vec_len(scene->players); a++) {
-            scenario_heal_tank(scenario_get_tank(scene, a, t));
+    struct tank_table *tanks = &scene->tanks;
+
+    // index every tank by its position, so that a shot finds its target
+    // without searching every tank.
+    struct result_void r = spatial_grid_reset(&scene->grid, tanks->len);
+    if (r.status == RESULT_ERROR) {
+        free_error(r.error);
+        return -1;
+    }
+
+    for (u32 id = 0; id < tanks->len; id++) {
+        struct coord pos = { tanks->pos_x[id], tanks->pos_y[id] };
+        spatial_grid_insert(&scene->grid, id, pos);
+    }
+
+    if (scenario_reserve_damage(scene) < 0)
+        return -1;
+
+    struct scenario_tick_pass pass = { .scene = scene };
+    thread_pool_parallel_for(scene->workers, tanks->len, SCENARIO_TICK_GRAIN,
+                             &scenario_heal_and_fire, &pass);
+
+    // a tank's damage is the sum of every slot's, which is the same however
+    // the shots were split between slots.  The arrays with damage in them
+    // are moved to the front, which is fine, since they are all zero again
+    // by the next tick.
+    pass.damage = scene->damage;
+    for (size_t slot = 0; slot <= scene->workers->len; slot++) {
+        if (!scene->damage_dealt[slot])
+            continue;
+
+        u32 *dealt = scene->damage[slot];
+        scene->damage[slot] = scene->damage[pass.num_damage];
+        scene->damage[pass.num_damage++] = dealt;
+        scene->damage_dealt[slot] = false;
+    }
+
+    thread_pool_parallel_for(scene->workers, tanks->len, SCENARIO_TICK_GRAIN,
+                             &scenario_damage_and_move, &pass);
+
+    return 0;
+}
+
+void print_scenario_error(struct error error) {
+    char *description = describe_error(error);
+    printf("%s", description);
+    free(description);
+    free_error(error);
+}
+
+void free_scenario_delivery(struct scenario_delivery *delivery) {
+    for (size_t r = 0; r < vec_len(delivery->recipients); r++) {
+        struct scenario_recipient *recipient =
+            vec_ref(delivery->recipients, r);
+        message_buffer_release(recipient->msg);
+    }
+
+    free_vector(delivery->recipients);
+    free(delivery);
+}
+
+/** returns the snapshot's member with `id`, or NULL. */
+const struct scenario_member *
+scenario_snapshot_member(const struct scenario_snapshot *snap, u32 id) {
+    // members are kept in the order they joined, so they're sorted by id.
+    size_t low = 0, high = vec_len(snap->members);
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        const struct scenario_member *member = vec_ref(snap->members, mid);
+
+        if (member->id == id)
+            return member;
+        else if (member->id < id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    return NULL;
+}
+
+/** Frees the views of members who left, and adds one for each member who
+    joined.  Afterwards, the `p`th view is the `p`th member's. */
+int scenario_update_views(struct scenario *scene,
+                          const struct scenario_snapshot *snap) {
+    struct scenario_view *views = vec_dat(scene->views);
+    size_t num_members = vec_len(snap->members);
+    size_t kept = 0;
+
+    // both are sorted by member id, so the views that are kept stay in
+    // order.
+    for (size_t v = 0; v < vec_len(scene->views); v++) {
+        const struct scenario_member *member = kept < num_members
+            ? vec_ref(snap->members, kept)
+            : NULL;
+
+        if (member != NULL && member->id == views[v].member_id)
+            views[kept++] = views[v];
+        else
+            free_vector(views[v].tanks);
+    }
+    vec_resize(scene->views, kept);
+
+    // new members have the highest ids, so theirs go at the end.
+    for (size_t p = kept; p < num_members; p++) {
+        const struct scenario_member *member = vec_ref(snap->members, p);
+        struct scenario_view view = {
+            .member_id = member->id,
+            .tanks = make_vector(sizeof(struct tank_delta), TANKS_IN_SCENARIO),
+        };
+
+        if (view.tanks == NULL)
+            return -1;
+        if (vec_push(scene->views, &view) < 0) {
+            free_vector(view.tanks);
+            return -1;
         }
+    }
+
+    return 0;
+}
+
+/** indexes the snapshot's tanks, to find what each member can see. */
+struct result_void scenario_index_snapshot(struct scenario *scene,
+                                           const struct scenario_snapshot *snap) {
+    size_t num_members = vec_len(snap->members);
+    u32 *member_ids = arena_new(&scene->tick_arena, u32, num_members);
+    if (member_ids == NULL)
+        return RESULT_MSG_ERROR(void, "failed to allocate member ids");
+
+    for (size_t p = 0; p < num_members; p++) {
+        const struct scenario_member *member = vec_ref(snap->members, p);
+        member_ids[p] = member->id;
+    }
+
+    u32 num_tanks = vec_len(snap->positions);
+    RESULT_CALL(void, spatial_grid_reset(&scene->view_grid, num_tanks));
+
+    const struct coord *positions = vec_dat(snap->positions);
+    for (u32 id = 0; id < num_tanks; id++)
+        spatial_grid_insert(&scene->view_grid, id, positions[id]);
+
+    scene->broadcast.src = (struct tank_view_source) {
+        .grid = &scene->view_grid,
+        .health = vec_dat(snap->health),
+        .player_ids = member_ids,
+        .num_players = num_members,
+        .tanks_per_player = TANKS_IN_SCENARIO,
+    };
+
+    return result_void_ok(0);
+}
+
+/** Makes the `p`th member's tick: a delta against what it was last sent, or a
+    keyframe.  The member's view becomes what it can see now. */
+struct result_void scenario_view_tick(struct scenario_broadcast_buffers *buf,
+                                      struct scenario_view *view,
+                                      const struct scenario_snapshot *snap,
+                                      u32 p, struct scenario_recipient *out) {
+    const struct scenario_member *member = vec_ref(snap->members, p);
+    struct scenario_tick *tick = &buf->tick;
 
-        for (size_t a = 0; a < vec_len(scene->players); a++) {
-            scenario_fire_tank(scene,
-                               scenario_get_tank(scene, a, t));
+    RESULT_CALL(void, tank_view_collect(&buf->src, p, buf->scratch,
+                                        buf->visible));
+
+    *tick = (struct scenario_tick) {
+        .tick_number = snap->tick_number,
+        .keyframe = !view->sent || member->wants_keyframe ||
+            view->since_keyframe + 1 >= SCENARIO_KEYFRAME_INTERVAL,
+        .base_tick = view->tick_number,
+        .players = tick->players,
+        .changes = tick->changes,
+        .removals = tick->removals,
+    };
+    vec_resize(tick->players, 0);
+    vec_resize(tick->changes, 0);
+    vec_resize(tick->removals, 0);
+    vec_resize(buf->named, 0);
+
+    struct vector *was = view->tanks;
+    int status = tick->keyframe
+        ? tank_view_players(buf->visible, buf->named)
+        : tank_view_diff(was, buf->visible, tick->changes, tick->removals,
+                         buf->named);
+    if (status == 0 && tick->keyframe)
+        status = vec_concat(tick->changes, buf->visible);
+    if (status < 0)
+        return RESULT_MSG_ERROR(void, "failed to diff %s's view",
+                                member->username);
+
+    for (size_t n = 0; n < vec_len(buf->named); n++) {
+        const u32 *id = vec_ref(buf->named, n);
+        const struct scenario_member *owner = scenario_snapshot_member(snap,
+                                                                       *id);
+
+        struct tick_player player = { .id = *id };
+        if (owner != NULL)
+            strcpy(player.username, owner->username);
+        if (vec_push(tick->players, &player) < 0)
+            return RESULT_MSG_ERROR(void, "failed to push tick player");
+    }
+
+    vector *bytes;
+    RESULT_UNWRAP(void, bytes, make_scenario_tick_message(tick,
+                                                          member->encoding));
+    RESULT_UNWRAP(void, out->msg, make_message_buffer(bytes));
+
+    out->keyframe = tick->keyframe;
+    out->base_tick = tick->base_tick;
+
+    // the old view is reused for the next member.
+    view->tanks = buf->visible;
+    buf->visible = was;
+    view->sent = true;
+    view->tick_number = snap->tick_number;
+    view->since_keyframe = tick->keyframe ? 0 : view->since_keyframe + 1;
+    return result_void_ok(0);
+}
+
+/** serializes a snapshot for each member, and posts it to the outbox. */
+int scenario_broadcast(struct scenario *scene, struct scenario_snapshot *snap) {
+    if (scenario_update_views(scene, snap) < 0)
+        return -1;
+
+    size_t num_members = vec_len(snap->members);
+    if (num_members == 0)
+        return 0;
+
+    struct scenario_delivery *delivery =
+        calloc(1, sizeof(struct scenario_delivery));
+    if (delivery == NULL)
+        return -1;
+
+    delivery->scene = scene;
+    delivery->tick_number = snap->tick_number;
+    delivery->recipients = make_vector(sizeof(struct scenario_recipient),
+                                       num_members);
+    if (delivery->recipients == NULL) {
+        free(delivery);
+        return -1;
+    }
+
+    // nothing from the last broadcast is still in use.
+    arena_reset(&scene->tick_arena);
+
+    struct result_void r = scenario_index_snapshot(scene, snap);
+    if (r.status == RESULT_ERROR) {
+        print_scenario_error(r.error);
+        free_scenario_delivery(delivery);
+        return -1;
+    }
+
+    // each member is sent its own tick, since each sees different tanks.
+    for (size_t p = 0; p < num_members; p++) {
+        struct scenario_recipient recipient = {
+            .member = *(struct scenario_member *)vec_ref(snap->members, p),
+        };
+
+        struct scenario_view *view = vec_ref(scene->views, p);
+        r = scenario_view_tick(&scene->broadcast, view, snap, p, &recipient);
+        if (r.status == RESULT_ERROR) {
+            // the member misses the tick.  Its view is left as it was, so
+            // its next delta still follows on from the last tick it got.
+            print_scenario_error(r.error);
+            recipient.msg = NULL;
         }
 
-        for (size_t a = 0; a < vec_len(scene->players); a++) {
-            scenario_move_tank(scenario_get_tank(scene, a, t));
+        if (vec_push(delivery->recipients, &recipient) < 0) {
+            // the member misses a tick its view already moved on to, so it
+            // is sent a keyframe next.
+            printf("%s: failed to queue %s's tick\n", scene->name,
+                   recipient.member.username);
+            if (recipient.msg != NULL)
+                message_buffer_release(recipient.msg);
+            view->sent = false;
         }
     }
+
+    // wake up the reactor to queue the tick.
+    mpsc_push(&scene->outbox->deliveries, &delivery->node);
+    u64 one = 1;
+    if (write(scene->outbox->eventfd, &one, sizeof(one)) < 0)
+        perror("ERROR: failed to signal the outbox");
     
     return 0;
 }
 
-int scenario_handler(struct scenario *scene) {
-    float current_time = (float)clock() / CLOCKS_PER_SEC;
-    float next_tick_time = (1/scene->tick_rate) * scene->tick_number;
+/** broadcasts snapshots until there are none left to send. */
+void scenario_broadcast_job(void *arg) {
+    struct scenario *scene = arg;
 
-    if (current_time < next_tick_time)
-        return 1; // exit early since it is not time for the next update.
+    pthread_mutex_lock(&scene->snapshot_lock);
+    while (scene->sending >= 0) {
+        struct scenario_snapshot *snap = &scene->snapshots[scene->sending];
+        pthread_mutex_unlock(&scene->snapshot_lock);
 
-    scenario_tick(scene);
-    scene->tick_number++;
+        // the tick only writes the other snapshot, so this one is read
+        // without the lock.
+        if (scenario_broadcast(scene, snap) < 0)
+            printf("%s: failed to send tick %d\n", scene->name,
+                   snap->tick_number);
 
-    char msg_text[30];
-    snprintf(msg_text, 30, "game is on tick %d", scene->tick_number);
+        pthread_mutex_lock(&scene->snapshot_lock);
+        scene->sending = scene->ready;
+        scene->ready = -1;
+    }
+    pthread_mutex_unlock(&scene->snapshot_lock);
+}
 
-    //printf(": %s\n", msg_text);
+/** asks again for the keyframes that a snapshot which won't be sent asked
+    for. */
+void scenario_keep_keyframe_requests(struct scenario *scene,
+                                     const struct scenario_snapshot *snap) {
+    size_t m = 0;
 
-    // send updates to all the players
-    // create message to send to players
+    // both are sorted by member id.
+    for (size_t s = 0; s < vec_len(snap->members); s++) {
+        const struct scenario_member *was = vec_ref(snap->members, s);
+        if (!was->wants_keyframe)
+            continue;
 
-    struct vector *public_data = player_public_data_get_all(scene->players);
-    struct scenario_tick tick  = (struct scenario_tick) {
-        .players_public_data = public_data
-    };
-    struct result_sexp msg = make_scenario_tick_message(&tick);
+        struct scenario_member *member = NULL;
+        for (; m < vec_len(scene->members); m++) {
+            member = vec_ref(scene->members, m);
+            if (member->id >= was->id)
+                break;
+        }
 
-    if (msg.status == RESULT_ERROR) {
-        // TODO handle this errror
-        printf("%s", describe_error(msg.error));
-        free_error(msg.error);
+        if (m < vec_len(scene->members) && member->id == was->id)
+            member->wants_keyframe = true;
+    }
+}
+
+/** copies the tick into the snapshot that isn't being sent, and starts
+    broadcasting it, unless the last snapshot is still being sent. */
+int scenario_publish(struct scenario *scene) {
+    pthread_mutex_lock(&scene->snapshot_lock);
+
+    int next = scene->sending == 0 ? 1 : 0;
+    struct scenario_snapshot *snap = &scene->snapshots[next];
+    struct tank_table *tanks = &scene->tanks;
+
+    // a keyframe that was asked for isn't lost if its snapshot is replaced
+    // before it's sent.
+    if (scene->ready == next)
+        scenario_keep_keyframe_requests(scene, snap);
+
+    // the snapshot may be waiting in `ready`, so it's written under the
+    // lock.  It's only a copy, which is quick next to serializing it.
+    int status = vec_resize(snap->members, 0);
+    if (status == 0)
+        status = vec_pushn(snap->members, vec_dat(scene->members),
+                           vec_len(scene->members));
+    if (status == 0)
+        status = vec_resize(snap->positions, tanks->len);
+    if (status == 0)
+        status = vec_resize(snap->health, 0);
+    if (status == 0)
+        status = vec_pushn(snap->health, tanks->health, tanks->len);
+
+    if (status < 0) {
+        // a half written snapshot isn't sent.
+        if (scene->ready == next)
+            scene->ready = -1;
+
+        pthread_mutex_unlock(&scene->snapshot_lock);
         return -1;
     }
 
-    // send the newly created message.        
-    for (size_t a = 0; a < vec_len(scene->players); a++) {
-        struct player_manager* pm = vec_ref(scene->player_managers, a);
+    struct coord *positions = vec_dat(snap->positions);
+    for (u32 id = 0; id < tanks->len; id++)
+        positions[id] = (struct coord) { tanks->pos_x[id], tanks->pos_y[id] };
+    snap->tick_number = scene->tick_number;
 
-        #ifdef DEBUG
-        struct sockaddr_in player_a = *(struct sockaddr_in *)(&actor.player->address);
-        struct in_addr a = player_a.sin_addr;
-        printf("socket: %d, addr: %s\n", actor.player->socket,
-               inet_ntoa(a));
-        #endif
+    for (size_t m = 0; m < vec_len(scene->members); m++) {
+        struct scenario_member *member = vec_ref(scene->members, m);
+        member->wants_keyframe = false;
+    }
+
+    bool start = scene->sending < 0;
+    if (start)
+        scene->sending = next;
+    else
+        scene->ready = next;
+
+    pthread_mutex_unlock(&scene->snapshot_lock);
+
+    if (!start)
+        return 0;
+
+    struct result_void r = thread_pool_submit(scene->workers,
+                                              &scenario_broadcast_job, scene);
+    if (r.status == RESULT_ERROR) {
+        print_scenario_error(r.error);
 
-        message_send(pm->socket, msg.ok);
+        pthread_mutex_lock(&scene->snapshot_lock);
+        scene->sending = -1;
+        pthread_mutex_unlock(&scene->snapshot_lock);
+        return -1;
     }
 
-    free_all_player_public_data(public_data);
-    free_sexp(msg.ok);
-    
     return 0;
 }
+
+int scenario_handler(struct scenario *scene) {
+    scenario_drain_inbox(scene);
+
+    // a tick that failed part way isn't counted or sent.
+    if (scenario_tick(scene) < 0)
+        return -1;
+    scene->tick_number++;
+
+    return scenario_publish(scene);
+}
+
+void scenario_print_tick_stats(struct scenario *scene) {
+    struct tick_stats stats = tick_scheduler_take_stats(&scene->schedule);
+    if (stats.ticks == 0)
+        return;
+
+    printf("%s: %lu ticks, jitter min/avg/max %.3f/%.3f/%.3f ms, "
+           "%lu overruns, %lu skipped (%s)\n", scene->name, stats.ticks,
+           stats.jitter_min_ns / 1e6,
+           stats.jitter_total_ns / 1e6 / stats.ticks,
+           stats.jitter_max_ns / 1e6,
+           stats.overruns, stats.skipped,
+           tick_overrun_policy_name(scene->schedule.config.policy));
+}
+
+/** a thread pool job, which runs the scenario's due ticks. */
+void scenario_tick_job(void *arg) {
+    struct scenario *scene = arg;
+    struct tick_scheduler *schedule = &scene->schedule;
+
+    bool catch_up;
+    do {
+        tick_scheduler_begin(schedule, tick_clock_now());
+
+        if (scenario_handler(scene) < 0)
+            printf("%s: failed to run tick %d\n", scene->name,
+                   scene->tick_number);
+
+        catch_up = tick_scheduler_end(schedule, tick_clock_now());
+
+        if (scene->tick_number % SCENARIO_TICK_STATS_INTERVAL == 0)
+            scenario_print_tick_stats(scene);
+    } while (catch_up);
+
+    // once the scenario is released, another tick may start and move the
+    // deadline, so it's read first.
+    u64 deadline = schedule->deadline_ns;
+    atomic_store_explicit(&scene->ticking, false, memory_order_release);
+    scenario_arm_timer(scene->timer, deadline);
+}
+
+/********************************** REGISTRY **********************************/
+struct result_void make_scenario_registry(struct scenario_registry *reg,
+                                          struct tick_config tick_config) {
+    reg->tick_config = tick_config;
+    reg->scenarios = make_vector(sizeof(struct scenario *), MAX_SCENARIOS);
+    if (reg->scenarios == NULL)
+        return RESULT_MSG_ERROR(void, "failed to allocate scenario registry");
+
+    mpsc_init(&reg->outbox.deliveries);
+    reg->outbox.eventfd = eventfd(0, EFD_NONBLOCK);
+    if (reg->outbox.eventfd < 0) {
+        free_vector(reg->scenarios);
+        return RESULT_MSG_ERROR(void, "failed to create outbox eventfd: %s",
+                                strerror(errno));
+    }
+
+    struct result_void r = make_thread_pool(&reg->workers, 0);
+    if (r.status == RESULT_ERROR) {
+        close(reg->outbox.eventfd);
+        free_vector(reg->scenarios);
+        return r;
+    }
+
+    return result_void_ok(0);
+}
+
+void free_scenario_registry(struct scenario_registry *reg) {
+    // wait for the running ticks, before freeing their scenarios.
+    free_thread_pool(&reg->workers);
+
+    struct scenario_delivery *delivery;
+    while ((delivery = scenario_outbox_pop(&reg->outbox)) != NULL)
+        free_scenario_delivery(delivery);
+    close(reg->outbox.eventfd);
+
+    for (size_t i = 0; i < vec_len(reg->scenarios); i++) {
+        struct scenario *scene = scenario_registry_at(reg, i);
+        free_scenario(scene);
+        free(scene);
+    }
+
+    free_vector(reg->scenarios);
+}
+
+struct result_void scenario_registry_create(struct scenario_registry *reg,
+                                            const char *name) {
+    // these are shown to the player, so they leave out the source location.
+    size_t name_len = strlen(name);
+    if (name_len == 0 || name_len >= SCENARIO_NAME_LEN)
+        return result_void_msg_error("scenario names must be 1 to %d bytes",
+                                     SCENARIO_NAME_LEN - 1);
+
+    if (scenario_registry_find(reg, name) != NULL)
+        return result_void_msg_error("scenario %s already exists", name);
+
+    if (vec_len(reg->scenarios) >= MAX_SCENARIOS)
+        return result_void_msg_error("the server can't host more than %d "
+                                     "scenarios", MAX_SCENARIOS);
+
+    struct scenario *scene = malloc(sizeof(struct scenario));
+    if (scene == NULL || make_scenario(scene, name, reg->tick_config,
+                                          &reg->outbox, &reg->workers) < 0) {
+        free(scene);
+        return RESULT_MSG_ERROR(void, "failed to create scenario %s", name);
+    }
+
+    if (vec_push(reg->scenarios, &scene) < 0) {
+        free_scenario(scene);
+        free(scene);
+        return RESULT_MSG_ERROR(void, "failed to create scenario %s", name);
+    }
+
+    return result_void_ok(0);
+}
+
+struct scenario *scenario_registry_find(const struct scenario_registry *reg,
+                                        const char *name) {
+    for (size_t i = 0; i < vec_len(reg->scenarios); i++) {
+        struct scenario *scene = scenario_registry_at(reg, i);
+        if (strcmp(scene->name, name) == 0)
+            return scene;
+    }
+
+    return NULL;
+}
+
+size_t scenario_registry_len(const struct scenario_registry *reg) {
+    return vec_len(reg->scenarios);
+}
+
+struct scenario *scenario_registry_at(const struct scenario_registry *reg,
+                                      size_t index) {
+    if (index >= vec_len(reg->scenarios))
+        return NULL;
+
+    struct scenario *scene;
+    vec_at(reg->scenarios, index, &scene);
+    return scene;
+}
+
+void scenario_registry_tick(struct scenario_registry *reg, size_t index) {
+    struct scenario *scene = scenario_registry_at(reg, index);
+    if (scene == NULL)
+        return;
+
+    u64 expirations;
+    if (read(scene->timer, &expirations, sizeof(expirations)) < 0)
+        return;
+
+    // a running tick re-arms the timer once it's done, and its scheduler
+    // decides what to do about the deadlines it missed.
+    if (atomic_exchange_explicit(&scene->ticking, true, memory_order_acq_rel))
+        return;
+
+    // an expiration from before the last tick re-armed the timer.
+    if (tick_clock_now() < scene->schedule.deadline_ns) {
+        atomic_store_explicit(&scene->ticking, false, memory_order_release);
+        return;
+    }
+
+    struct result_void r = thread_pool_submit(&reg->workers,
+                                              &scenario_tick_job, scene);
+    if (r.status == RESULT_ERROR) {
+        print_scenario_error(r.error);
+        atomic_store_explicit(&scene->ticking, false, memory_order_release);
+    }
+}
+
+struct scenario_delivery *scenario_outbox_pop(struct scenario_outbox *outbox) {
+    return (struct scenario_delivery *)mpsc_pop(&outbox->deliveries);
+}
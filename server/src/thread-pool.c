@@ -0,0 +1,200 @@
+#include "thread-pool.h"
+#include "error.h"
+#include "vector.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+void *thread_pool_worker(void *arg) {
+    struct thread_pool *pool = arg;
+
+    while (true) {
+        pthread_mutex_lock(&pool->lock);
+        while (vec_len(pool->jobs) == 0 && !pool->stopping)
+            pthread_cond_wait(&pool->job_ready, &pool->lock);
+
+        // only stop once every submitted job has run.
+        if (vec_len(pool->jobs) == 0) {
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+
+        struct thread_pool_job job;
+        vec_at(pool->jobs, 0, &job);
+        vec_rem(pool->jobs, 0);
+        pthread_mutex_unlock(&pool->lock);
+
+        job.fn(job.arg);
+    }
+}
+
+struct result_void make_thread_pool(struct thread_pool *pool, size_t len) {
+    if (len == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        len = cpus > 0 ? (size_t)cpus : 1;
+    }
+
+    pool->jobs = make_vector(sizeof(struct thread_pool_job), 16);
+    pool->threads = malloc(len * sizeof(pthread_t));
+    pool->len = 0;
+    pool->stopping = false;
+
+    if (pool->jobs == NULL || pool->threads == NULL) {
+        free_vector(pool->jobs);
+        free(pool->threads);
+        return RESULT_MSG_ERROR(void, "failed to allocate thread pool");
+    }
+
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->job_ready, NULL);
+
+    for (size_t i = 0; i < len; i++) {
+        if (pthread_create(&pool->threads[i], NULL,
+                           &thread_pool_worker, pool) != 0)
+            break;
+
+        pool->len++;
+    }
+
+    if (pool->len == 0) {
+        free_thread_pool(pool);
+        return RESULT_MSG_ERROR(void, "failed to start any worker threads");
+    }
+
+    return result_void_ok(0);
+}
+
+void free_thread_pool(struct thread_pool *pool) {
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    for (size_t i = 0; i < pool->len; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->job_ready);
+    pthread_mutex_destroy(&pool->lock);
+    free_vector(pool->jobs);
+    free(pool->threads);
+}
+
+struct result_void thread_pool_submit(struct thread_pool *pool,
+                                      thread_pool_fn *fn, void *arg) {
+    struct thread_pool_job job = { .fn = fn, .arg = arg };
+
+    pthread_mutex_lock(&pool->lock);
+    int status = vec_push(pool->jobs, &job);
+    if (status >= 0)
+        pthread_cond_signal(&pool->job_ready);
+    pthread_mutex_unlock(&pool->lock);
+
+    if (status < 0)
+        return RESULT_MSG_ERROR(void, "failed to queue job");
+
+    return result_void_ok(0);
+}
+
+/** A parallel for, shared by its caller and the workers helping it.  The
+    last one to let go of it frees it, since a worker may only get to its job
+    after the caller has returned. */
+struct thread_pool_range {
+    thread_pool_range_fn *fn;
+    void *arg;
+    size_t len, grain, chunks;
+
+    atomic_size_t next_chunk;
+    atomic_size_t done_chunks;
+    atomic_size_t next_slot;
+    atomic_size_t refs;
+
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+void thread_pool_range_release(struct thread_pool_range *range) {
+    if (atomic_fetch_sub(&range->refs, 1) != 1)
+        return;
+
+    pthread_cond_destroy(&range->done);
+    pthread_mutex_destroy(&range->lock);
+    free(range);
+}
+
+/** runs chunks until there are none left. */
+void thread_pool_range_run(struct thread_pool_range *range, size_t slot) {
+    size_t chunk;
+    while ((chunk = atomic_fetch_add(&range->next_chunk, 1)) < range->chunks) {
+        size_t first = chunk * range->grain;
+        size_t last = first + range->grain < range->len
+            ? first + range->grain
+            : range->len;
+
+        range->fn(range->arg, first, last, slot);
+
+        if (atomic_fetch_add(&range->done_chunks, 1) + 1 == range->chunks) {
+            pthread_mutex_lock(&range->lock);
+            pthread_cond_signal(&range->done);
+            pthread_mutex_unlock(&range->lock);
+        }
+    }
+}
+
+void thread_pool_range_job(void *arg) {
+    struct thread_pool_range *range = arg;
+
+    thread_pool_range_run(range, atomic_fetch_add(&range->next_slot, 1));
+    thread_pool_range_release(range);
+}
+
+void thread_pool_parallel_for(struct thread_pool *pool, size_t len,
+                              size_t grain, thread_pool_range_fn *fn,
+                              void *arg) {
+    size_t chunks = (len + grain - 1) / grain;
+
+    // not worth waking a worker for.
+    struct thread_pool_range *range = NULL;
+    if (chunks > 1)
+        range = malloc(sizeof(struct thread_pool_range));
+
+    if (range == NULL) {
+        if (len > 0)
+            fn(arg, 0, len, 0);
+        return;
+    }
+
+    size_t helpers = chunks - 1 < pool->len ? chunks - 1 : pool->len;
+
+    *range = (struct thread_pool_range) {
+        .fn = fn, .arg = arg,
+        .len = len, .grain = grain, .chunks = chunks,
+    };
+    atomic_init(&range->next_chunk, 0);
+    atomic_init(&range->done_chunks, 0);
+    atomic_init(&range->next_slot, 1);
+    atomic_init(&range->refs, helpers + 1);
+    pthread_mutex_init(&range->lock, NULL);
+    pthread_cond_init(&range->done, NULL);
+
+    for (size_t h = 0; h < helpers; h++) {
+        struct result_void r = thread_pool_submit(pool, &thread_pool_range_job,
+                                                  range);
+        if (r.status == RESULT_ERROR) {
+            // the caller does the helper's share.
+            free_error(r.error);
+            thread_pool_range_release(range);
+        }
+    }
+
+    thread_pool_range_run(range, 0);
+
+    // wait for the chunks the workers took.
+    pthread_mutex_lock(&range->lock);
+    while (atomic_load(&range->done_chunks) < chunks)
+        pthread_cond_wait(&range->done, &range->lock);
+    pthread_mutex_unlock(&range->lock);
+
+    thread_pool_range_release(range);
+}
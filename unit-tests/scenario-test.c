@@ -0,0 +1,1068 @@
+#include "arena.h"
+#include "error.h"
+#include "id-map.h"
+#include "message.h"
+#include "scenario.h"
+#include "spatial-grid.h"
+#include "tank-table.h"
+#include "tank-view.h"
+#include "tick-scheduler.h"
+#include "unit-test.h"
+#include "vector.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/******************************** SPATIAL GRID ********************************/
+#define GRID_TEST_ITEMS 500
+
+/** scatters the items over a few cells on both sides of 0. */
+struct coord grid_test_position(u32 id) {
+    return (struct coord) {
+        .x = (s32)((id * 7919u) % 61) - 30,
+        .y = (s32)((id * 104729u) % 47) - 23,
+    };
+}
+
+struct result_void make_test_grid(struct spatial_grid *grid) {
+    RESULT_CALL(void, make_spatial_grid(grid, TANK_FIRE_DISTANCE));
+
+    struct result_void r = spatial_grid_reset(grid, GRID_TEST_ITEMS);
+    if (r.status == RESULT_ERROR) {
+        free_spatial_grid(grid);
+        return r;
+    }
+
+    for (u32 id = 0; id < GRID_TEST_ITEMS; id++)
+        spatial_grid_insert(grid, id, grid_test_position(id));
+
+    return result_void_ok(0);
+}
+
+struct result_void tst_grid_find(void) {
+    struct spatial_grid grid;
+    RESULT_CALL(void, make_test_grid(&grid));
+
+    struct result_void error = no_error();
+
+    // the lowest id at each position, found by brute force.
+    for (u32 id = 0; id < GRID_TEST_ITEMS; id++) {
+        struct coord pos = grid_test_position(id);
+
+        u32 expected = id;
+        for (u32 other = 0; other < id; other++) {
+            struct coord other_pos = grid_test_position(other);
+            if (other_pos.x == pos.x && other_pos.y == pos.y) {
+                expected = other;
+                break;
+            }
+        }
+
+        u32 found = spatial_grid_find(&grid, pos);
+        if (found != expected) {
+            error = fail_msg("found %u at (%d, %d), expected %u",
+                             found, pos.x, pos.y, expected);
+            goto cleanup_return;
+        }
+    }
+
+    // move an item far away, into another cell.
+    struct coord far = { .x = 1000, .y = -1000 };
+    struct coord old = grid_test_position(7);
+    spatial_grid_move(&grid, 7, far);
+
+    if (spatial_grid_find(&grid, far) != 7) {
+        error = fail_msg("moved item wasn't found at its new position");
+        goto cleanup_return;
+    }
+
+    if (spatial_grid_find(&grid, old) == 7) {
+        error = fail_msg("moved item was still found at its old position");
+        goto cleanup_return;
+    }
+
+ cleanup_return:
+    free_spatial_grid(&grid);
+    return error;
+}
+
+struct result_void tst_grid_query_radius(void) {
+    struct spatial_grid grid;
+    RESULT_CALL(void, make_test_grid(&grid));
+
+    struct result_void error = no_error();
+    struct vector *ids = make_vector(sizeof(u32), GRID_TEST_ITEMS);
+    bool *seen = calloc(GRID_TEST_ITEMS, sizeof(bool));
+    if (ids == NULL || seen == NULL) {
+        error = fail_msg("failed to allocate query results");
+        goto cleanup_return;
+    }
+
+    struct coord centers[] = {{0, 0}, {-25, 17}, {31, -24}, {5, 5}, {-10, -10}};
+    for (size_t c = 0; c < sizeof(centers) / sizeof(centers[0]); c++) {
+        struct coord center = centers[c];
+
+        vec_resize(ids, 0);
+        error = spatial_grid_query_radius(&grid, center, TANK_FIRE_DISTANCE,
+                                          ids);
+        if (error.status == RESULT_ERROR)
+            goto cleanup_return;
+
+        for (u32 id = 0; id < GRID_TEST_ITEMS; id++)
+            seen[id] = false;
+
+        for (size_t i = 0; i < vec_len(ids); i++) {
+            u32 id;
+            vec_at(ids, i, &id);
+
+            if (seen[id]) {
+                error = fail_msg("%u was returned twice", id);
+                goto cleanup_return;
+            }
+            seen[id] = true;
+        }
+
+        // every item, and only the items, in range are returned.
+        for (u32 id = 0; id < GRID_TEST_ITEMS; id++) {
+            struct coord pos = grid_test_position(id);
+            s32 dx = pos.x - center.x, dy = pos.y - center.y;
+            bool in_range =
+                dx * dx + dy * dy <= TANK_FIRE_DISTANCE * TANK_FIRE_DISTANCE;
+
+            if (in_range != seen[id]) {
+                error = fail_msg("%u at (%d, %d) was %s by the query around "
+                                 "(%d, %d)", id, pos.x, pos.y,
+                                 in_range ? "missed" : "returned",
+                                 center.x, center.y);
+                goto cleanup_return;
+            }
+        }
+    }
+
+ cleanup_return:
+    free(seen);
+    free_vector(ids);
+    free_spatial_grid(&grid);
+    return error;
+}
+
+struct result_void tst_grid_query_edges(void) {
+    // the last cell touches the edge of the map when cells are 1 wide.
+    s32 cell_sizes[] = {1, TANK_SENSOR_RANGE};
+    struct coord edges[] = {
+        {INT32_MAX, INT32_MAX}, {INT32_MIN, INT32_MIN},
+        {INT32_MAX - 2, 0}, {0, INT32_MIN + 2}, {INT32_MIN, INT32_MAX},
+    };
+    size_t num_edges = sizeof(edges) / sizeof(edges[0]);
+
+    struct vector *ids = make_vector(sizeof(u32), num_edges);
+    if (ids == NULL)
+        return fail_msg("failed to allocate query results");
+
+    struct result_void error = no_error();
+    for (size_t c = 0; c < 2 && error.status == RESULT_OK; c++) {
+        struct spatial_grid grid;
+        error = make_spatial_grid(&grid, cell_sizes[c]);
+        if (error.status == RESULT_OK)
+            error = spatial_grid_reset(&grid, num_edges);
+        if (error.status == RESULT_ERROR)
+            break;
+
+        for (u32 id = 0; id < num_edges; id++)
+            spatial_grid_insert(&grid, id, edges[id]);
+
+        // each query only finds the item it's centered on.
+        for (u32 id = 0; id < num_edges && error.status == RESULT_OK; id++) {
+            vec_resize(ids, 0);
+            error = spatial_grid_query_radius(&grid, edges[id],
+                                              TANK_SENSOR_RANGE, ids);
+            if (error.status == RESULT_OK &&
+                (vec_len(ids) != 1 || *(u32 *)vec_ref(ids, 0) != id))
+                error = fail_msg("the query around (%d, %d) found %zu items",
+                                 edges[id].x, edges[id].y, vec_len(ids));
+        }
+
+        free_spatial_grid(&grid);
+    }
+
+    free_vector(ids);
+    return error;
+}
+
+/********************************* TANK TABLE *********************************/
+struct result_void tst_tank_table_remove(void) {
+    struct tank_table table;
+    make_tank_table(&table);
+
+    struct result_void error = no_error();
+
+    // enough tanks to grow the table a few times.
+    for (s32 i = 0; i < 300; i++) {
+        struct tank tank = {
+            .health = i,
+            .cmd = i % 2 == 0 ? TANK_MOVE : TANK_FIRE,
+            .pos = { i, -i },
+            .move_to = { i + 1, 0 },
+            .aim_at = { 0, i + 2 },
+        };
+
+        error = tank_table_push(&table, &tank);
+        if (error.status == RESULT_ERROR)
+            goto cleanup_return;
+    }
+
+    tank_table_remove(&table, 100, 36);
+
+    if (table.len != 264) {
+        error = fail_msg("table has %u tanks, expected 264", table.len);
+        goto cleanup_return;
+    }
+
+    for (u32 id = 0; id < table.len; id++) {
+        // the tank that was pushed with this id, before the removal.
+        s32 i = id < 100 ? (s32)id : (s32)id + 36;
+        struct coord target = i % 2 == 0
+            ? (struct coord) { i + 1, 0 }
+            : (struct coord) { 0, i + 2 };
+
+        if (table.health[id] != (u32)i ||
+            table.pos_x[id] != i || table.pos_y[id] != -i ||
+            table.target_x[id] != target.x || table.target_y[id] != target.y) {
+            error = fail_msg("tank %u doesn't match the %dth tank pushed", id, i);
+            goto cleanup_return;
+        }
+    }
+
+ cleanup_return:
+    free_tank_table(&table);
+    return error;
+}
+
+/** a table of tanks with every command, spread over distances that cover full
+    moves, partial moves, and huge coordinates. */
+struct result_void make_movement_test_table(struct tank_table *table) {
+    make_tank_table(table);
+
+    // a fixed seed, so that a failure can be reproduced.
+    srand(1234);
+
+    // not a multiple of 8, so the vector kernels have a scalar tail.
+    for (u32 i = 0; i < 10007; i++) {
+        s32 range = i % 3 == 0 ? 8 : i % 3 == 1 ? 1000 : 1 << 30;
+        struct tank tank = {
+            .cmd = i % 5 == 0 ? TANK_HEAL : i % 7 == 0 ? TANK_FIRE : TANK_MOVE,
+            .pos = { rand() % range - range / 2, rand() % range - range / 2 },
+            .move_to = { rand() % range - range / 2, rand() % range - range / 2 },
+        };
+        tank.aim_at = tank.move_to;
+
+        RESULT_CALL(void, tank_table_push(table, &tank));
+    }
+
+    // moves along the axes, and ones whose steps are whole numbers.
+    struct coord exact[] = {{1, 0}, {10, 0}, {0, -10}, {-30, 40}, {6, 8}};
+    for (size_t i = 0; i < sizeof(exact) / sizeof(exact[0]); i++) {
+        struct tank tank = { .cmd = TANK_MOVE, .move_to = exact[i] };
+        RESULT_CALL(void, tank_table_push(table, &tank));
+    }
+
+    return result_void_ok(0);
+}
+
+struct result_void tst_move_kernels_match(void) {
+    struct tank_table expected;
+    struct result_void error = make_movement_test_table(&expected);
+    if (error.status == RESULT_ERROR) {
+        free_tank_table(&expected);
+        return error;
+    }
+
+    // a few ticks, so that tanks arrive and partial moves continue.
+    for (int tick = 0; tick < 4; tick++)
+        tank_table_move_with(&expected, TANK_KERNEL_SCALAR);
+
+    for (enum tank_kernel k = TANK_KERNEL_SSE2; k < TANK_KERNEL_COUNT; k++) {
+        if (!tank_kernel_supported(k))
+            continue;
+
+        struct tank_table table;
+        error = make_movement_test_table(&table);
+
+        for (int tick = 0; tick < 4 && error.status == RESULT_OK; tick++)
+            tank_table_move_with(&table, k);
+
+        for (u32 id = 0; id < table.len && error.status == RESULT_OK; id++) {
+            if (table.pos_x[id] != expected.pos_x[id] ||
+                table.pos_y[id] != expected.pos_y[id])
+                error = fail_msg("kernel %d moved tank %u to (%d, %d), the "
+                                 "scalar kernel moved it to (%d, %d)", k, id,
+                                 table.pos_x[id], table.pos_y[id],
+                                 expected.pos_x[id], expected.pos_y[id]);
+        }
+
+        free_tank_table(&table);
+        if (error.status == RESULT_ERROR)
+            break;
+    }
+
+    free_tank_table(&expected);
+    return error;
+}
+
+struct result_void tst_move_scalar(void) {
+    struct tank_table table;
+    make_tank_table(&table);
+
+    struct tank tanks[] = {
+        // arrives.
+        { .cmd = TANK_MOVE, .pos = {0, 0}, .move_to = {3, 4} },
+        // moves TANK_MAX_SPEED towards the target.
+        { .cmd = TANK_MOVE, .pos = {0, 0}, .move_to = {30, 40} },
+        // stays put.
+        { .cmd = TANK_HEAL, .pos = {1, 1}, .move_to = {30, 40} },
+    };
+    struct coord expected[] = {{3, 4}, {3, 4}, {1, 1}};
+
+    struct result_void error = no_error();
+    for (size_t i = 0; i < sizeof(tanks) / sizeof(tanks[0]); i++) {
+        error = tank_table_push(&table, &tanks[i]);
+        if (error.status == RESULT_ERROR)
+            goto cleanup_return;
+    }
+
+    tank_table_move_with(&table, TANK_KERNEL_SCALAR);
+
+    for (u32 id = 0; id < table.len; id++) {
+        if (table.pos_x[id] != expected[id].x ||
+            table.pos_y[id] != expected[id].y) {
+            error = fail_msg("tank %u moved to (%d, %d), expected (%d, %d)",
+                             id, table.pos_x[id], table.pos_y[id],
+                             expected[id].x, expected[id].y);
+            goto cleanup_return;
+        }
+    }
+
+ cleanup_return:
+    free_tank_table(&table);
+    return error;
+}
+
+/******************************** TICK PASSES *********************************/
+#define PASS_TEST_TANKS 2000
+#define PASS_TEST_SLOTS 4
+
+/** tanks crowded close enough that most shots hit someone. */
+struct result_void make_pass_test_table(struct tank_table *table) {
+    make_tank_table(table);
+    srand(4321);
+
+    for (u32 i = 0; i < PASS_TEST_TANKS; i++) {
+        struct tank tank = {
+            .health = 100,
+            .cmd = i % 3 == 0 ? TANK_HEAL : i % 3 == 1 ? TANK_FIRE : TANK_MOVE,
+            .pos = { rand() % 20, rand() % 20 },
+            .move_to = { rand() % 20, rand() % 20 },
+        };
+        tank.aim_at = tank.move_to;
+
+        RESULT_CALL(void, tank_table_push(table, &tank));
+    }
+
+    return result_void_ok(0);
+}
+
+/** runs a tick's passes over chunks of `grain` tanks, like the server's
+    workers do, gathering the `c`th chunk's shots into slot `c % slots`. */
+struct result_void run_chunked_tick(struct tank_table *table,
+                                    struct spatial_grid *grid,
+                                    u32 **damage, u32 grain, u32 slots) {
+    RESULT_CALL(void, spatial_grid_reset(grid, table->len));
+    for (u32 id = 0; id < table->len; id++) {
+        struct coord pos = { table->pos_x[id], table->pos_y[id] };
+        spatial_grid_insert(grid, id, pos);
+    }
+
+    for (u32 first = 0; first < table->len; first += grain) {
+        u32 last = first + grain < table->len ? first + grain : table->len;
+        tank_table_heal(table, first, last);
+        tank_table_fire(table, grid, first, last, damage[first / grain % slots]);
+    }
+
+    for (u32 first = 0; first < table->len; first += grain) {
+        u32 last = first + grain < table->len ? first + grain : table->len;
+        tank_table_apply_damage(table, first, last, damage, slots);
+        tank_table_move_range(table, first, last);
+    }
+
+    return no_error();
+}
+
+struct result_void tst_tick_passes_deterministic(void) {
+    struct { u32 grain, slots; } splits[] = {
+        {PASS_TEST_TANKS, 1}, {1, PASS_TEST_SLOTS}, {7, 3}, {64, 2},
+        {1000, PASS_TEST_SLOTS},
+    };
+    size_t num_splits = sizeof(splits) / sizeof(splits[0]);
+
+    struct tank_table tables[num_splits];
+    struct spatial_grid grid;
+    u32 *damage[PASS_TEST_SLOTS] = {0};
+
+    for (size_t s = 0; s < num_splits; s++)
+        make_tank_table(&tables[s]);
+
+    struct result_void error = make_spatial_grid(&grid, TANK_FIRE_DISTANCE);
+    if (error.status == RESULT_ERROR)
+        return error;
+
+    for (size_t d = 0; d < PASS_TEST_SLOTS; d++) {
+        damage[d] = calloc(PASS_TEST_TANKS, sizeof(u32));
+        if (damage[d] == NULL) {
+            error = fail_msg("failed to allocate damage");
+            goto cleanup_return;
+        }
+    }
+
+    for (size_t s = 0; s < num_splits; s++) {
+        error = make_pass_test_table(&tables[s]);
+        for (int tick = 0; tick < 3 && error.status == RESULT_OK; tick++)
+            error = run_chunked_tick(&tables[s], &grid, damage,
+                                     splits[s].grain, splits[s].slots);
+        if (error.status == RESULT_ERROR)
+            goto cleanup_return;
+    }
+
+    // the first split runs the whole table at once.
+    struct tank_table *expected = &tables[0];
+    for (size_t s = 1; s < num_splits; s++) {
+        for (u32 id = 0; id < expected->len; id++) {
+            if (tables[s].health[id] != expected->health[id] ||
+                tables[s].pos_x[id] != expected->pos_x[id] ||
+                tables[s].pos_y[id] != expected->pos_y[id]) {
+                error = fail_msg("tank %u differs in chunks of %u over %u "
+                                 "slots", id, splits[s].grain,
+                                 splits[s].slots);
+                goto cleanup_return;
+            }
+        }
+    }
+
+    // the tanks are close enough that shots landed.
+    bool hit = false;
+    for (u32 id = 0; id < expected->len; id++)
+        hit |= expected->health[id] != 100;
+    if (!hit)
+        error = fail_msg("no tank was hit");
+
+ cleanup_return:
+    for (size_t d = 0; d < PASS_TEST_SLOTS; d++)
+        free(damage[d]);
+    for (size_t s = 0; s < num_splits; s++)
+        free_tank_table(&tables[s]);
+    free_spatial_grid(&grid);
+    return error;
+}
+
+/*********************************** ID MAP ***********************************/
+#define ID_MAP_TEST_IDS 1000
+
+struct result_void tst_id_map(void) {
+    struct id_map map;
+    RESULT_CALL(void, make_id_map(&map));
+
+    // ids are handed out in order, and players leave from anywhere.
+    struct result_void error = no_error();
+    for (u32 id = 0; id < ID_MAP_TEST_IDS && error.status == RESULT_OK; id++)
+        error = id_map_set(&map, id, id * 3);
+
+    u32 removed = 0;
+    for (u32 id = 0; id < ID_MAP_TEST_IDS; id += 3, removed++)
+        id_map_remove(&map, id);
+
+    for (u32 id = 0; id < ID_MAP_TEST_IDS && error.status == RESULT_OK; id++) {
+        u32 want = id % 3 == 0 ? ID_MAP_NONE : id * 3;
+        if (id_map_get(&map, id) != want)
+            error = fail_msg("id %u maps to %u, not %u", id,
+                             id_map_get(&map, id), want);
+    }
+
+    // values are replaced, and a removed id can come back.
+    if (error.status == RESULT_OK)
+        error = id_map_set(&map, 1, 7);
+    if (error.status == RESULT_OK)
+        error = id_map_set(&map, 3, 8);
+    if (error.status == RESULT_OK &&
+        (id_map_get(&map, 1) != 7 || id_map_get(&map, 3) != 8 ||
+         id_map_get(&map, ID_MAP_TEST_IDS) != ID_MAP_NONE ||
+         map.len != ID_MAP_TEST_IDS - removed + 1))
+        error = fail_msg("%u ids left in the map", map.len);
+
+    free_id_map(&map);
+    return error;
+}
+
+/*********************************** ARENA ************************************/
+#define ARENA_TEST_ALLOCS 100
+
+struct result_void tst_arena(void) {
+    struct arena arena;
+    RESULT_CALL(void, make_arena(&arena, 64));
+
+    // a tick's worth of allocations overflows the first block.
+    struct result_void error = no_error();
+    for (int tick = 0; tick < 3 && error.status == RESULT_OK; tick++) {
+        arena_reset(&arena);
+
+        u8 *bytes[ARENA_TEST_ALLOCS];
+        u64 *words[ARENA_TEST_ALLOCS];
+        for (int i = 0; i < ARENA_TEST_ALLOCS && error.status == RESULT_OK;
+             i++) {
+            bytes[i] = arena_new(&arena, u8, 3);
+            words[i] = arena_new(&arena, u64, 2);
+            if (bytes[i] == NULL || words[i] == NULL)
+                error = fail_msg("allocation %d failed", i);
+            else if ((uintptr_t)words[i] % _Alignof(u64) != 0)
+                error = fail_msg("allocation %d is misaligned", i);
+            else {
+                memset(bytes[i], i, 3);
+                words[i][0] = words[i][1] = i;
+            }
+        }
+
+        // nothing overlaps.
+        for (int i = 0; i < ARENA_TEST_ALLOCS && error.status == RESULT_OK;
+             i++) {
+            if (bytes[i][0] != (u8)i || bytes[i][2] != (u8)i ||
+                words[i][0] != (u64)i || words[i][1] != (u64)i)
+                error = fail_msg("allocation %d was overwritten", i);
+        }
+
+        // once it's been reset, the arena is one block that fits a whole
+        // tick, so every allocation follows the one before it.
+        for (int i = 1; i < ARENA_TEST_ALLOCS && error.status == RESULT_OK &&
+                 tick > 0; i++) {
+            if (bytes[i] != (u8 *)&words[i - 1][2] ||
+                (u8 *)words[i] != bytes[i] + sizeof(u64))
+                error = fail_msg("allocation %d isn't in the same block", i);
+        }
+    }
+
+    free_arena(&arena);
+    return error;
+}
+
+/******************************** TICK DELTAS *********************************/
+#define VIEW_TEST_PLAYERS 3
+#define VIEW_TEST_TANKS 4
+
+struct result_void tst_view_collect(void) {
+    // player 10's tanks are in a row from (0, 0) to (30, 0).  Two of player
+    // 11's tanks are at the edge of their range, one just beyond it, and
+    // player 12 is far away.
+    struct coord positions[VIEW_TEST_PLAYERS * VIEW_TEST_TANKS] = {
+        {0, 0}, {10, 0}, {20, 0}, {30, 0},
+        {30 + TANK_SENSOR_RANGE, 0}, {31 + TANK_SENSOR_RANGE, 0},
+        {-TANK_SENSOR_RANGE, 0}, {200, 200},
+        {1000, 1000}, {1001, 1000}, {1002, 1000}, {1003, 1000},
+    };
+    u32 health[VIEW_TEST_PLAYERS * VIEW_TEST_TANKS];
+    for (u32 id = 0; id < VIEW_TEST_PLAYERS * VIEW_TEST_TANKS; id++)
+        health[id] = id * 5;
+    u32 player_ids[VIEW_TEST_PLAYERS] = {10, 11, 12};
+
+    struct spatial_grid grid;
+    RESULT_CALL(void, make_spatial_grid(&grid, TANK_SENSOR_RANGE));
+
+    struct result_void error = spatial_grid_reset(&grid,
+                                                  VIEW_TEST_PLAYERS *
+                                                  VIEW_TEST_TANKS);
+    if (error.status == RESULT_ERROR) {
+        free_spatial_grid(&grid);
+        return error;
+    }
+    for (u32 id = 0; id < VIEW_TEST_PLAYERS * VIEW_TEST_TANKS; id++)
+        spatial_grid_insert(&grid, id, positions[id]);
+
+    struct tank_view_source src = {
+        .grid = &grid,
+        .health = health,
+        .player_ids = player_ids,
+        .num_players = VIEW_TEST_PLAYERS,
+        .tanks_per_player = VIEW_TEST_TANKS,
+    };
+    struct vector *scratch = make_vector(sizeof(u32), 16);
+    struct vector *view = make_vector(sizeof(struct tank_delta), 16);
+
+    struct tank_delta first_sees[] = {
+        {10, 0, {0, 0}, 0}, {10, 1, {10, 0}, 5},
+        {10, 2, {20, 0}, 10}, {10, 3, {30, 0}, 15},
+        {11, 0, {30 + TANK_SENSOR_RANGE, 0}, 20},
+        {11, 2, {-TANK_SENSOR_RANGE, 0}, 30},
+    };
+    error = tank_view_collect(&src, 0, scratch, view);
+    if (error.status == RESULT_OK &&
+        (vec_len(view) != sizeof(first_sees) / sizeof(first_sees[0]) ||
+         memcmp(vec_dat(view), first_sees, sizeof(first_sees)) != 0)) {
+        error = fail_msg("player 10 sees %zu tanks", vec_len(view));
+        goto cleanup_return;
+    }
+
+    // players always see their own tanks, even with no one else around.
+    if (error.status == RESULT_OK)
+        error = tank_view_collect(&src, 2, scratch, view);
+    if (error.status == RESULT_OK &&
+        (vec_len(view) != VIEW_TEST_TANKS ||
+         ((struct tank_delta *)vec_ref(view, 0))->player_id != 12))
+        error = fail_msg("player 12 sees %zu tanks", vec_len(view));
+
+ cleanup_return:
+    free_vector(scratch);
+    free_vector(view);
+    free_spatial_grid(&grid);
+    return error;
+}
+
+struct result_void tst_view_diff(void) {
+    struct tank_delta was_tanks[] = {
+        {10, 0, {0, 0}, 100}, {10, 1, {1, 0}, 100},
+        {11, 0, {5, 5}, 100}, {11, 2, {7, 7}, 100},
+    };
+    // 10's 2nd tank moves, 11's 3rd is hit, its 1st goes out of view, and
+    // one of 12's tanks comes into view.
+    struct tank_delta now_tanks[] = {
+        {10, 0, {0, 0}, 100}, {10, 1, {2, 0}, 100},
+        {11, 2, {7, 7}, 50}, {12, 3, {9, 9}, 100},
+    };
+
+    struct vector *was = make_vector(sizeof(struct tank_delta), 4);
+    struct vector *now = make_vector(sizeof(struct tank_delta), 4);
+    struct vector *changes = make_vector(sizeof(struct tank_delta), 4);
+    struct vector *removals = make_vector(sizeof(struct tank_key), 4);
+    struct vector *new_players = make_vector(sizeof(u32), 4);
+    struct vector *players = make_vector(sizeof(u32), 4);
+    vec_pushn(was, was_tanks, 4);
+    vec_pushn(now, now_tanks, 4);
+
+    struct tank_delta expected_changes[] = {
+        now_tanks[1], now_tanks[2], now_tanks[3],
+    };
+    struct tank_key expected_removal = {11, 0};
+    u32 expected_players[] = {10, 11, 12};
+
+    struct result_void error = no_error();
+    if (tank_view_diff(was, now, changes, removals, new_players) < 0 ||
+        tank_view_players(now, players) < 0)
+        error = fail_msg("failed to diff views");
+    else if (vec_len(changes) != 3 ||
+             memcmp(vec_dat(changes), expected_changes,
+                    sizeof(expected_changes)) != 0)
+        error = fail_msg("expected 3 changes, got %zu", vec_len(changes));
+    else if (vec_len(removals) != 1 ||
+             memcmp(vec_dat(removals), &expected_removal,
+                    sizeof(expected_removal)) != 0)
+        error = fail_msg("expected 1 removal, got %zu", vec_len(removals));
+    else if (vec_len(new_players) != 1 ||
+             *(u32 *)vec_ref(new_players, 0) != 12)
+        error = fail_msg("expected only player 12 to be new");
+    else if (vec_len(players) != 3 ||
+             memcmp(vec_dat(players), expected_players,
+                    sizeof(expected_players)) != 0)
+        error = fail_msg("expected 3 players in view, got %zu",
+                         vec_len(players));
+
+    free_vector(was);
+    free_vector(now);
+    free_vector(changes);
+    free_vector(removals);
+    free_vector(new_players);
+    free_vector(players);
+    return error;
+}
+
+/** encodes the tick, and reads it back. */
+struct result_scenario_tick round_trip_tick(const struct scenario_tick *tick,
+                                            enum message_encoding encoding,
+                                            const struct allocator *alloc) {
+    vector *bytes;
+    RESULT_UNWRAP(scenario_tick, bytes,
+                  make_scenario_tick_message(tick, encoding));
+
+    int fd[2];
+    if (pipe(fd) < 0) {
+        free_vector(bytes);
+        return result_scenario_tick_error(make_msg_error("couldn't pipe"));
+    }
+
+    // the ticks are small enough to fit in the pipe's buffer.
+    ssize_t written = write(fd[1], vec_dat(bytes), vec_len(bytes));
+    close(fd[1]);
+    free_vector(bytes);
+
+    struct message_reader *reader = make_message_reader();
+    struct result_sexp msg = result_sexp_ok(NULL);
+    while (written > 0 && msg.status == RESULT_OK && msg.ok == NULL &&
+           !reader->closed)
+        msg = message_recv(fd[0], reader);
+    close(fd[0]);
+
+    struct result_scenario_tick r;
+    if (msg.status == RESULT_ERROR)
+        r = result_scenario_tick_error(msg.error);
+    else if (msg.ok == NULL)
+        r = result_scenario_tick_error(make_msg_error("no message read"));
+    else
+        r = unwrap_scenario_tick_message_in(msg.ok, alloc);
+
+    if (msg.status == RESULT_OK)
+        free_sexp(msg.ok);
+    free_message_reader(reader);
+    return r;
+}
+
+/** whether a tick's vectors hold the same elements as `want`'s. */
+bool tick_vectors_match(const struct vector *got, const struct vector *want) {
+    return vec_len(got) == vec_len(want) &&
+        memcmp(vec_ref(got, 0), vec_ref(want, 0),
+               vec_len(want) * vec_element_len(want)) == 0;
+}
+
+struct result_void tst_tick_message_round_trip(void) {
+    struct tick_player named[] = { {10, "alice"}, {11, "bob"}, {12, "carol"} };
+    struct tank_delta tanks[] = {
+        {10, 0, {0, 0}, 100}, {10, 35, {-5, 1 << 20}, 40}, {11, 3, {7, 7}, 0},
+    };
+    struct tank_key gone = {11, 3};
+
+    struct scenario_tick keyframe = {
+        .tick_number = 300, .keyframe = true,
+        .players = make_vector(sizeof(struct tick_player), 2),
+        .changes = make_vector(sizeof(struct tank_delta), 3),
+        .removals = make_vector(sizeof(struct tank_key), 1),
+    };
+    vec_pushn(keyframe.players, named, 2);
+    vec_pushn(keyframe.changes, tanks, 3);
+
+    struct scenario_tick delta = {
+        .tick_number = 301, .base_tick = 300,
+        .players = make_vector(sizeof(struct tick_player), 1),
+        .changes = make_vector(sizeof(struct tank_delta), 1),
+        .removals = make_vector(sizeof(struct tank_key), 1),
+    };
+    vec_push(delta.players, &named[2]);
+    vec_push(delta.changes, &tanks[1]);
+    vec_push(delta.removals, &gone);
+
+    // deltas are read into an arena, as the client reads them.
+    struct arena arena;
+    struct result_void error = make_arena(&arena, 64);
+    struct allocator arena_alloc = arena_allocator(&arena);
+
+    for (int e = MESSAGE_ENCODING_TEXT;
+         e <= MESSAGE_ENCODING_BINARY && error.status == RESULT_OK; e++) {
+        struct result_scenario_tick r = round_trip_tick(&keyframe, e,
+                                                        &g_system_allocator);
+        if (r.status == RESULT_ERROR) {
+            error = result_void_error(r.error);
+            break;
+        }
+
+        struct scenario_tick got = r.ok;
+        if (!got.keyframe || got.tick_number != 300 ||
+            !tick_vectors_match(got.players, keyframe.players) ||
+            !tick_vectors_match(got.changes, keyframe.changes))
+            error = fail_msg("keyframe %u came back wrong, in encoding %d",
+                             got.tick_number, e);
+
+        free_scenario_tick(got);
+        if (error.status == RESULT_ERROR)
+            break;
+
+        arena_reset(&arena);
+        r = round_trip_tick(&delta, e, &arena_alloc);
+        if (r.status == RESULT_ERROR) {
+            error = result_void_error(r.error);
+            break;
+        }
+
+        got = r.ok;
+        if (got.keyframe || got.tick_number != 301 || got.base_tick != 300 ||
+            !tick_vectors_match(got.players, delta.players) ||
+            !tick_vectors_match(got.changes, delta.changes) ||
+            !tick_vectors_match(got.removals, delta.removals))
+            error = fail_msg("delta came back wrong, in encoding %d", e);
+
+        free_scenario_tick(got);
+        if (error.status == RESULT_ERROR)
+            break;
+    }
+
+    free_arena(&arena);
+    free_scenario_tick(keyframe);
+    free_scenario_tick(delta);
+    return error;
+}
+
+/** reads `bytes` from a pipe until a message, an error, or the reader gives
+    up on the peer.  `*closed` is set if it did.  The bytes are written by a
+    child process, since they may not fit in the pipe's buffer. */
+struct result_sexp recv_test_bytes(const void *bytes, size_t length,
+                                   bool *closed) {
+    int fd[2];
+    if (pipe(fd) < 0)
+        return RESULT_MSG_ERROR(sexp, "couldn't pipe");
+
+    pid_t writer = fork();
+    if (writer < 0) {
+        close(fd[0]);
+        close(fd[1]);
+        return RESULT_MSG_ERROR(sexp, "couldn't fork");
+    }
+
+    if (writer == 0) {
+        close(fd[0]);
+        for (size_t sent = 0; sent < length;) {
+            ssize_t n = write(fd[1], (const u8 *)bytes + sent, length - sent);
+            if (n <= 0)
+                _exit(1);
+            sent += n;
+        }
+        _exit(0);
+    }
+    close(fd[1]);
+
+    struct message_reader *reader = make_message_reader();
+    struct result_sexp msg = result_sexp_ok(NULL);
+    while (msg.status == RESULT_OK && msg.ok == NULL && !reader->closed)
+        msg = message_recv(fd[0], reader);
+
+    // a writer that was refused dies of a broken pipe.
+    close(fd[0]);
+    waitpid(writer, NULL, 0);
+
+    *closed = reader->closed;
+    free_message_reader(reader);
+    return msg;
+}
+
+struct result_void tst_message_too_long(void) {
+    struct scenario_tick tick = {0};
+    tick.players = make_vector(sizeof(struct tick_player), 1);
+    tick.changes = make_vector(sizeof(struct tank_delta), 1);
+    tick.removals = make_vector(sizeof(struct tank_key), 1);
+
+    // a binary tick's type byte, with a body one byte too long.
+    struct result_vec tick_r =
+        make_scenario_tick_message(&tick, MESSAGE_ENCODING_BINARY);
+    free_scenario_tick(tick);
+    if (tick_r.status == RESULT_ERROR)
+        return result_void_error(tick_r.error);
+
+    u8 header[1 + SEXP_BINARY_VARINT_MAX];
+    header[0] = *(u8 *)vec_dat(tick_r.ok);
+    free_vector(tick_r.ok);
+
+    u32 n = sexp_binary_put_varint(header + 1, MESSAGE_MAX_SIZE);
+
+    bool closed;
+    struct result_sexp r = recv_test_bytes(header, 1 + n, &closed);
+    if (r.status == RESULT_OK) {
+        free_sexp(r.ok);
+        return fail_msg("a message longer than the limit was accepted");
+    }
+    free_error(r.error);
+
+    if (!closed)
+        return fail_msg("the peer wasn't dropped");
+
+    return no_error();
+}
+
+struct result_void tst_unfinished_message_too_long(void) {
+    // a list that is never closed, one byte longer than the limit.
+    size_t length = MESSAGE_MAX_SIZE + 1;
+    char *text = malloc(length);
+    if (text == NULL)
+        return fail_msg("couldn't allocate the message");
+
+    memset(text, 'A', length);
+    text[0] = '(';
+
+    bool closed;
+    struct result_sexp r = recv_test_bytes(text, length, &closed);
+    free(text);
+    if (r.status == RESULT_OK) {
+        free_sexp(r.ok);
+        return fail_msg("a message longer than the limit was buffered");
+    }
+    free_error(r.error);
+
+    if (!closed)
+        return fail_msg("the peer wasn't dropped");
+
+    return no_error();
+}
+
+struct result_void tst_netstring_too_long(void) {
+    const char text[] = "(PLAYER-UPDATE 4294967296:";
+
+    bool closed;
+    struct result_sexp r = recv_test_bytes(text, strlen(text), &closed);
+    if (r.status == RESULT_OK) {
+        free_sexp(r.ok);
+        return fail_msg("a netstring longer than the limit was accepted");
+    }
+    free_error(r.error);
+
+    if (!closed)
+        return fail_msg("the peer wasn't dropped");
+
+    return no_error();
+}
+
+struct result_void tst_signed_netstring_length(void) {
+    // the length isn't all digits, so it's a symbol, not a 9 byte netstring
+    // that runs past the end of the message.
+    const char text[] = "(+9:a)";
+
+    bool closed;
+    struct result_sexp r = recv_test_bytes(text, strlen(text), &closed);
+    if (r.status == RESULT_ERROR)
+        return result_void_error(r.error);
+    if (r.ok == NULL)
+        return fail_msg("the message was never completed");
+
+    struct result_void error = no_error();
+    struct result_sexp_view view = sexp_view_val(sexp_nth(r.ok, 0).ok);
+    if (view.status == RESULT_ERROR)
+        error = result_void_error(view.error);
+    else if (view.ok.length != 4 || memcmp(view.ok.str, "+9:A", 4) != 0)
+        error = fail_msg("the atom was read as '%.*s'", (int)view.ok.length,
+                         view.ok.str);
+
+    free_sexp(r.ok);
+    return error;
+}
+
+/******************************* TICK SCHEDULER *******************************/
+#define TEST_PERIOD 1000
+
+/** runs one tick from `start` to `end`, and returns whether to catch up. */
+bool run_test_tick(struct tick_scheduler *sched, u64 start, u64 end) {
+    tick_scheduler_begin(sched, start);
+    return tick_scheduler_end(sched, end);
+}
+
+struct result_void tst_tick_schedule_no_drift(void) {
+    struct tick_scheduler sched;
+    struct tick_config config = { TEST_PERIOD, TICK_OVERRUN_SKIP };
+    make_tick_scheduler(&sched, config, 0);
+
+    // each tick starts a little late, and takes most of a period.
+    for (u64 n = 1; n <= 100; n++) {
+        u64 deadline = n * TEST_PERIOD;
+        if (sched.deadline_ns != deadline)
+            return fail_msg("tick %lu was due at %lu, expected %lu",
+                            n, sched.deadline_ns, deadline);
+
+        if (run_test_tick(&sched, deadline + 10, deadline + 900))
+            return fail_msg("tick %lu caught up without an overrun", n);
+    }
+
+    struct tick_stats stats = tick_scheduler_take_stats(&sched);
+    if (stats.ticks != 100 || stats.overruns != 0 ||
+        stats.jitter_min_ns != 10 || stats.jitter_max_ns != 10 ||
+        stats.jitter_total_ns != 1000)
+        return fail_msg("unexpected stats: %lu ticks, %lu overruns, jitter "
+                        "%lu/%lu/%lu", stats.ticks, stats.overruns,
+                        stats.jitter_min_ns, stats.jitter_total_ns,
+                        stats.jitter_max_ns);
+
+    return no_error();
+}
+
+struct result_void tst_tick_overrun_policies(void) {
+    struct tick_scheduler sched;
+
+    // the first tick is due at 1000, and runs until 3500, missing the
+    // deadlines at 2000 and 3000.
+    make_tick_scheduler(&sched, (struct tick_config) {
+            TEST_PERIOD, TICK_OVERRUN_SKIP }, 0);
+    if (run_test_tick(&sched, 1000, 3500) || sched.deadline_ns != 4000 ||
+        sched.stats.skipped != 2)
+        return fail_msg("skip: next deadline %lu, %lu skipped",
+                        sched.deadline_ns, sched.stats.skipped);
+
+    make_tick_scheduler(&sched, (struct tick_config) {
+            TEST_PERIOD, TICK_OVERRUN_SLOW }, 0);
+    if (run_test_tick(&sched, 1000, 3500) || sched.deadline_ns != 4500 ||
+        sched.stats.skipped != 0)
+        return fail_msg("slow: next deadline %lu, %lu skipped",
+                        sched.deadline_ns, sched.stats.skipped);
+
+    // the missed ticks run right away, each due a period after the last.
+    make_tick_scheduler(&sched, (struct tick_config) {
+            TEST_PERIOD, TICK_OVERRUN_CATCH_UP }, 0);
+    if (!run_test_tick(&sched, 1000, 3500) || sched.deadline_ns != 2000)
+        return fail_msg("catch-up: next deadline %lu, expected to catch up",
+                        sched.deadline_ns);
+    if (!run_test_tick(&sched, 3500, 3600) || sched.deadline_ns != 3000)
+        return fail_msg("catch-up: second tick due at %lu", sched.deadline_ns);
+    if (run_test_tick(&sched, 3600, 3700) || sched.deadline_ns != 4000)
+        return fail_msg("catch-up: caught up, but due at %lu",
+                        sched.deadline_ns);
+
+    // a scenario that never keeps up only catches up TICK_MAX_CATCH_UP times
+    // in a row.
+    make_tick_scheduler(&sched, (struct tick_config) {
+            TEST_PERIOD, TICK_OVERRUN_CATCH_UP }, 0);
+    u64 now = 1000;
+    int caught_up = 0;
+    while (run_test_tick(&sched, now, now + 2 * TEST_PERIOD)) {
+        now += 2 * TEST_PERIOD;
+        if (++caught_up > TICK_MAX_CATCH_UP)
+            return fail_msg("caught up more than %d times in a row",
+                            TICK_MAX_CATCH_UP);
+    }
+
+    if (caught_up != TICK_MAX_CATCH_UP || sched.deadline_ns <= now)
+        return fail_msg("caught up %d times, then due at %lu, in the past",
+                        caught_up, sched.deadline_ns);
+
+    return no_error();
+}
+
+struct test g_all_tests[] = {
+    {"spatial grid find", &tst_grid_find},
+    {"spatial grid radius query", &tst_grid_query_radius},
+    {"spatial grid queries at the edge of the map", &tst_grid_query_edges},
+    {"tank table remove", &tst_tank_table_remove},
+    {"scalar movement", &tst_move_scalar},
+    {"vector movement matches scalar", &tst_move_kernels_match},
+    {"tick passes don't depend on the split", &tst_tick_passes_deterministic},
+    {"id map lookups", &tst_id_map},
+    {"arena allocations don't overlap", &tst_arena},
+    {"players only see tanks in sensor range", &tst_view_collect},
+    {"view deltas only carry changes", &tst_view_diff},
+    {"tick messages round trip", &tst_tick_message_round_trip},
+    {"messages longer than the limit are refused", &tst_message_too_long},
+    {"netstrings longer than the limit are refused", &tst_netstring_too_long},
+    {"netstring lengths are only digits", &tst_signed_netstring_length},
+    {"unfinished messages aren't buffered past the limit",
+     &tst_unfinished_message_too_long},
+    {"tick schedule doesn't drift", &tst_tick_schedule_no_drift},
+    {"tick overrun policies", &tst_tick_overrun_policies},
+};
+
+int main(int argc, char **argv) {
+    (void)argc;
+    (void)argv;
+
+    size_t num_tests = sizeof(g_all_tests)/sizeof(struct test);
+    run_test_suite(g_all_tests, num_tests, "scenario tests");
+
+    return 0;
+}
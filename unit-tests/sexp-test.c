@@ -7,6 +7,8 @@
 #include "nonstdint.h"
 #include "vector.h"
 #include <ctype.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -86,6 +88,10 @@ const char* g_reader_log_filepath  = "unit-tests/sexp-tests/reader-log.org";
 vector *g_reader_test_file;
 vector *g_reader_test_file_line_cache;
 
+// the reader tests are run once for every memory method.
+enum sexp_memory_method g_reader_memory_method;
+size_t g_reader_current_line;
+
 /**
  takes a line, and if it contains an org description list-item, it returns the
  description.
@@ -141,7 +147,7 @@ const char* org_item_description(const char* line, const char* item) {
  * on a reader error.
  */
 struct result_void tst_reader(void) {
-    static size_t current_line = 0;
+    size_t current_line = g_reader_current_line;
     struct result_void general_result = no_error();
 
     FILE* log_file = fopen(g_reader_log_filepath, "a+");
@@ -195,7 +201,7 @@ struct result_void tst_reader(void) {
         char *error_source = NULL;
         char *out_str = "";
 
-        struct result_sexp result_in = sexp_read(input_str, SEXP_MEMORY_TREE);
+        struct result_sexp result_in = sexp_read(input_str, g_reader_memory_method);
         struct sexp* sexp = NULL;
         if (result_in.status == RESULT_ERROR) {
             // READER ERROR
@@ -257,22 +263,20 @@ struct result_void tst_reader(void) {
     }
 
     // find the next line that has a > on it.
+    g_reader_current_line = current_line;
     fclose(log_file);
     return general_result;
 }
 
-void run_reader_test_suite() {    
+void run_reader_test_suite(enum sexp_memory_method method,
+                           const char *suite_name) {    
     // open and load test file
     open_test_file(g_reader_test_filepath,
                    &g_reader_test_file,
                    &g_reader_test_file_line_cache);
 
-    FILE* log_file = fopen(g_reader_log_filepath, "w");
-    if (log_file == NULL) {
-        printf("couldn't open log file to reset it!\n");
-        return;
-    }
-    fclose(log_file);
+    g_reader_memory_method = method;
+    g_reader_current_line = 0;
     
     vector* buffer = g_reader_test_file;
     vector* line_cache = g_reader_test_file_line_cache;
@@ -305,17 +309,714 @@ void run_reader_test_suite() {
             break;
     }
 
-    run_test_suite(tests, headings, "SEXP reader tests");
+    run_test_suite(tests, headings, suite_name);
 
     free_vector(buffer);
     free_vector(line_cache);
 }
 
+/************************* LINEAR LAYOUT TESTS ********************************/
+/** compares the serialized form of `s` to `expected`, and frees `s`. */
+struct result_void linear_expect(sexp *s, const char *expected) {
+    struct result_str str = sexp_serialize(s);
+    free_sexp(s);
+
+    if (str.status == RESULT_ERROR)
+        return result_void_error(str.error);
+
+    struct result_void r = no_error();
+    if (strcmp(str.ok, expected) != 0)
+        r = fail_msg("expected %s, got %s", expected, str.ok);
+
+    free(str.ok);
+    return r;
+}
+
+struct result_void tst_linear_push(void) {
+    sexp *list;
+    RESULT_UNWRAP(void, list, make_sexp(SEXP_CONS, SEXP_MEMORY_LINEAR, NULL));
+
+    RESULT_CALL(void, sexp_push_integer(list, 1));
+    RESULT_CALL(void, sexp_push_string(list, "two"));
+    RESULT_CALL(void, sexp_push_symbol(list, "THREE"));
+
+    return linear_expect(list, "(1 \"two\" THREE)");
+}
+
+struct result_void tst_linear_nested_push(void) {
+    sexp *list;
+    RESULT_UNWRAP(void, list, make_sexp(SEXP_CONS, SEXP_MEMORY_LINEAR, NULL));
+
+    // the inner list grows after the outer list already has elements after it.
+    // pushing can move the block, so only the handle and the returned cons
+    // are valid afterwards.
+    sexp *cons;
+    RESULT_UNWRAP(void, cons, sexp_push_nil(list));
+    RESULT_UNWRAP(void, cons, sexp_push_integer(cons, 3));
+
+    sexp *inner;
+    RESULT_UNWRAP(void, inner, sexp_car(list));
+    RESULT_UNWRAP(void, cons, sexp_push_integer(inner, 1));
+    RESULT_CALL(void, sexp_push_integer(cons, 2));
+
+    return linear_expect(list, "((1 2) 3)");
+}
+
+struct result_void tst_linear_accessors(void) {
+    sexp *s;
+    RESULT_UNWRAP(void, s,
+                  sexp_read("(a (b \"c\") [t]d 42)", SEXP_MEMORY_LINEAR));
+
+    struct result_void r = no_error();
+    u32 length = sexp_length(s).ok;
+    if (length != 4) {
+        r = fail_msg("expected length 4, got %u", length);
+        goto cleanup;
+    }
+
+    struct result_sexp inner = sexp_nth(s, 1);
+    const char *str = NULL;
+    if (inner.status == RESULT_OK)
+        inner = sexp_nth(inner.ok, 1);
+    if (inner.status == RESULT_OK)
+        str = sexp_str_val(inner.ok).ok;
+
+    if (str == NULL || strcmp(str, "c") != 0) {
+        r = fail_msg("couldn't find the nested string");
+        goto cleanup;
+    }
+
+    struct result_sexp last = sexp_rcar(sexp_last(s));
+    s32 num = last.status == RESULT_OK ? sexp_int_val(last.ok).ok : 0;
+    if (num != 42)
+        r = fail_msg("expected 42 as the last element, got %d", num);
+
+ cleanup:
+    free_sexp(s);
+    return r;
+}
+
+struct result_void tst_borrowed_atoms(void) {
+    const char *input = "(ABC \"def\" ghi)";
+
+    sexp *s;
+    RESULT_UNWRAP(void, s, sexp_read(input, SEXP_MEMORY_BORROWED));
+
+    struct result_void r = no_error();
+    struct result_sexp_view views[3];
+    for (u32 i = 0; i < 3; i++)
+        views[i] = sexp_view_val(sexp_nth(s, i).ok);
+
+    // the symbol and string point into the input, the lower-case symbol had
+    // to be converted to upper-case, so it is a copy.
+    if (views[0].status == RESULT_ERROR || views[0].ok.str != input + 1 ||
+        views[0].ok.length != 3) {
+        r = fail_msg("symbol was not borrowed");
+        goto cleanup;
+    }
+
+    if (views[1].status == RESULT_ERROR || views[1].ok.str != input + 6 ||
+        views[1].ok.length != 3) {
+        r = fail_msg("string was not borrowed");
+        goto cleanup;
+    }
+
+    if (views[2].status == RESULT_ERROR ||
+        strncmp(views[2].ok.str, "GHI", 3) != 0) {
+        r = fail_msg("lower-case symbol was not converted");
+        goto cleanup;
+    }
+
+ cleanup:
+    for (u32 i = 0; i < 3; i++) {
+        if (views[i].status == RESULT_ERROR)
+            free_error(views[i].error);
+    }
+
+    free_sexp(s);
+    return r;
+}
+
+struct result_void tst_borrowed_netstring_null(void) {
+    // the null character inside of the netstring is part of the atom.
+    const char input[] = "(5:ab\0cd X)";
+
+    sexp *s;
+    RESULT_UNWRAP(void, s, sexp_read_n(input, sizeof(input) - 1,
+                                       SEXP_MEMORY_BORROWED));
+
+    struct result_void r = no_error();
+    struct result_sexp_view view = sexp_view_val(sexp_nth(s, 0).ok);
+    if (view.status == RESULT_ERROR) {
+        r = result_void_error(view.error);
+    } else if (view.ok.length != 5 || memcmp(view.ok.str, "ab\0cd", 5) != 0) {
+        r = fail_msg("netstring was truncated to %u bytes", view.ok.length);
+    }
+
+    free_sexp(s);
+    return r;
+}
+
+
+/************************* BINARY ENCODING TESTS ******************************/
+/** encodes `text` as a binary sexp, reads it back with `method`, and compares
+    the result to `text` wrapped in a list. */
+struct result_void binary_round_trip(const char *text,
+                                     enum sexp_memory_method method) {
+    sexp *s;
+    RESULT_UNWRAP(void, s, sexp_read(text, SEXP_MEMORY_TREE));
+
+    vector *buffer = make_vector(sizeof(u8), 16);
+    struct result_s32 r = sexp_serialize_binary(s, buffer);
+    free_sexp(s);
+
+    if (r.status == RESULT_ERROR) {
+        free_vector(buffer);
+        return result_void_error(r.error);
+    }
+
+    struct result_sexp in = sexp_read_binary_list(NULL, vec_dat(buffer),
+                                                  vec_len(buffer), method);
+    if (in.status == RESULT_ERROR) {
+        free_vector(buffer);
+        return result_void_error(in.error);
+    }
+
+    char expected[256];
+    snprintf(expected, sizeof(expected), "(%s)", text);
+
+    // borrowed atoms point into the buffer, so it is freed last.
+    struct result_void ret = linear_expect(in.ok, expected);
+    free_vector(buffer);
+    return ret;
+}
+
+struct result_void tst_binary_round_trip(void) {
+    const char *text = "(\"cool\" (NESTED [TAG]ATOM) |Mixed| 0 -1 300 ())";
+
+    RESULT_CALL(void, binary_round_trip(text, SEXP_MEMORY_LINEAR));
+    RESULT_CALL(void, binary_round_trip(text, SEXP_MEMORY_BORROWED));
+    return no_error();
+}
+
+struct result_void tst_binary_zigzag(void) {
+    const s32 values[] = {0, -1, 1, -64, 64, 2147483647, -2147483647 - 1};
+    const u8 expected[][6] = {
+        {SEXP_BINARY_INTEGER, 0x00},
+        {SEXP_BINARY_INTEGER, 0x01},
+        {SEXP_BINARY_INTEGER, 0x02},
+        {SEXP_BINARY_INTEGER, 0x7f},
+        {SEXP_BINARY_INTEGER, 0x80, 0x01},
+        {SEXP_BINARY_INTEGER, 0xfe, 0xff, 0xff, 0xff, 0x0f},
+        {SEXP_BINARY_INTEGER, 0xff, 0xff, 0xff, 0xff, 0x0f},
+    };
+    const u32 expected_length[] = {2, 2, 2, 2, 3, 6, 6};
+
+    struct result_void ret = no_error();
+    vector *buffer = make_vector(sizeof(u8), 16);
+
+    for (u32 i = 0; i < sizeof(values)/sizeof(s32); i++) {
+        vec_resize(buffer, 0);
+
+        sexp *s;
+        RESULT_UNWRAP(void, s, make_integer_sexp(values[i]));
+        struct result_s32 r = sexp_serialize_binary(s, buffer);
+        free_sexp(s);
+
+        if (r.status == RESULT_ERROR) {
+            ret = result_void_error(r.error);
+            break;
+        }
+
+        if (vec_len(buffer) != expected_length[i] ||
+            memcmp(vec_dat(buffer), expected[i], expected_length[i]) != 0) {
+            ret = fail_msg("%d was not zigzag encoded", values[i]);
+            break;
+        }
+
+        struct result_sexp in = sexp_read_binary_list(NULL, vec_dat(buffer),
+                                                      vec_len(buffer),
+                                                      SEXP_MEMORY_LINEAR);
+        if (in.status == RESULT_ERROR) {
+            ret = result_void_error(in.error);
+            break;
+        }
+
+        struct result_s32 value = sexp_int_val(sexp_nth(in.ok, 0).ok);
+        free_sexp(in.ok);
+
+        if (value.status == RESULT_ERROR) {
+            ret = result_void_error(value.error);
+            break;
+        } else if (value.ok != values[i]) {
+            ret = fail_msg("decoded %d, expected %d", value.ok, values[i]);
+            break;
+        }
+    }
+
+    free_vector(buffer);
+    return ret;
+}
+
+struct result_void tst_binary_head(void) {
+    const u8 body[] = {SEXP_BINARY_STRING, 2, 'h', 'i', SEXP_BINARY_INTEGER, 4};
+
+    sexp *s;
+    RESULT_UNWRAP(void, s, sexp_read_binary_list("HEAD", body, sizeof(body),
+                                                 SEXP_MEMORY_BORROWED));
+
+    return linear_expect(s, "(HEAD \"hi\" 2)");
+}
+
+struct result_void tst_binary_truncated(void) {
+    const u8 inputs[][4] = {
+        {SEXP_BINARY_LIST, SEXP_BINARY_INTEGER, 0x00},
+        {SEXP_BINARY_STRING, 5, 'a', 'b'},
+        {SEXP_BINARY_INTEGER, 0x80, 0x80, 0x80},
+        {SEXP_BINARY_TAG, SEXP_BINARY_SYMBOL, 1, 'A'},
+    };
+    const u32 lengths[] = {3, 4, 4, 4};
+
+    for (u32 i = 0; i < sizeof(lengths)/sizeof(u32); i++) {
+        struct result_sexp r = sexp_read_binary_list(NULL, inputs[i], lengths[i],
+                                                     SEXP_MEMORY_LINEAR);
+        if (r.status == RESULT_OK) {
+            free_sexp(r.ok);
+            return fail_msg("truncated input %u was read", i);
+        }
+
+        free_error(r.error);
+    }
+
+    return no_error();
+}
+
+/** reads `depth` nested binary lists, (((...))). */
+struct result_sexp read_binary_nested(size_t depth) {
+    u8 *input = malloc(depth * 2);
+    if (input == NULL)
+        return RESULT_MSG_ERROR(sexp, "couldn't allocate the input");
+
+    memset(input, SEXP_BINARY_LIST, depth);
+    memset(input + depth, SEXP_BINARY_END, depth);
+
+    struct result_sexp r = sexp_read_binary_list(NULL, input, depth * 2,
+                                                 SEXP_MEMORY_LINEAR);
+    free(input);
+    return r;
+}
+
+struct result_void tst_binary_depth(void) {
+    // the returned list holds the outermost one.
+    sexp *s;
+    RESULT_UNWRAP(void, s, read_binary_nested(SEXP_BINARY_MAX_DEPTH - 1));
+    free_sexp(s);
+
+    // too deep, and deep enough to overflow the stack without a limit.
+    const size_t too_deep[] = {SEXP_BINARY_MAX_DEPTH, 1 << 20};
+    for (u32 i = 0; i < sizeof(too_deep)/sizeof(size_t); i++) {
+        struct result_sexp r = read_binary_nested(too_deep[i]);
+        if (r.status == RESULT_OK) {
+            free_sexp(r.ok);
+            return fail_msg("%zu nested lists were read", too_deep[i]);
+        }
+
+        free_error(r.error);
+    }
+
+    return no_error();
+}
+
+
+/*************************** STREAM SCANNER TESTS *****************************/
+/** feeds `text` to a stream one byte at a time, and checks that the first
+    top-level sexp ends after `expected_end` bytes. */
+struct result_void stream_expect_end(const char *text, size_t expected_end) {
+    struct sexp_stream stream;
+    sexp_stream_init(&stream);
+
+    size_t scanned = 0;
+    bool complete = false;
+    while (complete == false && scanned < strlen(text))
+        scanned += sexp_stream_scan(&stream, text + scanned, 1, &complete);
+
+    if (complete == false)
+        return fail_msg("'%s' was never completed", text);
+
+    if (scanned != expected_end)
+        return fail_msg("'%s' ended after %zu bytes, not %zu",
+                        text, scanned, expected_end);
+
+    return no_error();
+}
+
+struct result_void tst_stream_split_reads(void) {
+    RESULT_CALL(void, stream_expect_end("(A (B C) [TAG]D)(E)", 16));
+    RESULT_CALL(void, stream_expect_end("  (12 34)  ", 9));
+    RESULT_CALL(void, stream_expect_end("symbol ", 6));
+    RESULT_CALL(void, stream_expect_end("[3:TAG]4:ATOM(", 13));
+    RESULT_CALL(void, stream_expect_end("\"str\"(", 5));
+
+    // the whole text at once
+    struct sexp_stream stream;
+    sexp_stream_init(&stream);
+
+    bool complete;
+    const char text[] = "(A B)(C)";
+    size_t n = sexp_stream_scan(&stream, text, strlen(text), &complete);
+    if (complete == false || n != 5)
+        return fail_msg("the first sexp ended after %zu bytes", n);
+
+    n = sexp_stream_scan(&stream, text + 5, strlen(text) - 5, &complete);
+    if (complete == false || n != 3)
+        return fail_msg("the second sexp ended after %zu bytes", n);
+
+    return no_error();
+}
+
+struct result_void tst_stream_parens_in_atoms(void) {
+    RESULT_CALL(void, stream_expect_end("(\"a)b(\" X)", 10));
+    RESULT_CALL(void, stream_expect_end("(|)| X)", 7));
+    RESULT_CALL(void, stream_expect_end("(5:)))((X)", 10));
+    RESULT_CALL(void, stream_expect_end("(0: X)", 6));
+    RESULT_CALL(void, stream_expect_end("3:)))", 5));
+    return no_error();
+}
+
+struct result_void tst_stream_netstring_too_long(void) {
+    struct sexp_stream stream;
+    sexp_stream_init(&stream);
+
+    // the scan gives up at the colon, rather than skip 4 GiB.
+    bool complete;
+    const char text[] = "(A 4294967296:BCD)";
+    size_t n = sexp_stream_scan(&stream, text, strlen(text), &complete);
+    if (complete == false || n != 14)
+        return fail_msg("the scan stopped after %zu bytes", n);
+
+    if (stream.state != SEXP_STREAM_TOO_LONG)
+        return fail_msg("the stream didn't report the netstring");
+
+    // the longest netstring is still scanned.
+    char longest[32];
+    snprintf(longest, sizeof(longest), "(%u:", SEXP_NETSTRING_MAX_LENGTH);
+    sexp_stream_init(&stream);
+    sexp_stream_scan(&stream, longest, strlen(longest), &complete);
+    if (complete || stream.state != SEXP_STREAM_NETSTRING)
+        return fail_msg("the longest netstring wasn't scanned");
+
+    return no_error();
+}
+
+/***************************** LIST BUILDER TESTS *****************************/
+/** builds (1 "two" THREE (4) 5 6 ... 99) with `method`. */
+struct result_void builder_expect(enum sexp_memory_method method) {
+    struct sexp_list_builder builder;
+    RESULT_CALL(void, sexp_builder_init(&builder, method));
+
+    struct result_sexp r = sexp_builder_push_integer(&builder, 1);
+    r = r.status == RESULT_OK ? sexp_builder_push_string(&builder, "two") : r;
+    r = r.status == RESULT_OK ? sexp_builder_push_symbol(&builder, "THREE") : r;
+    r = r.status == RESULT_OK
+        ? sexp_builder_push(&builder, sexp_list(make_integer_sexp(4), sexp_nil()))
+        : r;
+
+    for (s32 i = 5; i < 100 && r.status == RESULT_OK; i++)
+        r = sexp_builder_push_integer(&builder, i);
+
+    sexp *list = sexp_builder_finish(&builder);
+    if (r.status == RESULT_ERROR) {
+        free_sexp(list);
+        return result_void_error(r.error);
+    }
+
+    char expected[512] = "(1 \"two\" THREE (4)";
+    for (s32 i = 5; i < 100; i++)
+        snprintf(expected + strlen(expected), sizeof(expected) - strlen(expected),
+                 " %d", i);
+    strcat(expected, ")");
+
+    return linear_expect(list, expected);
+}
+
+struct result_void tst_builder(void) {
+    RESULT_CALL(void, builder_expect(SEXP_MEMORY_TREE));
+    RESULT_CALL(void, builder_expect(SEXP_MEMORY_LINEAR));
+
+    // nothing was pushed.
+    struct sexp_list_builder builder;
+    RESULT_CALL(void, sexp_builder_init(&builder, SEXP_MEMORY_TREE));
+    if (sexp_builder_finish(&builder) != NULL)
+        return fail_msg("an empty tree list is not nil");
+
+    return no_error();
+}
+
+
+/***************************** SEXP WRITER TESTS ******************************/
+/** writes ("user" (1 -2 300) SYM ()) */
+struct result_void writer_write_example(struct sexp_writer *writer) {
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+    RESULT_CALL(void, sexp_write_str(writer, "user", 4));
+
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+    RESULT_CALL(void, sexp_write_int(writer, 1));
+    RESULT_CALL(void, sexp_write_int(writer, -2));
+    RESULT_CALL(void, sexp_write_int(writer, 300));
+    RESULT_CALL(void, sexp_write_end_list(writer));
+
+    RESULT_CALL(void, sexp_write_sym(writer, "SYM", 3));
+    RESULT_CALL(void, sexp_write_begin_list(writer));
+    RESULT_CALL(void, sexp_write_end_list(writer));
+
+    return sexp_write_end_list(writer);
+}
+
+struct result_void tst_writer_matches_serializer(void) {
+    sexp *s;
+    RESULT_UNWRAP(void, s, sexp_read("(\"user\" (1 -2 300) SYM ())",
+                                     SEXP_MEMORY_TREE));
+
+    vector *text = make_vector(sizeof(char), 16);
+    vector *binary = make_vector(sizeof(u8), 16);
+    vector *expected = make_vector(sizeof(u8), 16);
+
+    struct sexp_writer writer;
+    sexp_writer_init(&writer, text, SEXP_ENCODING_TEXT);
+    struct result_void ret = writer_write_example(&writer);
+
+    if (ret.status == RESULT_OK) {
+        sexp_writer_init(&writer, binary, SEXP_ENCODING_BINARY);
+        ret = writer_write_example(&writer);
+    }
+
+    char *expected_text = NULL;
+    if (ret.status == RESULT_OK) {
+        struct result_str r = sexp_serialize(s);
+        if (r.status == RESULT_ERROR)
+            ret = result_void_error(r.error);
+        else
+            expected_text = r.ok;
+    }
+
+    if (ret.status == RESULT_OK) {
+        struct result_s32 r = sexp_serialize_binary(s, expected);
+        if (r.status == RESULT_ERROR)
+            ret = result_void_error(r.error);
+    }
+
+    if (ret.status == RESULT_OK) {
+        if (vec_len(text) != strlen(expected_text) ||
+            memcmp(vec_dat(text), expected_text, vec_len(text)) != 0) {
+            ret = fail_msg("wrote %.*s, expected %s", (int)vec_len(text),
+                           (char *)vec_dat(text), expected_text);
+        } else if (vec_len(binary) != vec_len(expected) ||
+                   memcmp(vec_dat(binary), vec_dat(expected),
+                          vec_len(binary)) != 0) {
+            ret = fail_msg("binary output does not match sexp_serialize_binary");
+        }
+    }
+
+    free(expected_text);
+    free_vector(text);
+    free_vector(binary);
+    free_vector(expected);
+    free_sexp(s);
+    return ret;
+}
+
+
+/***************************** SEXP NODE POOL TESTS ****************************/
+/** deep enough that freeing it a node per stack frame would overflow. */
+#define POOL_TEST_DEPTH 500000
+
+/** makes a tree sexp of `depth` nested lists, ((((...)))), if `nested`, or
+    a flat list of `depth` integers otherwise. */
+struct result_sexp make_pool_test_tree(size_t depth, bool nested) {
+    sexp *tree = NULL;
+
+    for (size_t d = 0; d < depth; d++) {
+        sexp *cons;
+        RESULT_UNWRAP(sexp, cons, make_cons_sexp());
+
+        if (nested) {
+            sexp_setcar(cons, tree);
+        } else {
+            struct result_sexp item = make_integer_sexp(1);
+            if (item.status == RESULT_ERROR) {
+                free_sexp(cons);
+                free_sexp(tree);
+                return item;
+            }
+
+            sexp_setcar(cons, item.ok);
+            sexp_setcdr(cons, tree);
+        }
+
+        tree = cons;
+    }
+
+    return result_sexp_ok(tree);
+}
+
+struct result_void tst_pool_free_deep_trees(void) {
+    sexp *tree;
+    RESULT_UNWRAP(void, tree, make_pool_test_tree(POOL_TEST_DEPTH, false));
+    free_sexp(tree);
+
+    RESULT_UNWRAP(void, tree, make_pool_test_tree(POOL_TEST_DEPTH, true));
+    free_sexp(tree);
+
+    return no_error();
+}
+
+struct result_void tst_pool_reuses_nodes(void) {
+    sexp *a, *b;
+    RESULT_UNWRAP(void, a, make_integer_sexp(1));
+    free_sexp(a);
+
+    // the node that was just freed is the next one of its size handed out.
+    RESULT_UNWRAP(void, b, make_cons_sexp());
+    bool reused = a == b;
+    free_sexp(b);
+
+    // long atoms are too big for the pool, but are freed the same way.
+    char long_atom[200];
+    memset(long_atom, 'a', sizeof(long_atom) - 1);
+    long_atom[sizeof(long_atom) - 1] = '\0';
+
+    sexp *big;
+    RESULT_UNWRAP(void, big, make_string_sexp(long_atom));
+    free_sexp(big);
+
+    if (!reused)
+        return fail_msg("a freed node wasn't reused");
+
+    return no_error();
+}
+
+/** more nodes than a thread keeps free of one size. */
+#define POOL_TEST_CROSS_NODES 16384
+
+void *pool_test_free_nodes(void *arg) {
+    sexp **nodes = arg;
+    for (size_t n = 0; n < POOL_TEST_CROSS_NODES; n++)
+        free_sexp(nodes[n]);
+    return NULL;
+}
+
+int pool_test_compare_nodes(const void *a, const void *b) {
+    uintptr_t x = (uintptr_t)*(sexp *const *)a,
+              y = (uintptr_t)*(sexp *const *)b;
+    return (x > y) - (x < y);
+}
+
+struct result_void tst_pool_cross_thread_reuse(void) {
+    sexp **made = malloc(POOL_TEST_CROSS_NODES * sizeof(sexp *));
+    sexp **remade = malloc(POOL_TEST_CROSS_NODES * sizeof(sexp *));
+    struct result_void error = no_error();
+    if (made == NULL || remade == NULL) {
+        error = fail_msg("couldn't allocate the node arrays");
+        goto done;
+    }
+
+    size_t n_made = 0, n_remade = 0;
+    for (; n_made < POOL_TEST_CROSS_NODES; n_made++) {
+        struct result_sexp r = make_integer_sexp(n_made);
+        if (r.status == RESULT_ERROR) {
+            error = result_void_error(r.error);
+            goto free_made;
+        }
+        made[n_made] = r.ok;
+    }
+
+    // the nodes are all freed on another thread.
+    pthread_t freer;
+    if (pthread_create(&freer, NULL, &pool_test_free_nodes, made) != 0) {
+        error = fail_msg("couldn't start the freeing thread");
+        goto free_made;
+    }
+    pthread_join(freer, NULL);
+    n_made = 0;
+
+    for (; n_remade < POOL_TEST_CROSS_NODES; n_remade++) {
+        struct result_sexp r = make_integer_sexp(n_remade);
+        if (r.status == RESULT_ERROR) {
+            error = result_void_error(r.error);
+            goto free_made;
+        }
+        remade[n_remade] = r.ok;
+    }
+
+    // most of them come back, rather than stay with the thread that freed
+    // them.
+    qsort(made, POOL_TEST_CROSS_NODES, sizeof(sexp *),
+          &pool_test_compare_nodes);
+    size_t reused = 0;
+    for (size_t n = 0; n < n_remade; n++)
+        if (bsearch(&remade[n], made, POOL_TEST_CROSS_NODES, sizeof(sexp *),
+                    &pool_test_compare_nodes) != NULL)
+            reused++;
+
+    if (reused < POOL_TEST_CROSS_NODES / 2)
+        error = fail_msg("only %zu of %d nodes freed on another thread were "
+                         "reused", reused, POOL_TEST_CROSS_NODES);
+
+free_made:
+    for (size_t n = 0; n < n_made; n++)
+        free_sexp(made[n]);
+    for (size_t n = 0; n < n_remade; n++)
+        free_sexp(remade[n]);
+done:
+    free(made);
+    free(remade);
+    return error;
+}
+
+struct test g_linear_tests[] = {
+    {"push onto linear list", &tst_linear_push},
+    {"push onto nested linear list", &tst_linear_nested_push},
+    {"linear accessors", &tst_linear_accessors},
+    {"borrowed atoms point into the input", &tst_borrowed_atoms},
+    {"borrowed netstring with a null character", &tst_borrowed_netstring_null},
+    {"binary round trip", &tst_binary_round_trip},
+    {"binary integers are zigzag encoded", &tst_binary_zigzag},
+    {"binary list with a head symbol", &tst_binary_head},
+    {"truncated binary sexps are rejected", &tst_binary_truncated},
+    {"deeply nested binary sexps are rejected", &tst_binary_depth},
+    {"stream finds the end of a sexp split across reads", &tst_stream_split_reads},
+    {"stream skips parens inside of atoms", &tst_stream_parens_in_atoms},
+    {"stream stops at a netstring that is too long",
+     &tst_stream_netstring_too_long},
+    {"list builder appends to the tail", &tst_builder},
+    {"writer matches the serializers", &tst_writer_matches_serializer},
+    {"freeing deep trees doesn't recurse", &tst_pool_free_deep_trees},
+    {"freed nodes are reused", &tst_pool_reuses_nodes},
+    {"nodes freed on another thread are reused",
+     &tst_pool_cross_thread_reuse},
+};
+
+void run_linear_test_suite() {
+    size_t num_tests = sizeof(g_linear_tests)/sizeof(struct test);
+    run_test_suite(g_linear_tests, num_tests, "SEXP linear layout tests");
+}
+
 int main(int argc, char **argv) {
     (void)argc;
     (void)argv;
 
-    run_reader_test_suite();
+    // reset the log once, every reader suite run appends to it.
+    FILE* log_file = fopen(g_reader_log_filepath, "w");
+    if (log_file == NULL) {
+        printf("couldn't open log file to reset it!\n");
+        return -1;
+    }
+    fclose(log_file);
+
+    run_reader_test_suite(SEXP_MEMORY_TREE, "SEXP reader tests (tree)");
+    run_reader_test_suite(SEXP_MEMORY_LINEAR, "SEXP reader tests (linear)");
+    run_reader_test_suite(SEXP_MEMORY_BORROWED, "SEXP reader tests (borrowed)");
+    run_linear_test_suite();
 
     return 0;
 }
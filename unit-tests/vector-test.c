@@ -1,3 +1,4 @@
+#include "arena.h"
 #include "error.h"
 #include "unit-test.h"
 #include "vector.h"
@@ -692,6 +693,120 @@ struct result_void tst_vec_set_out_of_bounds(void) {
         return no_error();
 }
 
+struct result_void tst_vec_growth(void) {
+    struct vector* vec = make_vector(sizeof(int), 8);
+    if (vec == NULL)
+        return fail_msg(INIT_FAIL);
+
+    // growing by one element doubles the capacity, rather than the request.
+    struct result_void error = result_void_ok(0);
+    if (vec_reserve(vec, 9) != 0 || vec_cap(vec) != 16)
+        error = fail_msg("capacity %zu after growing past 8", vec_cap(vec));
+    else if (vec_reserve(vec, 100) != 0 || vec_cap(vec) != 100)
+        error = fail_msg("capacity %zu after reserving 100", vec_cap(vec));
+    else if (vec_reserve(vec, SIZE_MAX) == 0)
+        error = fail_msg("reserved SIZE_MAX elements");
+
+    free_vector(vec);
+    return error;
+}
+
+struct result_void tst_vec_uninit(void) {
+    struct vector* vec = make_vector(sizeof(int), 1);
+    if (vec == NULL)
+        return fail_msg(INIT_FAIL);
+
+    struct result_void error = result_void_ok(0);
+    for (int i = 0; i < 100 && error.status == RESULT_OK; i++) {
+        // each pointer is written before the vector grows again.
+        int *pushed = vec_push_uninit(vec);
+        if (pushed != NULL)
+            *pushed = i;
+
+        int *extended = vec_extend_uninit(vec, 2);
+        if (pushed == NULL || extended == NULL) {
+            error = fail_msg("failed to extend the vector");
+            break;
+        }
+
+        extended[0] = extended[1] = -i;
+    }
+
+    for (int i = 0; i < 100 && error.status == RESULT_OK; i++) {
+        int *three = vec_ref(vec, i * 3);
+        if (three[0] != i || three[1] != -i || three[2] != -i)
+            error = fail_msg("element %d was overwritten", i * 3);
+    }
+
+    if (error.status == RESULT_OK && vec_len(vec) != 300)
+        error = fail_msg("the vector is %zu long, not 300", vec_len(vec));
+
+    // a failed extend leaves the vector alone.
+    if (error.status == RESULT_OK &&
+        (vec_extend_uninit(vec, SIZE_MAX) != NULL || vec_len(vec) != 300))
+        error = fail_msg("extended by SIZE_MAX elements");
+
+    free_vector(vec);
+    return error;
+}
+
+struct result_void tst_vec_zeroing(void) {
+    struct vector* vec = make_vector(sizeof(int), 4);
+    if (vec == NULL)
+        return fail_msg(INIT_FAIL);
+
+    // leave garbage past the end of the vector.
+    int garbage[64];
+    memset(garbage, 0x5a, sizeof(garbage));
+    vec_pushn(vec, garbage, 64);
+    vec_resize(vec, 0);
+
+    vec_set_zeroing(vec, true);
+    struct result_void error = result_void_ok(0);
+    if (vec_resize(vec, 200) != 0)
+        error = fail_msg("resize failed");
+
+    for (size_t i = 0; i < 200 && error.status == RESULT_OK; i++) {
+        if (*(int *)vec_ref(vec, i) != 0)
+            error = fail_msg("element %zu wasn't zeroed", i);
+    }
+
+    free_vector(vec);
+    return error;
+}
+
+struct result_void tst_vec_arena(void) {
+    struct arena arena;
+    RESULT_CALL(void, make_arena(&arena, 64));
+    struct allocator alloc = arena_allocator(&arena);
+
+    // only the second vector is the arena's last allocation, so the first is
+    // copied every time it grows.
+    struct vector* a = make_vector_in(&alloc, sizeof(int), 2);
+    struct vector* b = make_vector_in(&alloc, sizeof(int), 2);
+    if (a == NULL || b == NULL) {
+        free_arena(&arena);
+        return fail_msg(INIT_FAIL);
+    }
+
+    struct result_void error = result_void_ok(0);
+    for (int i = 0; i < 1000 && error.status == RESULT_OK; i++) {
+        int negated = -i;
+        if (vec_push(a, &i) != 0 || vec_push(b, &negated) != 0)
+            error = fail_msg("vec_push self reported failure");
+    }
+
+    for (int i = 0; i < 1000 && error.status == RESULT_OK; i++) {
+        if (((int*)vec_dat(a))[i] != i || ((int*)vec_dat(b))[i] != -i)
+            error = fail_msg("element %d was overwritten", i);
+    }
+
+    free_vector(b);
+    free_vector(a);
+    free_arena(&arena);
+    return error;
+}
+
 struct test g_all_tests[] = {
     {"vec_push", &tst_vec_push},
     {"vec_push with NULL src", &tst_vec_push_null},
@@ -713,6 +828,10 @@ struct test g_all_tests[] = {
     {"vec_set", &tst_vec_set},
     {"vec_set with NULL src", &tst_vec_set_null},
     {"vec_set out of bounds", &tst_vec_set_out_of_bounds},
+    {"vectors allocated from an arena", &tst_vec_arena},
+    {"vec_reserve grows from the capacity", &tst_vec_growth},
+    {"vec_push_uninit and vec_extend_uninit", &tst_vec_uninit},
+    {"vec_resize with zeroing", &tst_vec_zeroing},
 };
 
 int main(int argc, char **argv) {